@@ -1,11 +1,12 @@
 SET(LIB_REQUIRED_DEP_PACKAGES Teuchos Epetra EpetraExt Thyra)
-SET(LIB_OPTIONAL_DEP_PACKAGES)
+SET(LIB_OPTIONAL_DEP_PACKAGES Tpetra ThyraTpetraAdapters)
 # Dakota can optionally use ROL, but it creates a circular dependence
 # TriKota <--> ROL
 ##SET(LIB_OPTIONAL_DEP_PACKAGES ROL)
 SET(TEST_REQUIRED_DEP_PACKAGES)
 SET(TEST_OPTIONAL_DEP_PACKAGES)
 SET(LIB_REQUIRED_DEP_TPLS Boost)
-SET(LIB_OPTIONAL_DEP_TPLS)
+# HDF5: optional output format of TriKota::ResultsWriter
+SET(LIB_OPTIONAL_DEP_TPLS HDF5)
 SET(TEST_REQUIRED_DEP_TPLS)
 SET(TEST_OPTIONAL_DEP_TPLS)
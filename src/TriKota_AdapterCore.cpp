@@ -0,0 +1,171 @@
+// @HEADER
+// ************************************************************************
+// 
+//        TriKota: A Trilinos Wrapper for the Dakota Framework
+//                  Copyright (2009) Sandia Corporation
+// 
+// Under the terms of Contract DE-AC04-94AL85000 with Sandia Corporation,
+// the U.S. Government retains certain rights in this software.
+// 
+// This library is free software; you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation; either version 2.1 of the
+// License, or (at your option) any later version.
+//  
+// This library is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301
+// USA
+// 
+// Questions? Contact Andy Salinger (agsalin@sandia.gov), Sandia
+// National Laboratories.
+// 
+// ************************************************************************
+// @HEADER
+
+#include "TriKota_AdapterCore.hpp"
+#include "Teuchos_VerboseObject.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#include "ProblemDescDB.hpp"
+#include "DakotaModel.hpp"
+
+TriKota::AdapterCore::AdapterCore()
+  : adjointCost(1.0),
+    forwardCost(1.0),
+    forwardValid(false),
+    forwardReuses(0)
+{}
+
+Dakota::ProblemDescDB&
+TriKota::AdapterCore::selectInterface(Dakota::ProblemDescDB& problem_db,
+                                      const std::string& interface_id)
+{
+  if (!interface_id.empty()) {
+    // Fails if no model of the input uses the interface
+    interfaceModel(problem_db, interface_id);
+    problem_db.set_db_interface_node(interface_id);
+  }
+  return problem_db;
+}
+
+Dakota::Model&
+TriKota::AdapterCore::interfaceModel(Dakota::ProblemDescDB& problem_db,
+                                     const std::string& interface_id)
+{
+  Dakota::ModelList& models = problem_db.model_list();
+  TEUCHOS_TEST_FOR_EXCEPTION(models.empty(), std::logic_error,
+     "TriKota Adapter Error: the dakota input has no model");
+  if (interface_id.empty()) return *models.begin();
+
+  Dakota::ModelLIter ml_iter = models.begin();
+  while (ml_iter != models.end() && ml_iter->interface_id() != interface_id) ++ml_iter;
+  TEUCHOS_TEST_FOR_EXCEPTION(ml_iter == models.end(), std::logic_error,
+     "TriKota Adapter Error: no model of the dakota input uses the interface "
+     << interface_id);
+  return *ml_iter;
+}
+
+bool TriKota::AdapterCore::lookup(const double* x, const unsigned int nVars,
+                                  const unsigned int nFns, const bool gradFlag,
+                                  double* vals, double* grads, const int ldGrads,
+                                  bool& computeValues, bool& computeGradients) const
+{
+  computeValues = true;
+  computeGradients = gradFlag;
+
+  bool foundValues, foundGradients;
+  if (evalCache != Teuchos::null) {
+    evalCache->lookup(x, nVars, nFns, gradFlag, vals, grads, ldGrads,
+                      foundValues, foundGradients);
+    computeValues = !foundValues;
+    computeGradients = gradFlag && !foundGradients;
+  }
+  if (evalJournal != Teuchos::null && (computeValues || computeGradients)) {
+    // The journal holds values with every record, so it decides both
+    // parts unless the cache already supplied the values
+    Teuchos::Array<double> g(nFns);
+    evalJournal->lookup(x, nVars, nFns, computeGradients,
+                        g.getRawPtr(), grads, ldGrads, foundValues, foundGradients);
+    if (foundValues && computeValues) {
+      std::copy(g.begin(), g.end(), vals);
+      computeValues = false;
+    }
+    if (foundGradients) computeGradients = false;
+  }
+  return !computeValues && !computeGradients;
+}
+
+void TriKota::AdapterCore::store(const double* x, const unsigned int nVars,
+                                 const unsigned int nFns,
+                                 const double* vals, const double* grads, const int ldGrads,
+                                 const bool computedValues, const bool computedGradients,
+                                 const bool writerRank) const
+{
+  if (evalCache != Teuchos::null)
+    evalCache->store(x, nVars, nFns, computedValues ? vals : 0,
+                     computedGradients ? grads : 0, ldGrads);
+
+  // One record per new evaluation, written by the rank holding the response
+  if (!writerRank || !(computedValues || computedGradients)) return;
+  if (evalJournal != Teuchos::null)
+    evalJournal->append(x, nVars, nFns, vals, computedGradients ? grads : 0, ldGrads);
+  if (resultsWriter != Teuchos::null)
+    resultsWriter->append(x, nVars, nFns, vals, computedGradients ? grads : 0, ldGrads);
+}
+
+void TriKota::AdapterCore::setSensitivityCosts(const double adjointCost_,
+                                               const double forwardCost_)
+{
+  TEUCHOS_TEST_FOR_EXCEPTION(adjointCost_ <= 0.0 || forwardCost_ <= 0.0, std::logic_error,
+    "TriKota Adapter Error: sensitivity costs must be positive");
+  adjointCost = adjointCost_;
+  forwardCost = forwardCost_;
+}
+
+double TriKota::AdapterCore::solveCost(const double seconds, const unsigned int solves)
+{
+  return std::max(seconds, 1.0e-12) / std::max(solves, 1u);
+}
+
+bool TriKota::AdapterCore::preferAdjoint(const bool trans, const bool byCol,
+                                         const unsigned int nParameters,
+                                         const unsigned int nResponses) const
+{
+  return trans && (!byCol || nResponses*adjointCost <= nParameters*forwardCost);
+}
+
+void TriKota::AdapterCore::reportOrientation(const bool adjoint, const bool trans,
+                                             const bool byCol,
+                                             const unsigned int nParameters,
+                                             const unsigned int nResponses) const
+{
+  Teuchos::RCP<Teuchos::FancyOStream>
+    out = Teuchos::VerboseObjectBase::getDefaultOStream();
+  *out << "TriKota:: Computing DgDp as "
+       << (adjoint ? "DERIV_TRANS_MV_BY_ROW (adjoint)" : "DERIV_MV_BY_COL (forward)");
+  if (trans && byCol)
+    *out << ", estimated cost " << nResponses*adjointCost << " adjoint vs "
+         << nParameters*forwardCost << " forward";
+  *out << std::endl;
+}
+
+bool TriKota::AdapterCore::atForwardPoint(const double* x, const unsigned int nVars) const
+{
+  // Exact match, as for a repeated request of the same point
+  return forwardValid && forwardX.size() == (int) nVars &&
+    (nVars == 0 || std::memcmp(forwardX.getRawPtr(), x, sizeof(double)*nVars) == 0);
+}
+
+void TriKota::AdapterCore::setForwardPoint(const double* x, const unsigned int nVars)
+{
+  forwardX.assign(x, x + nVars);
+  forwardValid = true;
+}
@@ -0,0 +1,221 @@
+// @HEADER
+// ************************************************************************
+// 
+//        TriKota: A Trilinos Wrapper for the Dakota Framework
+//                  Copyright (2009) Sandia Corporation
+// 
+// Under the terms of Contract DE-AC04-94AL85000 with Sandia Corporation,
+// the U.S. Government retains certain rights in this software.
+// 
+// This library is free software; you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation; either version 2.1 of the
+// License, or (at your option) any later version.
+//  
+// This library is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301
+// USA
+// 
+// Questions? Contact Andy Salinger (agsalin@sandia.gov), Sandia
+// National Laboratories.
+// 
+// ************************************************************************
+// @HEADER
+
+#ifndef TRIKOTA_ADAPTERCORE
+#define TRIKOTA_ADAPTERCORE
+
+#include "TriKota_ModelEvaluatorExtensions.hpp"
+#include "TriKota_EvaluationCache.hpp"
+#include "TriKota_EvaluationJournal.hpp"
+#include "TriKota_ResultsWriter.hpp"
+#include "TriKota_StatePool.hpp"
+
+#include "Teuchos_RCP.hpp"
+#include "Teuchos_Array.hpp"
+#include "Teuchos_Comm.hpp"
+#include "Teuchos_CommHelpers.hpp"
+#include "Teuchos_Assert.hpp"
+
+#include <string>
+
+namespace Dakota {
+class ProblemDescDB;
+class Model;
+}
+
+namespace TriKota {
+
+/*! \brief Bookkeeping shared by TriKota::DirectApplicInterface,
+  TriKota::ThyraDirectApplicInterface and
+  TriKota::TpetraDirectApplicInterface: the evaluation cache, journal
+  and results writer, Dakota's active set of gradients, the DgDp
+  orientation picked from the sensitivity costs and the point of the
+  model's last forward solve. It works on Dakota's plain arrays; each
+  adapter only copies its own vector types in and out. It also picks the
+  Dakota interface and model an adapter is constructed for.
+*/
+class AdapterCore {
+public:
+
+  AdapterCore();
+
+  ~AdapterCore() {}
+
+  /*! \brief problem_db with its interface node set to interface_id, so
+    the Dakota::DirectApplicInterface base of an adapter reads that
+    interface block; left as it is if interface_id is empty */
+  static Dakota::ProblemDescDB& selectInterface(Dakota::ProblemDescDB& problem_db,
+                                                const std::string& interface_id);
+
+  /*! \brief The first model evaluated through interface_id, which seeds
+    and sizes the adapter of that interface; the first model of the
+    input if interface_id is empty */
+  static Dakota::Model& interfaceModel(Dakota::ProblemDescDB& problem_db,
+                                       const std::string& interface_id);
+
+  //! Evaluation cache, null if none is used
+  void setEvaluationCache(const Teuchos::RCP<EvaluationCache>& cache) { evalCache = cache; }
+  Teuchos::RCP<EvaluationCache> getEvaluationCache() const { return evalCache; }
+
+  //! Evaluation journal, null if none is used
+  void setEvaluationJournal(const Teuchos::RCP<EvaluationJournal>& journal) { evalJournal = journal; }
+  Teuchos::RCP<EvaluationJournal> getEvaluationJournal() const { return evalJournal; }
+
+  //! Results writer, null if none is used
+  void setResultsWriter(const Teuchos::RCP<ResultsWriter>& writer) { resultsWriter = writer; }
+  Teuchos::RCP<ResultsWriter> getResultsWriter() const { return resultsWriter; }
+
+  /*! \brief Fill vals and (if gradFlag) the column-major nVars x nFns
+    block grads at x from the evaluation cache, then the journal, and
+    tell what is left to compute. Returns true if nothing is. */
+  bool lookup(const double* x, const unsigned int nVars, const unsigned int nFns,
+              const bool gradFlag, double* vals, double* grads, const int ldGrads,
+              bool& computeValues, bool& computeGradients) const;
+
+  /*! \brief Store what was computed at x into the evaluation cache; the
+    rank holding the response (writerRank) also appends it to the
+    journal and the results writer. Every rank of the analysis must
+    make the same calls, so the cache takes the same decisions. */
+  void store(const double* x, const unsigned int nVars, const unsigned int nFns,
+             const double* vals, const double* grads, const int ldGrads,
+             const bool computedValues, const bool computedGradients,
+             const bool writerRank) const;
+
+  /*! \brief Collect into active the responses among Dakota's first nFns
+    whose gradients asv (e.g. directFnASV) requests. The list is left
+    empty, meaning all of them, only if it holds all nResponses
+    responses of the model, so a model restricted to it is given an
+    explicit list whenever it is shorter. Returns true if all nFns
+    gradients Dakota reads are requested, i.e. if they may be cached. */
+  template <class ASV>
+  static bool loadActiveSet(const ASV& asv, const unsigned int nFns,
+                            const unsigned int nResponses, Teuchos::Array<int>& active);
+
+  //! Relative cost of one adjoint and one forward sensitivity solve (both positive)
+  void setSensitivityCosts(const double adjointCost, const double forwardCost);
+  double getAdjointCost() const { return adjointCost; }
+  double getForwardCost() const { return forwardCost; }
+
+  //! Cost per solve of a calibration DgDp evaluation of solves solves
+  static double solveCost(const double seconds, const unsigned int solves);
+
+  /*! \brief True if the adjoint orientation (DERIV_TRANS_MV_BY_ROW, one
+    solve per response) is cheaper than the forward one (DERIV_MV_BY_COL,
+    one solve per parameter), given which of them the model supports
+    (trans, byCol); ties go to the adjoint orientation */
+  bool preferAdjoint(const bool trans, const bool byCol,
+                     const unsigned int nParameters, const unsigned int nResponses) const;
+
+  //! Print the orientation selected by preferAdjoint() and its estimated cost
+  void reportOrientation(const bool adjoint, const bool trans, const bool byCol,
+                         const unsigned int nParameters, const unsigned int nResponses) const;
+
+  //! True if x is where the model's last forward solve left its state
+  bool atForwardPoint(const double* x, const unsigned int nVars) const;
+
+  //! Remember x as the point of the model's last forward solve
+  void setForwardPoint(const double* x, const unsigned int nVars);
+
+  //! The model's state no longer belongs to a known point
+  void clearForwardPoint() { forwardValid = false; }
+
+  //! Count a gradient evaluation that reused the forward solve
+  void countForwardReuse() { forwardReuses++; }
+  int numForwardReuses() const { return forwardReuses; }
+
+  /*! \brief Non-zero if failed is on any rank of comm (null or a single
+    rank: failed itself), so all ranks report the failure to Dakota */
+  template <class Ordinal>
+  static int anyFailed(const Teuchos::RCP<const Teuchos::Comm<Ordinal> >& comm,
+                       const int failed);
+
+  /*! \brief State pool for warm starts from the model app, which must be
+    a TriKota::WarmStartModelEvaluator<VectorType> (returned in
+    warmStartApp); null if maxStates <= 0 or app is null */
+  template <class VectorType, class ModelType>
+  static Teuchos::RCP<StatePool<VectorType> >
+  createStatePool(const ModelType* app, const double maxDistance, const int maxStates,
+                  const WarmStartModelEvaluator<VectorType>*& warmStartApp,
+                  const std::string& vectorName);
+
+private:
+
+  Teuchos::RCP<EvaluationCache> evalCache;
+  Teuchos::RCP<EvaluationJournal> evalJournal;
+  Teuchos::RCP<ResultsWriter> resultsWriter;
+
+  double adjointCost;
+  double forwardCost;
+
+  // Dakota variables of the model's last forward solve, if still valid
+  Teuchos::Array<double> forwardX;
+  bool forwardValid;
+  int forwardReuses;
+};
+
+template <class ASV>
+bool AdapterCore::loadActiveSet(const ASV& asv, const unsigned int nFns,
+                                const unsigned int nResponses, Teuchos::Array<int>& active)
+{
+  active.clear();
+  for (unsigned int k=0; k<nFns; k++) if (asv[k] & 2) active.push_back(k);
+  const bool allGradients = (active.size() == (int) nFns);
+  if (active.size() == (int) nResponses) active.clear();
+  return allGradients;
+}
+
+template <class Ordinal>
+int AdapterCore::anyFailed(const Teuchos::RCP<const Teuchos::Comm<Ordinal> >& comm,
+                           const int failed)
+{
+  if (comm == Teuchos::null || comm->getSize() == 1) return failed;
+  int any = failed;
+  Teuchos::reduceAll<Ordinal, int>(*comm, Teuchos::REDUCE_MAX, 1, &failed, &any);
+  return any;
+}
+
+template <class VectorType, class ModelType>
+Teuchos::RCP<StatePool<VectorType> >
+AdapterCore::createStatePool(const ModelType* app, const double maxDistance, const int maxStates,
+                             const WarmStartModelEvaluator<VectorType>*& warmStartApp,
+                             const std::string& vectorName)
+{
+  if (app == 0 || maxStates <= 0) return Teuchos::null;
+
+  warmStartApp = dynamic_cast<const WarmStartModelEvaluator<VectorType>*>(app);
+  TEUCHOS_TEST_FOR_EXCEPTION(warmStartApp == 0, std::logic_error,
+    "TriKota Adapter Error: warm starting needs a model that is a"
+    " TriKota::WarmStartModelEvaluator<" << vectorName << ">");
+  return Teuchos::rcp(new StatePool<VectorType>(maxDistance, maxStates));
+}
+
+} // namespace TriKota
+
+#endif //TRIKOTA_ADAPTERCORE
@@ -0,0 +1,255 @@
+// @HEADER
+// ************************************************************************
+// 
+//        TriKota: A Trilinos Wrapper for the Dakota Framework
+//                  Copyright (2009) Sandia Corporation
+// 
+// Under the terms of Contract DE-AC04-94AL85000 with Sandia Corporation,
+// the U.S. Government retains certain rights in this software.
+// 
+// This library is free software; you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation; either version 2.1 of the
+// License, or (at your option) any later version.
+//  
+// This library is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301
+// USA
+// 
+// Questions? Contact Andy Salinger (agsalin@sandia.gov), Sandia
+// National Laboratories.
+// 
+// ************************************************************************
+// @HEADER
+
+#include "TriKota_BlockedModelEvaluator.hpp"
+
+#include "Thyra_ProductVectorBase.hpp"
+#include "Thyra_ProductMultiVectorBase.hpp"
+#include "Thyra_VectorStdOps.hpp"
+#include "Teuchos_Assert.hpp"
+
+typedef Thyra::ModelEvaluatorBase MEB;
+
+TriKota::BlockedModelEvaluator::BlockedModelEvaluator(
+  const Teuchos::RCP<Thyra::ModelEvaluator<double> >& model_,
+  const Teuchos::Array<int>& p_indices_,
+  const Teuchos::Array<int>& g_indices_)
+  : model(model_),
+    p_indices(p_indices_),
+    g_indices(g_indices_),
+    activeSetModel(0),
+    warmStartModel(0),
+    forwardReuseModel(0),
+    activeBlocks(g_indices_.size(), true)
+{
+  TEUCHOS_TEST_FOR_EXCEPTION(model == Teuchos::null, std::logic_error,
+    "TriKota Adapter Error: BlockedModelEvaluator needs a model");
+  TEUCHOS_TEST_FOR_EXCEPTION(p_indices.size() == 0 || g_indices.size() == 0, std::logic_error,
+    "TriKota Adapter Error: BlockedModelEvaluator needs at least one p and one g index");
+
+  Teuchos::Array<Teuchos::RCP<const Thyra::VectorSpaceBase<double> > > p_spaces, g_spaces;
+  Thyra::Ordinal offset = 0;
+  for (int l=0; l<p_indices.size(); l++) {
+    TEUCHOS_TEST_FOR_EXCEPTION(p_indices[l] < 0 || p_indices[l] >= model->Np(), std::logic_error,
+      "TriKota Adapter Error: p index " << p_indices[l] << " out of range");
+    p_spaces.push_back(model->get_p_space(p_indices[l]));
+    pOffsets.push_back(offset);
+    offset += p_spaces.back()->dim();
+  }
+  offset = 0;
+  for (int j=0; j<g_indices.size(); j++) {
+    TEUCHOS_TEST_FOR_EXCEPTION(g_indices[j] < 0 || g_indices[j] >= model->Ng(), std::logic_error,
+      "TriKota Adapter Error: g index " << g_indices[j] << " out of range");
+    g_spaces.push_back(model->get_g_space(g_indices[j]));
+    gOffsets.push_back(offset);
+    offset += g_spaces.back()->dim();
+  }
+  p_space = Thyra::productVectorSpace<double>(p_spaces());
+  g_space = Thyra::productVectorSpace<double>(g_spaces());
+
+  // Sensitivities in an orientation are available only if every block
+  // pair supports it
+  prototypeOutArgs = model->createOutArgs();
+  bool allTrans = true, allByCol = true;
+  for (int j=0; j<g_indices.size(); j++) {
+    for (int l=0; l<p_indices.size(); l++) {
+      const MEB::DerivativeSupport support =
+        prototypeOutArgs.supports(MEB::OUT_ARG_DgDp, g_indices[j], p_indices[l]);
+      allTrans = allTrans && support.supports(MEB::DERIV_TRANS_MV_BY_ROW);
+      allByCol = allByCol && support.supports(MEB::DERIV_MV_BY_COL);
+    }
+  }
+  if (allTrans) supportDgDp.plus(MEB::DERIV_TRANS_MV_BY_ROW);
+  if (allByCol) supportDgDp.plus(MEB::DERIV_MV_BY_COL);
+
+  nominalInArgs = model->createInArgs();
+  nominalInArgs.setArgs(model->getNominalValues(), true);
+
+  activeSetModel = dynamic_cast<const ActiveSetModelEvaluator*>(model.get());
+  warmStartModel =
+    dynamic_cast<const WarmStartModelEvaluator<Thyra::VectorBase<double> >*>(model.get());
+  forwardReuseModel = dynamic_cast<const ForwardReuseModelEvaluator*>(model.get());
+}
+
+MEB::InArgs<double> TriKota::BlockedModelEvaluator::getNominalValues() const
+{
+  const MEB::InArgs<double> modelNominal = model->getNominalValues();
+  const Teuchos::RCP<Thyra::VectorBase<double> > p_init = Thyra::createMember<double>(p_space);
+  const Teuchos::RCP<Thyra::ProductVectorBase<double> > p_prod =
+    Teuchos::rcp_dynamic_cast<Thyra::ProductVectorBase<double> >(p_init, true);
+  for (int l=0; l<p_indices.size(); l++) {
+    const Teuchos::RCP<const Thyra::VectorBase<double> > p_l = modelNominal.get_p(p_indices[l]);
+    if (p_l != Teuchos::null) Thyra::assign(p_prod->getNonconstVectorBlock(l).ptr(), *p_l);
+    else                      Thyra::assign(p_prod->getNonconstVectorBlock(l).ptr(), 0.0);
+  }
+
+  MEB::InArgs<double> nominal = createInArgs();
+  nominal.set_p(0, p_init);
+  return nominal;
+}
+
+Teuchos::RCP<const Thyra::VectorSpaceBase<double> >
+TriKota::BlockedModelEvaluator::get_p_space(int l) const
+{
+  TEUCHOS_ASSERT_IN_RANGE_UPPER_EXCLUSIVE(l, 0, 1);
+  return p_space;
+}
+
+Teuchos::RCP<const Thyra::VectorSpaceBase<double> >
+TriKota::BlockedModelEvaluator::get_g_space(int j) const
+{
+  TEUCHOS_ASSERT_IN_RANGE_UPPER_EXCLUSIVE(j, 0, 1);
+  return g_space;
+}
+
+MEB::InArgs<double> TriKota::BlockedModelEvaluator::createInArgs() const
+{
+  MEB::InArgsSetup<double> inArgs;
+  inArgs.setModelEvalDescription(this->description());
+  inArgs.set_Np(1);
+  return inArgs;
+}
+
+MEB::OutArgs<double> TriKota::BlockedModelEvaluator::createOutArgsImpl() const
+{
+  MEB::OutArgsSetup<double> outArgs;
+  outArgs.setModelEvalDescription(this->description());
+  outArgs.set_Np_Ng(1, 1);
+  if (!supportDgDp.none()) outArgs.setSupports(MEB::OUT_ARG_DgDp, 0, 0, supportDgDp);
+  return outArgs;
+}
+
+void TriKota::BlockedModelEvaluator::evalModelImpl(const MEB::InArgs<double>& inArgs,
+                                                   const MEB::OutArgs<double>& outArgs) const
+{
+  using Teuchos::RCP;
+  using Teuchos::Range1D;
+  using Teuchos::rcp_dynamic_cast;
+
+  // Local copies: concurrent evaluations must not share argument objects
+  MEB::InArgs<double> modelInArgs = nominalInArgs;
+  MEB::OutArgs<double> modelOutArgs = prototypeOutArgs;
+
+  const RCP<const Thyra::ProductVectorBase<double> > p =
+    rcp_dynamic_cast<const Thyra::ProductVectorBase<double> >(inArgs.get_p(0), true);
+  for (int l=0; l<p_indices.size(); l++)
+    modelInArgs.set_p(p_indices[l], p->getVectorBlock(l));
+
+  const RCP<Thyra::ProductVectorBase<double> > g =
+    rcp_dynamic_cast<Thyra::ProductVectorBase<double> >(outArgs.get_g(0));
+  for (int j=0; j<g_indices.size(); j++)
+    modelOutArgs.set_g(g_indices[j],
+      (g != Teuchos::null) ? g->getNonconstVectorBlock(j) : Teuchos::null);
+
+  // Hand out the (j,l) sub-blocks of the blocked DgDp
+  const MEB::Derivative<double> DgDp =
+    supportDgDp.none() ? MEB::Derivative<double>() : outArgs.get_DgDp(0, 0);
+  const MEB::EDerivativeMultiVectorOrientation orientation =
+    DgDp.isEmpty() ? MEB::DERIV_MV_BY_COL : DgDp.getMultiVectorOrientation();
+  const RCP<Thyra::ProductMultiVectorBase<double> > DgDp_mv = DgDp.isEmpty() ?
+    Teuchos::null :
+    rcp_dynamic_cast<Thyra::ProductMultiVectorBase<double> >(DgDp.getMultiVector(), true);
+
+  for (int j=0; j<g_indices.size(); j++) {
+    for (int l=0; l<p_indices.size(); l++) {
+      if (supportDgDp.none()) continue;
+      if (DgDp_mv == Teuchos::null || !activeBlocks[j]) {
+        modelOutArgs.set_DgDp(g_indices[j], p_indices[l], MEB::Derivative<double>());
+        continue;
+      }
+      RCP<Thyra::MultiVectorBase<double> > block;
+      if (orientation == MEB::DERIV_TRANS_MV_BY_ROW) {
+        const Thyra::Ordinal dim_g = g_space->getBlock(j)->dim();
+        block = DgDp_mv->getNonconstMultiVectorBlock(l)->subView(
+          Range1D(gOffsets[j], gOffsets[j]+dim_g-1));
+      }
+      else {
+        const Thyra::Ordinal dim_p = p_space->getBlock(l)->dim();
+        block = DgDp_mv->getNonconstMultiVectorBlock(j)->subView(
+          Range1D(pOffsets[l], pOffsets[l]+dim_p-1));
+      }
+      modelOutArgs.set_DgDp(g_indices[j], p_indices[l],
+        MEB::DerivativeMultiVector<double>(block, orientation));
+    }
+  }
+
+  model->evalModel(modelInArgs, modelOutArgs);
+}
+
+void TriKota::BlockedModelEvaluator::setActiveGradients(
+  const int g_index, const Teuchos::ArrayView<const int>& responses) const
+{
+  TEUCHOS_ASSERT_IN_RANGE_UPPER_EXCLUSIVE(g_index, 0, 1);
+
+  // Split the (increasing) blocked indices at the block offsets
+  Teuchos::Array<Teuchos::Array<int> > blockResponses(g_indices.size());
+  int j = 0;
+  for (int c=0; c<responses.size(); c++) {
+    while (j+1 < g_indices.size() && responses[c] >= gOffsets[j+1]) j++;
+    blockResponses[j].push_back(responses[c] - gOffsets[j]);
+  }
+
+  for (j=0; j<g_indices.size(); j++) {
+    const int dim_g = g_space->getBlock(j)->dim();
+    activeBlocks[j] = responses.size() == 0 || blockResponses[j].size() > 0;
+
+    // An empty list means all responses of the block
+    if (blockResponses[j].size() == dim_g) blockResponses[j].clear();
+    if (activeSetModel != 0 && activeBlocks[j])
+      activeSetModel->setActiveGradients(g_indices[j], blockResponses[j]());
+  }
+}
+
+void TriKota::BlockedModelEvaluator::setInitialState(
+  const Teuchos::RCP<const Thyra::VectorBase<double> >& x) const
+{
+  TEUCHOS_TEST_FOR_EXCEPTION(warmStartModel == 0, std::logic_error,
+    "TriKota Adapter Error: warm starting a BlockedModelEvaluator needs a wrapped model"
+    " that is a TriKota::WarmStartModelEvaluator<Thyra::VectorBase<double>>");
+  warmStartModel->setInitialState(x);
+}
+
+Teuchos::RCP<const Thyra::VectorBase<double> >
+TriKota::BlockedModelEvaluator::getLastState() const
+{
+  TEUCHOS_TEST_FOR_EXCEPTION(warmStartModel == 0, std::logic_error,
+    "TriKota Adapter Error: warm starting a BlockedModelEvaluator needs a wrapped model"
+    " that is a TriKota::WarmStartModelEvaluator<Thyra::VectorBase<double>>");
+  return warmStartModel->getLastState();
+}
+
+void TriKota::BlockedModelEvaluator::setReuseForwardSolve(const int g_index,
+                                                          const bool reuse) const
+{
+  TEUCHOS_ASSERT_IN_RANGE_UPPER_EXCLUSIVE(g_index, 0, 1);
+  if (forwardReuseModel == 0) return;
+  for (int j=0; j<g_indices.size(); j++)
+    forwardReuseModel->setReuseForwardSolve(g_indices[j], reuse);
+}
@@ -0,0 +1,151 @@
+// @HEADER
+// ************************************************************************
+// 
+//        TriKota: A Trilinos Wrapper for the Dakota Framework
+//                  Copyright (2009) Sandia Corporation
+// 
+// Under the terms of Contract DE-AC04-94AL85000 with Sandia Corporation,
+// the U.S. Government retains certain rights in this software.
+// 
+// This library is free software; you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation; either version 2.1 of the
+// License, or (at your option) any later version.
+//  
+// This library is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301
+// USA
+// 
+// Questions? Contact Andy Salinger (agsalin@sandia.gov), Sandia
+// National Laboratories.
+// 
+// ************************************************************************
+// @HEADER
+
+#ifndef TRIKOTA_BLOCKEDMODELEVALUATOR
+#define TRIKOTA_BLOCKEDMODELEVALUATOR
+
+#include "Thyra_ResponseOnlyModelEvaluatorBase.hpp"
+#include "Thyra_DefaultProductVectorSpace.hpp"
+#include "TriKota_ModelEvaluatorExtensions.hpp"
+
+#include "Teuchos_RCP.hpp"
+#include "Teuchos_Array.hpp"
+
+namespace TriKota {
+
+/*! \brief Response-only view of several parameter and response blocks
+  of a Thyra::ModelEvaluator as a single p and a single g.
+  The parameter space is the product of the spaces of p_indices and the
+  response space the product of the spaces of g_indices, in the order
+  given, so Dakota's continuous variables and response functions are
+  laid out block after block. Every evaluation is one evalModel call on
+  the underlying model requesting all g_j and DgDp(j,l), so one forward
+  (and adjoint) solve serves all blocks. The other inputs of the model
+  are held at its nominal values. Evaluations build their own model
+  arguments, so concurrent evalModel calls (setEvaluationThreads) are
+  safe if the wrapped model's are.
+
+  The extensions of the wrapped model are forwarded: an active set is
+  split into the active responses of each block (blocks without any get
+  no DgDp at all, whether or not the wrapped model is a
+  TriKota::ActiveSetModelEvaluator), and warm starting and forward solve
+  reuse are passed through. A TriKota::MultiPointModelEvaluator is not:
+  its evalMultiPoint covers a single parameter block, so the blocked
+  model is evaluated one point at a time.
+*/
+class BlockedModelEvaluator : public Thyra::ResponseOnlyModelEvaluatorBase<double>,
+                              public ActiveSetModelEvaluator,
+                              public WarmStartModelEvaluator<Thyra::VectorBase<double> >,
+                              public ForwardReuseModelEvaluator
+{
+public:
+
+  //! Map the blocks p_indices and g_indices of model
+  BlockedModelEvaluator(const Teuchos::RCP<Thyra::ModelEvaluator<double> >& model,
+                        const Teuchos::Array<int>& p_indices,
+                        const Teuchos::Array<int>& g_indices);
+
+  //! The wrapped model
+  Teuchos::RCP<Thyra::ModelEvaluator<double> > getUnderlyingModel() const { return model; }
+
+  //! Offset of parameter block l in the blocked parameter vector
+  Thyra::Ordinal parameterOffset(const int l) const { return pOffsets[l]; }
+
+  //! Offset of response block j in the blocked response vector
+  Thyra::Ordinal responseOffset(const int j) const { return gOffsets[j]; }
+
+  /** \name Public functions overridden from ModelEvaulator. */
+  //@{
+
+  int Np() const { return 1; }
+  int Ng() const { return 1; }
+  Thyra::ModelEvaluatorBase::InArgs<double> getNominalValues() const;
+  Teuchos::RCP<const Thyra::VectorSpaceBase<double> > get_p_space(int l) const;
+  Teuchos::RCP<const Thyra::VectorSpaceBase<double> > get_g_space(int j) const;
+  Thyra::ModelEvaluatorBase::InArgs<double> createInArgs() const;
+
+  //@}
+
+  /** \name Extensions forwarded to the wrapped model. */
+  //@{
+
+  /*! \brief Active responses of the blocked g; each block gets its share,
+    renumbered within the block. */
+  void setActiveGradients(const int g_index,
+                          const Teuchos::ArrayView<const int>& responses) const;
+
+  //! Throws unless the wrapped model is a TriKota::WarmStartModelEvaluator
+  void setInitialState(const Teuchos::RCP<const Thyra::VectorBase<double> >& x) const;
+
+  //! Throws unless the wrapped model is a TriKota::WarmStartModelEvaluator
+  Teuchos::RCP<const Thyra::VectorBase<double> > getLastState() const;
+
+  //! Passed to every response block; ignored unless the wrapped model supports it
+  void setReuseForwardSolve(const int g_index, const bool reuse) const;
+
+  //@}
+
+private:
+
+  /** \name Private functions overridden from ModelEvaulatorDefaultBase. */
+  //@{
+
+  Thyra::ModelEvaluatorBase::OutArgs<double> createOutArgsImpl() const;
+  void evalModelImpl(const Thyra::ModelEvaluatorBase::InArgs<double>& inArgs,
+                     const Thyra::ModelEvaluatorBase::OutArgs<double>& outArgs) const;
+
+  //@}
+
+  Teuchos::RCP<Thyra::ModelEvaluator<double> > model;
+  Teuchos::Array<int> p_indices;
+  Teuchos::Array<int> g_indices;
+  Teuchos::Array<Thyra::Ordinal> pOffsets;
+  Teuchos::Array<Thyra::Ordinal> gOffsets;
+  Teuchos::RCP<const Thyra::DefaultProductVectorSpace<double> > p_space;
+  Teuchos::RCP<const Thyra::DefaultProductVectorSpace<double> > g_space;
+  Thyra::ModelEvaluatorBase::DerivativeSupport supportDgDp;
+
+  // Prototypes of the arguments of the underlying model (nominal inputs,
+  // no outputs), copied by every evaluation
+  Thyra::ModelEvaluatorBase::InArgs<double> nominalInArgs;
+  Thyra::ModelEvaluatorBase::OutArgs<double> prototypeOutArgs;
+
+  // Extensions of the underlying model, null if it lacks them
+  const ActiveSetModelEvaluator* activeSetModel;
+  const WarmStartModelEvaluator<Thyra::VectorBase<double> >* warmStartModel;
+  const ForwardReuseModelEvaluator* forwardReuseModel;
+
+  // Blocks with an active response gradient, set by setActiveGradients
+  mutable Teuchos::Array<char> activeBlocks;
+};
+
+} // namespace TriKota
+
+#endif //TRIKOTA_BLOCKEDMODELEVALUATOR
@@ -29,24 +29,66 @@
 // @HEADER
 
 #include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
 #include "TriKota_DirectApplicInterface.hpp"
+#include "TriKota_GradientCopy.hpp"
 #include "DakotaModel.hpp"
+#include "DakotaResponse.hpp"
+#include "ParamResponsePair.hpp"
 #include "Teuchos_VerboseObject.hpp"
+#include "Epetra_Util.h"
 
 using namespace Dakota;
 typedef EpetraExt::ModelEvaluator EEME;
+typedef TriKota::EvaluationStatistics ES;
+
+namespace {
+
+// True if any queued evaluation asks for a gradient (ASV bit 2)
+bool gradientsRequested(const PRPQueue& prp_queue)
+{
+  for (PRPQueueCIter prp_iter = prp_queue.begin(); prp_iter != prp_queue.end(); ++prp_iter) {
+    const ShortArray& asv = prp_iter->active_set().request_vector();
+    for (size_t i=0; i<asv.size(); i++) if (asv[i] & 2) return true;
+  }
+  return false;
+}
+
+} // namespace
 
 // Define interface class
 TriKota::DirectApplicInterface::DirectApplicInterface(
                                 ProblemDescDB& problem_db_,
                                 const Teuchos::RCP<EpetraExt::ModelEvaluator> App_,
 				int p_index_, int g_index_)
-  : Dakota::DirectApplicInterface(problem_db_),
+  : DirectApplicInterface(problem_db_, std::string(), App_, p_index_, g_index_)
+{
+}
+
+TriKota::DirectApplicInterface::DirectApplicInterface(
+                                ProblemDescDB& problem_db_,
+                                const std::string& interface_id,
+                                const Teuchos::RCP<EpetraExt::ModelEvaluator> App_,
+                                int p_index_, int g_index_)
+  : Dakota::DirectApplicInterface(AdapterCore::selectInterface(problem_db_, interface_id)),
     App(App_),
     p_index(p_index_),
     g_index(g_index_),
-    orientation(EEME::DERIV_MV_BY_COL)
+    pOffset(0),
+    rootRank(true),
+    orientation(EEME::DERIV_MV_BY_COL),
+    fdMethod(FD_NONE),
+    fdRelativeStep(1.0e-6),
+    activeSetApp(dynamic_cast<const ActiveSetModelEvaluator*>(App_.get())),
+    warmStartApp(0),
+    forwardReuseApp(dynamic_cast<const ForwardReuseModelEvaluator*>(App_.get())),
+    fnGradsViewPtr(0),
+    orientationSelected(false),
+    evalStats(Teuchos::rcp(new EvaluationStatistics))
 {
+  const std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
   Teuchos::RCP<Teuchos::FancyOStream>
     out = Teuchos::VerboseObjectBase::getDefaultOStream();
 
@@ -58,33 +100,46 @@ TriKota::DirectApplicInterface::DirectApplicInterface(
     numParameters = model_p->GlobalLength();
     numResponses  = model_g->GlobalLength();
 
-    *out << "TriKota:: ModeEval has " << numParameters <<
-            " parameters and " << numResponses << " responses." << std::endl;
+    // Position of the locally owned parameters among all of them
+    int myLength = model_p->MyLength();
+    int scan = myLength;
+    model_p->Comm().ScanSum(&myLength, &scan, 1);
+    pOffset = scan - myLength;
+    rootRank = (model_p->Comm().MyPID() == 0);
+
+    if (model_g->Map().DistributedGlobally()) {
+      const Epetra_Map rootMap = Epetra_Util::Create_Root_Map(*App->get_g_map(g_index));
+      gImporter = Teuchos::rcp(new Epetra_Import(rootMap, model_g->Map()));
+      root_g = Teuchos::rcp(new Epetra_Vector(rootMap, true));
+    }
+
+    if (rootRank)
+      *out << "TriKota:: ModeEval has " << numParameters <<
+              " parameters and " << numResponses << " responses." << std::endl;
 
-    EEME::DerivativeSupport supportDgDp = App->createOutArgs().supports(EEME::OUT_ARG_DgDp, g_index, p_index);
+    supportDgDp = App->createOutArgs().supports(EEME::OUT_ARG_DgDp, g_index, p_index);
     supportsSensitivities = !(supportDgDp.none());
 
     // Create the MultiVector, then the Derivative object
     if (supportsSensitivities) {
-      *out << "TriKota:: ModeEval supports gradients calculation." << std::endl;
+      if (rootRank) *out << "TriKota:: ModeEval supports gradients calculation." << std::endl;
 
-      if (supportDgDp.supports(EEME::DERIV_TRANS_MV_BY_ROW)) {
-        orientation = EEME::DERIV_TRANS_MV_BY_ROW;
-        model_dgdp = Teuchos::rcp(new Epetra_MultiVector(model_p->Map(), numResponses ));
-      }
-      else if (supportDgDp.supports(EEME::DERIV_MV_BY_COL)) {
-        orientation = EEME::DERIV_MV_BY_COL;
-        model_dgdp = Teuchos::rcp(new Epetra_MultiVector(model_g->Map(), numParameters));
-      }
-      else {
-        TEUCHOS_TEST_FOR_EXCEPTION(!supportDgDp.none(), std::logic_error,
+      TEUCHOS_TEST_FOR_EXCEPTION(!supportDgDp.supports(EEME::DERIV_TRANS_MV_BY_ROW) &&
+                                 !supportDgDp.supports(EEME::DERIV_MV_BY_COL), std::logic_error,
               "TriKota Adapter Error: DgDp data type not implemented");
-      }
+      selectOrientation();
     }
 
-    *out << "TriKota:: Setting initial guess from Model Evaluator to Dakota " << std::endl;
+    // The parameters always live in model_p; the outputs are toggled per
+    // evaluation in setOutArgs
+    inArgs = App->createInArgs();
+    inArgs.set_p(p_index, model_p);
+    outArgs = App->createOutArgs();
+
+    if (rootRank)
+      *out << "TriKota:: Setting initial guess from Model Evaluator to Dakota " << std::endl;
 
-    Model& first_model = *(problem_db_.model_list().begin());
+    Model& first_model = AdapterCore::interfaceModel(problem_db_, interface_id);
     unsigned int num_dakota_vars =  first_model.acv();
     Dakota::RealVector drv(num_dakota_vars);
 
@@ -93,7 +148,13 @@ TriKota::DirectApplicInterface::DirectApplicInterface(
                        <<  numParameters << "\n is less then the number of continuous variables\n"
                        << " specified in the dakota.in input file " << num_dakota_vars << "\n" );
 
-    for (unsigned int i=0; i<num_dakota_vars; i++) drv[i] = (*model_p)[i];
+    // Each rank contributes the entries it owns; one reduction assembles them
+    if (num_dakota_vars > 0) {
+      Teuchos::Array<double> local_drv(num_dakota_vars, 0.0);
+      for (int i=0; i<model_p->MyLength(); i++)
+        if (pOffset + i < (int) num_dakota_vars) local_drv[pOffset + i] = (*model_p)[i];
+      model_p->Comm().SumAll(local_drv.getRawPtr(), drv.values(), num_dakota_vars);
+    }
     first_model.continuous_variables(drv);
 
   }
@@ -102,6 +163,9 @@ TriKota::DirectApplicInterface::DirectApplicInterface(
          << "\tModelEvaluator is null. This is OK iff Dakota has assigned"
          << " MPI_COMM_NULL to this Proc " << std::endl;
   }
+
+  evalStats->addStartupTime(std::chrono::duration<double>(
+    std::chrono::steady_clock::now() - begin).count());
 }
 
 int TriKota::DirectApplicInterface::derived_map_ac(const Dakota::String& ac_name)
@@ -115,42 +179,136 @@ int TriKota::DirectApplicInterface::derived_map_ac(const Dakota::String& ac_name
     TEUCHOS_TEST_FOR_EXCEPTION(numFns > numResponses, std::logic_error,
                        "TriKota_Dakota Adapter Error: ");
     TEUCHOS_TEST_FOR_EXCEPTION(hessFlag, std::logic_error,
-                       "TriKota_Dakota Adapter Error: ");
+      "TriKota Adapter Error: EpetraExt::ModelEvaluator provides no Hessians;"
+      " use TriKota::ThyraDirectApplicInterface or numerical/quasi Hessians");
 
-    EEME::InArgs inArgs = App->createInArgs();
-    EEME::OutArgs outArgs = App->createOutArgs();
-
-    TEUCHOS_TEST_FOR_EXCEPTION(gradFlag && !supportsSensitivities, std::logic_error,
-                       "TriKota_Dakota Adapter Error: ");
+    TEUCHOS_TEST_FOR_EXCEPTION(gradFlag && !supportsSensitivities && fdMethod == FD_NONE,
+      std::logic_error, "TriKota Adapter Error: Dakota requests gradients but the"
+      " ModelEvaluator does not support OUT_ARG_DgDp; see setFiniteDifferenceGradients");
 
 //    TEUCHOS_TEST_FOR_EXCEPTION(parallelLib.parallel_configuration().ea_parallel_level().server_intra_communicator()
 //                       != App->MyMPIComm(), std::logic_error,
 //     "TriKota Parallelism Error: derived_map_ac called with different MPI_comm");
  
 
+    ES::Record record;
+    evalStats->startEvaluation(record);
+    record.gradient = gradFlag;
+
+    // Responses whose gradients Dakota asks for; an empty list means all
+    // of the model's
+    activeGrads.clear();
+    const bool allGradients = !gradFlag ||
+      AdapterCore::loadActiveSet(directFnASV, numFns, numResponses, activeGrads);
+
+    // Only compute what the evaluation cache cannot supply
+    bool computeValues, computeGradients;
+    if (lookupCache(computeValues, computeGradients)) {
+      record.cached = true;
+      evalStats->finishEvaluation(record);
+      return 0;
+    }
+
     // Load parameters from Dakota to ModelEval data structure
-    for (unsigned int i=0; i<numVars; i++) (*model_p)[i]=xC[i];
+    {
+      ES::PhaseTimer timer(record, ES::PHASE_COPY_IN, evalStats->timer(ES::PHASE_COPY_IN));
+      loadParameters(xC.values(), numVars, *model_p);
+    }
 
     // Evaluate model
-    inArgs.set_p(p_index,model_p);
-    outArgs.set_g(g_index,model_g);
-    EEME::Derivative model_dgdp_deriv(model_dgdp, orientation); //may be null
-    if (gradFlag) outArgs.set_DgDp(g_index,p_index,model_dgdp_deriv);
-    App->evalModel(inArgs, outArgs);
-
-    for (unsigned int j=0; j<numFns; j++) fnVals[j]= (*model_g)[j];
-
-    if (gradFlag)  {
-      if (orientation == EEME::DERIV_MV_BY_COL) {
-        for (unsigned int i=0; i<numVars; i++)
-          for (unsigned int j=0; j<numFns; j++)
-            fnGrads[j][i]= (*model_dgdp)[i][j];
-      } else {
-        for (unsigned int i=0; i<numFns; i++)
-          for (unsigned int j=0; j<numVars; j++)
-            fnGrads[i][j]= (*model_dgdp)[i][j];
+    // Finite differences only ask the model for responses
+    const bool fdGradients = computeGradients && fdMethod != FD_NONE;
+    const bool dgdpGradients = computeGradients && !fdGradients;
+
+    // When fnGrads has the layout of a row-oriented DgDp, let the model
+    // write the sensitivities straight into Dakota's storage
+    const bool gradsInPlace = dgdpGradients && gradientsViewable();
+    if (gradsInPlace && fnGrads.values() != fnGradsViewPtr) {
+      fnGradsView = Teuchos::rcp(new Epetra_MultiVector(View, model_p->Map(),
+                      fnGrads.values(), fnGrads.stride(), numResponses));
+      fnGradsDeriv = EEME::Derivative(fnGradsView, orientation);
+      fnGradsViewPtr = fnGrads.values();
+    }
+    if (dgdpGradients && !gradsInPlace) allocateSensitivities();
+    setOutArgs(outArgs, model_g, gradsInPlace ? fnGradsDeriv : model_dgdp_deriv,
+               computeValues, dgdpGradients);
+    if (dgdpGradients && activeSetApp != 0)
+      activeSetApp->setActiveGradients(g_index, activeGrads());
+    if (statePool != Teuchos::null)
+      warmStartApp->setInitialState(statePool->nearest(xC.values(), numVars));
+
+    // A gradient request at the point of the last forward solve (e.g. the
+    // values were asked for first) only pays the sensitivity solves
+    const bool reuseForward = forwardReuseApp != 0 && dgdpGradients &&
+      core.atForwardPoint(xC.values(), numVars);
+    if (reuseForward) core.countForwardReuse();
+    core.clearForwardPoint();
+    int failed = 0;
+    try {
+      ES::PhaseTimer timer(record, ES::PHASE_EVAL_MODEL, evalStats->timer(ES::PHASE_EVAL_MODEL));
+      if (computeValues || dgdpGradients) {
+        const ForwardReuseScope reuse(forwardReuseApp, g_index, reuseForward);
+        App->evalModel(inArgs, outArgs);
       }
+      if (fdGradients) {
+        if (computeValues) {
+          const Epetra_Vector& g = rootResponses();
+          if (holdsResponses())
+            for (unsigned int j=0; j<numFns; j++) fnVals[j]= g[j];
+        }
+        computeFiniteDifferenceGradients(fnVals.values());
+      }
+    }
+    catch (const std::exception& e) {
+      failed = 1;
+      *Teuchos::VerboseObjectBase::getDefaultOStream()
+        << "TriKota:: Model evaluation failed: " << e.what() << std::endl;
+    }
+    catch (...) {
+      failed = 1;
+    }
+
+    // A failure is reported to Dakota (failure_capture) by every rank
+    // of the analysis; the time spent is kept in the statistics
+    if (model_p->Comm().NumProc() > 1) {
+      int anyFailed = failed;
+      model_p->Comm().MaxAll(&failed, &anyFailed, 1);
+      failed = anyFailed;
     }
+    if (failed) {
+      record.failed = true;
+      evalStats->finishEvaluation(record);
+      return failed;
+    }
+    // The model's last state belongs to xC only if it ended on the solve
+    // at xC, not on a finite-difference stencil point
+    if (statePool != Teuchos::null && (computeValues || dgdpGradients) && !fdGradients)
+      statePool->insert(xC.values(), numVars, warmStartApp->getLastState());
+
+    // The finite-difference stencil moved the model away from xC
+    if ((computeValues || dgdpGradients) && !fdGradients)
+      core.setForwardPoint(xC.values(), numVars);
+
+    {
+      ES::PhaseTimer timer(record, ES::PHASE_COPY_OUT, evalStats->timer(ES::PHASE_COPY_OUT));
+      if (computeValues && !fdGradients) {
+        const Epetra_Vector& g = rootResponses();
+        if (holdsResponses())
+          for (unsigned int j=0; j<numFns; j++) fnVals[j]= g[j];
+      }
+
+      if (dgdpGradients && !gradsInPlace) {
+        const Epetra_MultiVector& dgdp = rootSensitivities();
+        if (holdsSensitivities())
+          unloadGradients(dgdp, numVars, numFns, fnGrads.values(), fnGrads.stride(),
+                          activeGrads());
+      }
+
+      // Partial gradients must not be served to later requests
+      storeCache(computeValues, computeGradients && allGradients);
+    }
+    record.bytes = ES::evaluationBytes(numVars, numFns, computeValues, computeGradients);
+    evalStats->finishEvaluation(record);
   }
   else {
     TEUCHOS_TEST_FOR_EXCEPTION(parallelLib.parallel_configuration().ea_parallel_level().server_intra_communicator()
@@ -161,6 +319,449 @@ int TriKota::DirectApplicInterface::derived_map_ac(const Dakota::String& ac_name
   return 0;
 }
 
+void TriKota::DirectApplicInterface::loadParameters(const double* x,
+                                                   const unsigned int nVars,
+                                                   Epetra_Vector& p) const
+{
+  // Only the locally owned entries; for a replicated p that is all of them
+  const int myVars = std::min((int) nVars - pOffset, p.MyLength());
+  for (int i=0; i<myVars; i++) p[i] = x[pOffset + i];
+}
+
+const Epetra_Vector& TriKota::DirectApplicInterface::rootResponses() const
+{
+  if (gImporter == Teuchos::null) return *model_g;
+  root_g->Import(*model_g, *gImporter, Insert);
+  return *root_g;
+}
+
+const Epetra_MultiVector& TriKota::DirectApplicInterface::rootSensitivities() const
+{
+  if (dgdpImporter == Teuchos::null) return *model_dgdp;
+  root_dgdp->Import(*model_dgdp, *dgdpImporter, Insert);
+  return *root_dgdp;
+}
+
+bool TriKota::DirectApplicInterface::gradientsViewable() const
+{
+  return orientation == EEME::DERIV_TRANS_MV_BY_ROW
+    && !model_p->Map().DistributedGlobally()
+    && numVars == numParameters
+    && numFns == numResponses
+    && (unsigned int) fnGrads.numRows() == numParameters
+    && (unsigned int) fnGrads.numCols() == numResponses;
+}
+
+void TriKota::DirectApplicInterface::derived_map_asynch(const ParamResponsePair& pair)
+{
+  // Nothing to launch: the queued evaluations are performed together
+  // in wait_local_evaluations
+}
+
+void TriKota::DirectApplicInterface::wait_local_evaluations(PRPQueue& prp_queue)
+{
+  // With finite differences the threads evaluate the stencils instead
+  if (threadPool != Teuchos::null && prp_queue.size() > 1 &&
+      (fdMethod == FD_NONE || !gradientsRequested(prp_queue))) {
+    evalThreaded(prp_queue);
+    return;
+  }
+
+  for (PRPQueueIter prp_iter = prp_queue.begin(); prp_iter != prp_queue.end(); ++prp_iter) {
+    Response response = prp_iter->response();
+    set_local_data(prp_iter->variables(), prp_iter->active_set(), response);
+    if (derived_map_ac(String()) == 0)
+      overlay_response(response);
+    else
+      manage_failure(prp_iter->variables(), prp_iter->active_set(), response,
+                     prp_iter->eval_id());
+    completionSet.insert(prp_iter->eval_id());
+  }
+}
+
+void TriKota::DirectApplicInterface::test_local_evaluations(PRPQueue& prp_queue)
+{
+  // All evaluations are blocking, so testing completes the whole queue
+  wait_local_evaluations(prp_queue);
+}
+
+void TriKota::DirectApplicInterface::setEvaluationThreads(const int numThreads_)
+{
+  const int numThreads = (numThreads_ < 0) ? asynchLocalEvalConcurrency : numThreads_;
+
+  threadPool = Teuchos::null;
+  workspaces.clear();
+  if (App == Teuchos::null || numThreads <= 1) return;
+
+  TEUCHOS_TEST_FOR_EXCEPTION(model_p->Comm().NumProc() > 1, std::logic_error,
+    "TriKota Adapter Error: threaded evaluations require an analysis communicator"
+    " with a single rank, this one has " << model_p->Comm().NumProc());
+
+  // Entries beyond the Dakota variables start from the values in model_p
+  workspaces.resize(numThreads);
+  for (int i=0; i<numThreads; i++) {
+    workspaces[i].p = Teuchos::rcp(new Epetra_Vector(*model_p));
+    workspaces[i].g = Teuchos::rcp(new Epetra_Vector(model_g->Map(), true));
+    workspaces[i].inArgs = App->createInArgs();
+    workspaces[i].inArgs.set_p(p_index, workspaces[i].p);
+    workspaces[i].outArgs = App->createOutArgs();
+  }
+  threadPool = Teuchos::rcp(new ThreadPool(numThreads));
+}
+
+void TriKota::DirectApplicInterface::evalThreaded(PRPQueue& prp_queue)
+{
+  // Everything touching Dakota's data members (and the cache lookups,
+  // which must stay in queue order) happens on this thread
+  core.clearForwardPoint();
+  std::vector<EvalTask> tasks;
+  std::vector<PRPQueueIter> pending;
+  tasks.reserve(prp_queue.size());
+  pending.reserve(prp_queue.size());
+
+  for (PRPQueueIter prp_iter = prp_queue.begin(); prp_iter != prp_queue.end(); ++prp_iter) {
+    Response response = prp_iter->response();
+    set_local_data(prp_iter->variables(), prp_iter->active_set(), response);
+
+    TEUCHOS_TEST_FOR_EXCEPTION(numVars > numParameters, std::logic_error,
+                       "TriKota_Dakota Adapter Error: ");
+    TEUCHOS_TEST_FOR_EXCEPTION(numFns > numResponses, std::logic_error,
+                       "TriKota_Dakota Adapter Error: ");
+    TEUCHOS_TEST_FOR_EXCEPTION(hessFlag, std::logic_error,
+      "TriKota Adapter Error: EpetraExt::ModelEvaluator provides no Hessians;"
+      " use TriKota::ThyraDirectApplicInterface or numerical/quasi Hessians");
+    TEUCHOS_TEST_FOR_EXCEPTION(gradFlag && !supportsSensitivities, std::logic_error,
+                       "TriKota_Dakota Adapter Error: ");
+
+    ES::Record record;
+    evalStats->startEvaluation(record);
+    record.gradient = gradFlag;
+
+    bool computeValues, computeGradients;
+    if (lookupCache(computeValues, computeGradients)) {
+      record.cached = true;
+      evalStats->finishEvaluation(record);
+      overlay_response(response);
+      completionSet.insert(prp_iter->eval_id());
+      continue;
+    }
+
+    // Keep whatever the cache supplied next to the computed parts
+    tasks.push_back(EvalTask());
+    EvalTask& task = tasks.back();
+    task.record = record;
+    task.x.assign(xC.values(), xC.values()+numVars);
+    task.numVars = numVars;
+    task.numFns = numFns;
+    task.computeValues = computeValues;
+    task.computeGradients = computeGradients;
+    task.failed = false;
+    task.allGradients = !gradFlag ||
+      AdapterCore::loadActiveSet(directFnASV, numFns, numResponses, task.activeGrads);
+    task.vals.assign(fnVals.values(), fnVals.values()+numFns);
+    if (gradFlag) {
+      task.grads.resize(std::size_t(numVars)*numFns);
+      TriKota::copyGradientBlock(numVars, numFns, fnGrads.values(), fnGrads.stride(),
+                                 task.grads.data(), numVars);
+    }
+    pending.push_back(prp_iter);
+  }
+
+  // Sensitivity storage of the threads, on the first gradient request
+  for (unsigned int i=0; i<tasks.size(); i++) {
+    if (!tasks[i].computeGradients) continue;
+    for (int w=0; w<workspaces.size(); w++) {
+      if (workspaces[w].dgdp != Teuchos::null) continue;
+      workspaces[w].dgdp = createSensitivities();
+      workspaces[w].dgdpDeriv = EEME::Derivative(workspaces[w].dgdp, orientation);
+    }
+    break;
+  }
+
+  // The threads share the model: drop an active set left by a
+  // one-at-a-time evaluation, they only copy the active columns
+  if (activeSetApp != 0) activeSetApp->setActiveGradients(g_index, Teuchos::null);
+
+  threadPool->run(tasks.size(), [this, &tasks](int i, int worker) {
+    evalTask(workspaces[worker], tasks[i]);
+  });
+
+  for (unsigned int i=0; i<tasks.size(); i++) {
+    const EvalTask& task = tasks[i];
+    Response response = pending[i]->response();
+    set_local_data(pending[i]->variables(), pending[i]->active_set(), response);
+    if (task.failed) {
+      manage_failure(pending[i]->variables(), pending[i]->active_set(), response,
+                     pending[i]->eval_id());
+      completionSet.insert(pending[i]->eval_id());
+      continue;
+    }
+    std::copy(task.vals.begin(), task.vals.end(), fnVals.values());
+    if (gradFlag)
+      TriKota::copyGradientBlock(numVars, numFns, task.grads.data(), numVars,
+                                 fnGrads.values(), fnGrads.stride());
+    storeCache(task.computeValues, task.computeGradients && task.allGradients);
+    overlay_response(response);
+    completionSet.insert(pending[i]->eval_id());
+  }
+}
+
+void TriKota::DirectApplicInterface::evalTask(EvalWorkspace& workspace, EvalTask& task)
+{
+  // Teuchos timers are not thread safe, only the record is updated here
+  {
+    ES::PhaseTimer timer(task.record, ES::PHASE_COPY_IN);
+    loadParameters(task.x.data(), task.numVars, *workspace.p);
+  }
+
+  setOutArgs(workspace.outArgs, workspace.g, workspace.dgdpDeriv,
+             task.computeValues, task.computeGradients);
+  try {
+    ES::PhaseTimer timer(task.record, ES::PHASE_EVAL_MODEL);
+    App->evalModel(workspace.inArgs, workspace.outArgs);
+  }
+  catch (...) {
+    // Handed to Dakota's failure capture once all threads are done
+    task.failed = task.record.failed = true;
+    evalStats->finishEvaluation(task.record);
+    return;
+  }
+
+  {
+    ES::PhaseTimer timer(task.record, ES::PHASE_COPY_OUT);
+    if (task.computeValues)
+      for (unsigned int j=0; j<task.numFns; j++) task.vals[j]= (*workspace.g)[j];
+    if (task.computeGradients)
+      unloadGradients(*workspace.dgdp, task.numVars, task.numFns,
+                      task.grads.data(), task.numVars, task.activeGrads());
+  }
+  task.record.bytes = ES::evaluationBytes(task.numVars, task.numFns,
+                                          task.computeValues, task.computeGradients);
+  evalStats->finishEvaluation(task.record);
+}
+
+void TriKota::DirectApplicInterface::setFiniteDifferenceGradients(
+  const EFiniteDifference method, const double relativeStep,
+  const Teuchos::ArrayView<const double>& steps)
+{
+  TEUCHOS_TEST_FOR_EXCEPTION(method != FD_NONE && steps.size() == 0 && relativeStep <= 0.0,
+    std::logic_error, "TriKota Adapter Error: finite-difference step must be positive, not "
+    << relativeStep);
+  for (int i=0; i<steps.size(); i++)
+    TEUCHOS_TEST_FOR_EXCEPTION(steps[i] == 0.0, std::logic_error,
+      "TriKota Adapter Error: finite-difference step " << i << " is zero");
+  fdMethod = method;
+  fdRelativeStep = relativeStep;
+  fdSteps.assign(steps.begin(), steps.end());
+}
+
+void TriKota::DirectApplicInterface::computeFiniteDifferenceGradients(const double* g0)
+{
+  const int nPoints = finiteDifferencePoints(fdMethod, numVars);
+  if (nPoints == 0 || numFns == 0) return;
+  TEUCHOS_TEST_FOR_EXCEPTION(fdSteps.size() != 0 && fdSteps.size() < (int) numVars,
+    std::logic_error, "TriKota Adapter Error: " << fdSteps.size() <<
+    " finite-difference steps given for " << numVars << " variables");
+
+  // xC is the same on every rank, and so are the steps
+  Teuchos::Array<double> h(numVars);
+  TriKota::finiteDifferenceSteps(numVars, xC.values(), fdRelativeStep,
+    fdSteps.size() ? fdSteps.getRawPtr() : 0, h.getRawPtr());
+
+  // One column per perturbed point, each rank perturbing the entries it owns
+  Epetra_MultiVector P(model_p->Map(), nPoints, false);
+  Epetra_MultiVector G(model_g->Map(), nPoints, true);
+  for (int k=0; k<nPoints; k++) {
+    int i;
+    double step;
+    TriKota::finiteDifferencePoint(fdMethod, k, h.getRawPtr(), i, step);
+    Epetra_Vector& p_k = *P(k);
+    p_k = *model_p;
+    const int local = i - pOffset;
+    if (local >= 0 && local < p_k.MyLength()) p_k[local] = xC[i] + step;
+  }
+
+  if (threadPool != Teuchos::null) {
+    threadPool->run(nPoints, [this, &P, &G](int k, int worker) {
+      EvalWorkspace& workspace = workspaces[worker];
+      *workspace.p = *P(k);
+      setOutArgs(workspace.outArgs, workspace.g, EEME::Derivative(), true, false);
+      App->evalModel(workspace.inArgs, workspace.outArgs);
+      *G(k) = *workspace.g;
+    });
+  }
+  else {
+    // Copies of the argument objects, pointed at the stencil columns
+    EEME::InArgs fdInArgs = inArgs;
+    EEME::OutArgs fdOutArgs = App->createOutArgs();
+    for (int k=0; k<nPoints; k++) {
+      fdInArgs.set_p(p_index, Teuchos::rcp(new Epetra_Vector(View, P, k)));
+      fdOutArgs.set_g(g_index, Teuchos::rcp(new Epetra_Vector(View, G, k)));
+      App->evalModel(fdInArgs, fdOutArgs);
+    }
+  }
+
+  // Dakota reads the gradients on the ranks holding the responses
+  Teuchos::RCP<Epetra_MultiVector> root_G = Teuchos::rcpFromRef(G);
+  if (gImporter != Teuchos::null) {
+    root_G = Teuchos::rcp(new Epetra_MultiVector(root_g->Map(), nPoints, false));
+    root_G->Import(G, *gImporter, Insert);
+  }
+  if (holdsResponses())
+    TriKota::finiteDifferenceGradients(fdMethod, numVars, numFns, h.getRawPtr(), g0,
+      root_G->Values(), root_G->Stride(), fnGrads.values(), fnGrads.stride());
+}
+
+void TriKota::DirectApplicInterface::setSensitivityCosts(const double adjointCost_,
+                                                        const double forwardCost_)
+{
+  core.setSensitivityCosts(adjointCost_, forwardCost_);
+  if (App != Teuchos::null && supportsSensitivities) selectOrientation();
+}
+
+void TriKota::DirectApplicInterface::calibrateSensitivityOrientation()
+{
+  if (App == Teuchos::null || !supportsSensitivities) return;
+
+  double cost[2] = { core.getAdjointCost(), core.getForwardCost() };
+  const EEME::EDerivativeMultiVectorOrientation orientations[2] =
+    { EEME::DERIV_TRANS_MV_BY_ROW, EEME::DERIV_MV_BY_COL };
+  EEME::OutArgs calibrationOutArgs = App->createOutArgs();
+  for (int o=0; o<2; o++) {
+    if (!supportDgDp.supports(orientations[o])) continue;
+    const Teuchos::RCP<Epetra_MultiVector> dgdp = (o == 0) ?
+      Teuchos::rcp(new Epetra_MultiVector(model_p->Map(), numResponses)) :
+      Teuchos::rcp(new Epetra_MultiVector(model_g->Map(), numParameters));
+    calibrationOutArgs.set_DgDp(g_index, p_index, EEME::Derivative(dgdp, orientations[o]));
+
+    const std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+    App->evalModel(inArgs, calibrationOutArgs);
+    double local = std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - begin).count();
+
+    // Every rank has to make the same choice
+    double slowest = local;
+    model_p->Comm().MaxAll(&local, &slowest, 1);
+    const unsigned int solves = (o == 0) ? numResponses : numParameters;
+    cost[o] = AdapterCore::solveCost(slowest, solves);
+  }
+  setSensitivityCosts(cost[0], cost[1]);
+}
+
+void TriKota::DirectApplicInterface::selectOrientation()
+{
+  const bool trans = supportDgDp.supports(EEME::DERIV_TRANS_MV_BY_ROW);
+  const bool byCol = supportDgDp.supports(EEME::DERIV_MV_BY_COL);
+  const EEME::EDerivativeMultiVectorOrientation selected =
+    core.preferAdjoint(trans, byCol, numParameters, numResponses) ?
+    EEME::DERIV_TRANS_MV_BY_ROW : EEME::DERIV_MV_BY_COL;
+  if (orientationSelected && selected == orientation) return;
+  orientationSelected = true;
+  orientation = selected;
+
+  // Storage shaped by the orientation is (re)allocated by the next
+  // gradient request, so studies without gradients never allocate it
+  model_dgdp = Teuchos::null;
+  model_dgdp_deriv = EEME::Derivative();
+  dgdpImporter = Teuchos::null;
+  root_dgdp = Teuchos::null;
+  fnGradsView = Teuchos::null;
+  fnGradsViewPtr = 0;
+  for (int w=0; w<workspaces.size(); w++) {
+    workspaces[w].dgdp = Teuchos::null;
+    workspaces[w].dgdpDeriv = EEME::Derivative();
+  }
+
+  if (rootRank)
+    core.reportOrientation(orientation == EEME::DERIV_TRANS_MV_BY_ROW, trans, byCol,
+                           numParameters, numResponses);
+}
+
+Teuchos::RCP<Epetra_MultiVector>
+TriKota::DirectApplicInterface::createSensitivities() const
+{
+  if (orientation == EEME::DERIV_TRANS_MV_BY_ROW)
+    return Teuchos::rcp(new Epetra_MultiVector(model_p->Map(), numResponses));
+  else
+    return Teuchos::rcp(new Epetra_MultiVector(model_g->Map(), numParameters));
+}
+
+void TriKota::DirectApplicInterface::allocateSensitivities()
+{
+  if (model_dgdp != Teuchos::null) return;
+  model_dgdp = createSensitivities();
+  model_dgdp_deriv = EEME::Derivative(model_dgdp, orientation);
+
+  // Rows of DgDp follow p or g, whichever the orientation puts them on
+  if (model_dgdp->Map().DistributedGlobally()) {
+    const Epetra_Map rootMap = Epetra_Util::Create_Root_Map(
+      (orientation == EEME::DERIV_TRANS_MV_BY_ROW) ?
+      *App->get_p_map(p_index) : *App->get_g_map(g_index));
+    dgdpImporter = Teuchos::rcp(new Epetra_Import(rootMap, model_dgdp->Map()));
+    root_dgdp = Teuchos::rcp(new Epetra_MultiVector(rootMap, model_dgdp->NumVectors()));
+  }
+}
+
+void TriKota::DirectApplicInterface::setOutArgs(
+  EEME::OutArgs& outArgs_, const Teuchos::RCP<Epetra_Vector>& g,
+  const EEME::Derivative& dgdpDeriv,
+  const bool computeValues, const bool computeGradients) const
+{
+  outArgs_.set_g(g_index, computeValues ? g : Teuchos::null);
+  if (supportsSensitivities)
+    outArgs_.set_DgDp(g_index, p_index, computeGradients ? dgdpDeriv : EEME::Derivative());
+}
+
+void TriKota::DirectApplicInterface::unloadGradients(
+  const Epetra_MultiVector& dgdp,
+  const unsigned int nVars, const unsigned int nFns,
+  double* grads, const int ldGrads, const Teuchos::ArrayView<const int>& active) const
+{
+  double* dgdp_values;
+  int dgdp_lda;
+  dgdp.ExtractView(&dgdp_values, &dgdp_lda);
+  if (active.size() == 0) {
+    if (orientation == EEME::DERIV_MV_BY_COL)
+      TriKota::transposeGradientBlock(nFns, nVars, dgdp_values, dgdp_lda, grads, ldGrads);
+    else
+      TriKota::copyGradientBlock(nVars, nFns, dgdp_values, dgdp_lda, grads, ldGrads);
+    return;
+  }
+
+  // Only the gradients of the active responses
+  for (int c=0; c<active.size(); c++) {
+    const std::ptrdiff_t k = active[c];
+    if (orientation == EEME::DERIV_MV_BY_COL)
+      TriKota::transposeGradientBlock(1, nVars, dgdp_values + k, dgdp_lda,
+                                      grads + k*ldGrads, ldGrads);
+    else
+      TriKota::copyGradientBlock(nVars, 1, dgdp_values + k*dgdp_lda, dgdp_lda,
+                                 grads + k*ldGrads, ldGrads);
+  }
+}
+
+void TriKota::DirectApplicInterface::setWarmStart(const double maxDistance, const int maxStates)
+{
+  statePool = AdapterCore::createStatePool(App.get(), maxDistance, maxStates, warmStartApp,
+                                          "Epetra_Vector");
+}
+
+bool TriKota::DirectApplicInterface::lookupCache(bool& computeValues,
+                                                bool& computeGradients)
+{
+  return core.lookup(xC.values(), numVars, numFns, gradFlag,
+                     fnVals.values(), fnGrads.values(), fnGrads.stride(),
+                     computeValues, computeGradients);
+}
+
+void TriKota::DirectApplicInterface::storeCache(const bool computedValues,
+                                               const bool computedGradients)
+{
+  // The journal and the results writer are written by the rank holding the response
+  core.store(xC.values(), numVars, numFns, fnVals.values(), fnGrads.values(), fnGrads.stride(),
+             computedValues, computedGradients, model_p->Comm().MyPID() == 0);
+}
+
 int TriKota::DirectApplicInterface::derived_map_of(const Dakota::String& ac_name)
 {
   Teuchos::RCP<Teuchos::FancyOStream>
@@ -170,7 +771,7 @@ int TriKota::DirectApplicInterface::derived_map_of(const Dakota::String& ac_name
   *out << "Finished Dakota NLS Fitting!: " << std::setprecision(5) << std::endl;
   model_p->Print(*out << "\nParameters!\n");
   model_g->Print(*out << "\nResponses!\n");
-  if (gradFlag)
+  if (gradFlag && model_dgdp != Teuchos::null)
     model_dgdp->Print(*out << "\nSensitivities!\n");
 
   return 0;
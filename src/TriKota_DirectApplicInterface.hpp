@@ -37,11 +37,21 @@
 #include "DirectApplicInterface.hpp"
 #include "ProblemDescDB.hpp"
 
+#include "TriKota_AdapterCore.hpp"
+#include "TriKota_ThreadPool.hpp"
+#include "TriKota_EvaluationStatistics.hpp"
+#include "TriKota_FiniteDifference.hpp"
+#include "TriKota_ModelEvaluatorExtensions.hpp"
+
 #include "EpetraExt_ModelEvaluator.h"
 #include "Epetra_Vector.h"
+#include "Epetra_Import.h"
 #include "Teuchos_RCP.hpp"
+#include "Teuchos_Array.hpp"
 #include "Teuchos_Assert.hpp"
 
+#include <vector>
+
 //!  TriKota namespace
 namespace TriKota {
 
@@ -50,7 +60,8 @@ namespace TriKota {
   and wraps an EpetraExt::ModelEvaluator. It can then be passed in
   as the argument to the TriKota::Driver::run method.
 */
-class DirectApplicInterface : public Dakota::DirectApplicInterface
+class DirectApplicInterface : public Dakota::DirectApplicInterface,
+                              public InstrumentedInterface
 {
 public:
 
@@ -60,11 +71,112 @@ public:
                          const Teuchos::RCP<EpetraExt::ModelEvaluator> App_,
 			 int p_index = 0, int g_index = 0);
 
+   /*! \brief Constructor for the Dakota interface interface_id (the
+     id_interface of its block in the input), for studies over several
+     models run through TriKota::Driver::run(appInterfaces). The adapter
+     reads that interface block and seeds the first model using it; an
+     empty id is the first model of the input. */
+   DirectApplicInterface(Dakota::ProblemDescDB& problem_db_,
+                         const std::string& interface_id,
+                         const Teuchos::RCP<EpetraExt::ModelEvaluator> App_,
+                         int p_index = 0, int g_index = 0);
+
   ~DirectApplicInterface() {};
 
+  /*! \brief Use an evaluation cache (may be shared with other adapters).
+    A null cache (the default) turns caching off. */
+  void setEvaluationCache(const Teuchos::RCP<EvaluationCache>& cache)
+    { core.setEvaluationCache(cache); }
+
+  //! Accessor for the evaluation cache, null if none is used
+  Teuchos::RCP<EvaluationCache> getEvaluationCache() const { return core.getEvaluationCache(); }
+
+  /*! \brief Replay the evaluations of earlier runs from a journal and
+    append the new ones to it. A null journal (the default) turns it off.
+    Give every rank of the analysis communicator a journal over the same
+    file; only rank 0 appends. */
+  void setEvaluationJournal(const Teuchos::RCP<EvaluationJournal>& journal)
+    { core.setEvaluationJournal(journal); }
+
+  //! Accessor for the evaluation journal, null if none is used
+  Teuchos::RCP<EvaluationJournal> getEvaluationJournal() const { return core.getEvaluationJournal(); }
+
+  /*! \brief Stream every evaluation computed by the model (variables,
+    values and, if the writer records them, gradients) to a columnar
+    results file. A null writer (the default) turns it off. Only the
+    analysis rank 0 appends, so the other ranks may pass null. */
+  void setResultsWriter(const Teuchos::RCP<ResultsWriter>& writer)
+    { core.setResultsWriter(writer); }
+
+  //! Accessor for the results writer, null if none is used
+  Teuchos::RCP<ResultsWriter> getResultsWriter() const { return core.getResultsWriter(); }
+
+  /*! \brief Run the evaluations queued in asynchronous mode
+    (\c asynchronous \c evaluation_concurrency = N in the dakota input)
+    concurrently on numThreads local threads, each with its own
+    parameter, response and sensitivity storage. A negative value uses
+    Dakota's evaluation concurrency, 0 or 1 turns threading off (the
+    default). The model must support concurrent evalModel calls and run
+    on an analysis communicator of a single rank.
+  */
+  void setEvaluationThreads(const int numThreads);
+
+  /*! \brief Relative cost of one adjoint solve (DERIV_TRANS_MV_BY_ROW
+    needs one per response) and one forward sensitivity solve
+    (DERIV_MV_BY_COL needs one per parameter). If the model supports
+    both orientations, the one with the smaller numResponses*adjointCost
+    or numParameters*forwardCost is used. Both costs default to 1, which
+    compares the dimensions; ties go to DERIV_TRANS_MV_BY_ROW.
+  */
+  void setSensitivityCosts(const double adjointCost, const double forwardCost);
+
+  /*! \brief Measure the sensitivity costs by timing one DgDp evaluation
+    in each supported orientation at the current parameters (slowest
+    rank), then select the orientation as in setSensitivityCosts(). */
+  void calibrateSensitivityOrientation();
+
+  //! Orientation of the DgDp requested from the model
+  EpetraExt::ModelEvaluator::EDerivativeMultiVectorOrientation
+  getSensitivityOrientation() const { return orientation; }
+
+  /*! \brief Compute the gradients Dakota asks for by finite differences
+    of the responses instead of the model's DgDp (needed when the model
+    does not support OUT_ARG_DgDp). The steps are steps[i] if given (one
+    per Dakota variable), relativeStep*max(|x_i|,1) otherwise. All
+    perturbed points of one gradient are columns of one multivector,
+    evaluated on the evaluation threads if setEvaluationThreads() is on
+    and one by one otherwise. FD_FORWARD reuses the responses at the
+    point itself. FD_NONE (the default) turns it off. */
+  void setFiniteDifferenceGradients(const EFiniteDifference method,
+                                    const double relativeStep = 1.0e-6,
+                                    const Teuchos::ArrayView<const double>& steps = Teuchos::null);
+
+  //! Finite-difference method used for the gradients, FD_NONE if the DgDp is
+  EFiniteDifference getFiniteDifferenceGradients() const { return fdMethod; }
+
+  /*! \brief Warm start the model's nonlinear solves from the state of
+    the nearest earlier evaluation within maxDistance (Euclidean, over
+    Dakota's variables), keeping at most maxStates states. The model
+    must be a TriKota::WarmStartModelEvaluator<Epetra_Vector>; maxStates = 0 turns
+    warm starting off (the default). */
+  void setWarmStart(const double maxDistance, const int maxStates = 8);
+
+  //! Pool of warm start states, null if warm starting is off
+  Teuchos::RCP<StatePool<Epetra_Vector> > getStatePool() const { return statePool; }
+
+  //! Timers and counters of the evaluations performed so far
+  Teuchos::RCP<EvaluationStatistics> getEvaluationStatistics() const { return evalStats; }
+
+  /*! \brief Gradient evaluations that reused the forward solve of the
+    previous evaluation at the same point (see
+    TriKota::ForwardReuseModelEvaluator) */
+  int numForwardReuses() const { return core.numForwardReuses(); }
+
 protected:
 
-  //! Virtual function redefinition from Dakota::DirectApplicInterface
+  /*! \brief Virtual function redefinition from Dakota::DirectApplicInterface.
+    An exception thrown by the model's evalModel is returned as a
+    non-zero fail code, so Dakota's failure_capture handles it. */
   int derived_map_ac(const Dakota::String& ac_name);
 
   //! Virtual function redefinition from Dakota::DirectApplicInterface
@@ -72,8 +184,107 @@ protected:
 
   //int derived_map_if(const Dakota::String& if_name);
 
+  /*! \brief Virtual function redefinition from Dakota::ApplicationInterface.
+    Nothing is launched here: the evaluations are collected in Dakota's
+    queue and performed together in wait_local_evaluations(). */
+  void derived_map_asynch(const Dakota::ParamResponsePair& pair);
+
+  /*! \brief Virtual function redefinition from Dakota::ApplicationInterface.
+    Evaluates the whole queue of pending evaluations, on the evaluation
+    threads if setEvaluationThreads() was called. */
+  void wait_local_evaluations(Dakota::PRPQueue& prp_queue);
+
+  //! Virtual function redefinition from Dakota::ApplicationInterface
+  void test_local_evaluations(Dakota::PRPQueue& prp_queue);
+
 private:
 
+  //! Storage owned by one evaluation thread
+  struct EvalWorkspace {
+    Teuchos::RCP<Epetra_Vector> p;
+    Teuchos::RCP<Epetra_Vector> g;
+    Teuchos::RCP<Epetra_MultiVector> dgdp;
+    EpetraExt::ModelEvaluator::InArgs inArgs;
+    EpetraExt::ModelEvaluator::OutArgs outArgs;
+    EpetraExt::ModelEvaluator::Derivative dgdpDeriv;
+  };
+
+  //! One queued evaluation, detached from the Dakota data members
+  struct EvalTask {
+    std::vector<double> x;
+    unsigned int numVars;
+    unsigned int numFns;
+    bool computeValues;
+    bool computeGradients;
+    bool failed;
+    std::vector<double> vals;
+    std::vector<double> grads;
+    Teuchos::Array<int> activeGrads;
+    bool allGradients;
+    EvaluationStatistics::Record record;
+  };
+
+  //! Evaluate the queue concurrently on the thread pool
+  void evalThreaded(Dakota::PRPQueue& prp_queue);
+
+  //! Evaluate one task with the given workspace (called from the threads)
+  void evalTask(EvalWorkspace& workspace, EvalTask& task);
+
+  /*! \brief Fill fnGrads (on the ranks holding the responses) by finite
+    differences around the parameters in model_p; g0 holds the
+    responses there (e.g. fnVals). */
+  void computeFiniteDifferenceGradients(const double* g0);
+
+  /*! \brief Pick the DgDp orientation from the costs; storage of the
+    previous orientation is released */
+  void selectOrientation();
+
+  //! New DgDp storage in the selected orientation
+  Teuchos::RCP<Epetra_MultiVector> createSensitivities() const;
+
+  //! Allocate model_dgdp and its root importer, on the first gradient request
+  void allocateSensitivities();
+
+  /*! \brief Select the outputs of the persistent outArgs for one
+    evaluation; dgdpDeriv is used when computeGradients is true. */
+  void setOutArgs(EpetraExt::ModelEvaluator::OutArgs& outArgs,
+                  const Teuchos::RCP<Epetra_Vector>& g,
+                  const EpetraExt::ModelEvaluator::Derivative& dgdpDeriv,
+                  const bool computeValues, const bool computeGradients) const;
+
+  /*! \brief Copy the sensitivities dgdp into the Dakota layout grads
+    (e.g. fnGrads), only for the responses in active if it is not empty. */
+  void unloadGradients(const Epetra_MultiVector& dgdp,
+                       const unsigned int nVars, const unsigned int nFns,
+                       double* grads, const int ldGrads,
+                       const Teuchos::ArrayView<const int>& active = Teuchos::null) const;
+
+  //! Copy Dakota's variables x into the locally owned entries of p
+  void loadParameters(const double* x, const unsigned int nVars, Epetra_Vector& p) const;
+
+  //! The responses, gathered to analysis rank 0 if g is distributed
+  const Epetra_Vector& rootResponses() const;
+
+  //! The sensitivities, gathered to analysis rank 0 if DgDp is distributed
+  const Epetra_MultiVector& rootSensitivities() const;
+
+  //! True on the ranks that hold complete responses after rootResponses()
+  bool holdsResponses() const { return gImporter == Teuchos::null || rootRank; }
+
+  //! True on the ranks that hold all sensitivities after rootSensitivities()
+  bool holdsSensitivities() const { return dgdpImporter == Teuchos::null || rootRank; }
+
+  //! True if fnGrads can be used directly as the DgDp storage
+  bool gradientsViewable() const;
+
+  /*! \brief Fill fnVals/fnGrads from the evaluation cache (then the
+    journal) and tell what
+    is left to compute. Returns true if nothing is. */
+  bool lookupCache(bool& computeValues, bool& computeGradients);
+
+  //! Store what was just computed into the evaluation cache and journal
+  void storeCache(const bool computedValues, const bool computedGradients);
+
   // Data
     Teuchos::RCP<EpetraExt::ModelEvaluator> App;
     int p_index;
@@ -83,8 +294,54 @@ private:
     Teuchos::RCP<Epetra_MultiVector> model_dgdp;
     unsigned int numParameters;
     unsigned int numResponses;
+
+    // Distributed p and g: Dakota variable k is the k-th entry of p in
+    // rank order, this rank owns positions pOffset.. of it; g and DgDp
+    // are imported to analysis rank 0, where Dakota reads the response
+    int pOffset;
+    bool rootRank;
+    Teuchos::RCP<Epetra_Import> gImporter;
+    Teuchos::RCP<Epetra_Vector> root_g;
+    Teuchos::RCP<Epetra_Import> dgdpImporter;
+    Teuchos::RCP<Epetra_MultiVector> root_dgdp;
     bool supportsSensitivities;
     EpetraExt::ModelEvaluator::EDerivativeMultiVectorOrientation orientation;
+    EpetraExt::ModelEvaluator::DerivativeSupport supportDgDp;
+
+    // Finite-difference gradients
+    EFiniteDifference fdMethod;
+    double fdRelativeStep;
+    Teuchos::Array<double> fdSteps;
+
+    // Gradient requests restricted to Dakota's active set
+    const ActiveSetModelEvaluator* activeSetApp;
+    Teuchos::Array<int> activeGrads;
+
+    // Warm starts from earlier states
+    const WarmStartModelEvaluator<Epetra_Vector>* warmStartApp;
+    Teuchos::RCP<StatePool<Epetra_Vector> > statePool;
+
+    // Forward solves reused by gradient requests at the same point
+    const ForwardReuseModelEvaluator* forwardReuseApp;
+
+    // Argument objects built once; only their entries change per evaluation
+    EpetraExt::ModelEvaluator::InArgs inArgs;
+    EpetraExt::ModelEvaluator::OutArgs outArgs;
+    EpetraExt::ModelEvaluator::Derivative model_dgdp_deriv;
+
+    // Epetra view of Dakota's fnGrads storage, rebuilt if it moves
+    Teuchos::RCP<Epetra_MultiVector> fnGradsView;
+    EpetraExt::ModelEvaluator::Derivative fnGradsDeriv;
+    double* fnGradsViewPtr;
+    bool orientationSelected;
+
+    // Cache, journal, results writer, active set and orientation costs
+    AdapterCore core;
+    Teuchos::RCP<EvaluationStatistics> evalStats;
+
+    // Threaded asynchronous evaluations
+    Teuchos::RCP<ThreadPool> threadPool;
+    Teuchos::Array<EvalWorkspace> workspaces;
 
 };
 
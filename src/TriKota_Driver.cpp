@@ -30,9 +30,17 @@
 
 #include <iostream>
 #include "TriKota_Driver.hpp"
+#include "TriKota_EvaluationStatistics.hpp"
 #include "Teuchos_VerboseObject.hpp"
+#include "Teuchos_TestForException.hpp"
+
+#include <algorithm>
+#include <thread>
 #ifdef HAVE_MPI
 #include <mpi.h>
+#include "Teuchos_DefaultMpiComm.hpp"
+#else
+#include "Teuchos_DefaultSerialComm.hpp"
 #endif
 
 // Dakota's library environment-related headers
@@ -42,6 +50,130 @@
 using namespace std;
 using namespace Dakota;
 
+namespace {
+
+  //! Stream buffer dropping everything written to it
+  class NullBuffer : public std::streambuf {
+  protected:
+    int overflow(int c) { return traits_type::not_eof(c); }
+    std::streamsize xsputn(const char*, std::streamsize n) { return n; }
+  };
+
+  /*! \brief Points std::cout at a capture buffer (if any) or, if discard,
+    at a NullBuffer for its lifetime */
+  class CaptureOutput {
+  public:
+    CaptureOutput(const Teuchos::RCP<std::ostringstream>& buffer, const bool discard)
+      : saved(0)
+    {
+      if (buffer != Teuchos::null) saved = std::cout.rdbuf(buffer->rdbuf());
+      else if (discard) saved = std::cout.rdbuf(&nullBuffer);
+    }
+    ~CaptureOutput() { if (saved != 0) std::cout.rdbuf(saved); }
+  private:
+    NullBuffer nullBuffer;
+    std::streambuf* saved;
+  };
+
+  //! End of keyword if it is the first word of line, npos otherwise
+  std::string::size_type keywordEnd(const std::string& line, const std::string& keyword)
+  {
+    const std::string::size_type begin = line.find_first_not_of(" \t");
+    if (begin == std::string::npos || line.compare(begin, keyword.size(), keyword) != 0)
+      return std::string::npos;
+    const std::string::size_type end = begin + keyword.size();
+    if (end == line.size() || line.find_first_of(" \t,#\r", end) == end) return end;
+    return std::string::npos;
+  }
+
+  /*! \brief Input text with restart_file deactivated in every interface
+    block, so that Dakota writes no restart records: added to the block's
+    own "deactivate" keyword, or as a new one after "interface" */
+  std::string deactivateRestart(const std::string& input)
+  {
+    const char* blocks[] = { "environment", "method", "model", "variables",
+                             "interface", "responses" };
+    std::vector<std::string> lines;
+    std::istringstream is(input);
+    for (std::string line; std::getline(is, line); ) lines.push_back(line);
+
+    std::vector<std::string> result;
+    for (std::size_t l = 0; l < lines.size(); l++) {
+      result.push_back(lines[l]);
+      if (keywordEnd(lines[l], "interface") == std::string::npos) continue;
+
+      // Lines up to the next block belong to this interface
+      bool merged = false;
+      for (std::size_t k = l+1; k < lines.size(); k++) {
+        bool block = false;
+        for (int b = 0; b < 6; b++)
+          block = block || keywordEnd(lines[k], blocks[b]) != std::string::npos;
+        if (block) break;
+        const std::string::size_type end = keywordEnd(lines[k], "deactivate");
+        if (end != std::string::npos) {
+          if (lines[k].find("restart_file") == std::string::npos)
+            lines[k].insert(end, " restart_file");
+          merged = true;
+        }
+      }
+      if (!merged) result.push_back("  deactivate restart_file");
+    }
+
+    std::ostringstream os;
+    for (std::size_t l = 0; l < result.size(); l++) os << result[l] << "\n";
+    return os.str();
+  }
+
+  //! True if the interface block asks Dakota for a dedicated master rank
+  bool dedicatedMaster(const Teuchos::ParameterList& interface)
+  {
+    if (interface.isType<bool>("dedicated_master") && interface.get<bool>("dedicated_master"))
+      return true;
+    if (!interface.isSublist("evaluation_scheduling")) return false;
+    const Teuchos::ParameterList& scheduling = interface.sublist("evaluation_scheduling");
+    return scheduling.isType<bool>("master") && scheduling.get<bool>("master");
+  }
+
+  template<class T>
+  bool writeArray(std::ostream& os, const Teuchos::ParameterEntry& entry)
+  {
+    if (!entry.isType<Teuchos::Array<T> >()) return false;
+    const Teuchos::Array<T>& values = Teuchos::getValue<Teuchos::Array<T> >(entry);
+    for (int i=0; i<values.size(); i++) os << " " << values[i];
+    return true;
+  }
+
+  void writeKeywords(std::ostream& os, const Teuchos::ParameterList& list,
+                     const std::string& indent)
+  {
+    for (Teuchos::ParameterList::ConstIterator it = list.begin(); it != list.end(); ++it) {
+      const std::string& name = list.name(it);
+      const Teuchos::ParameterEntry& entry = list.entry(it);
+      if (entry.isList()) {
+        os << indent << name << "\n";
+        writeKeywords(os, Teuchos::getValue<Teuchos::ParameterList>(entry), indent + "  ");
+      }
+      else if (entry.isType<bool>()) {
+        if (Teuchos::getValue<bool>(entry)) os << indent << name << "\n";
+      }
+      else if (entry.isType<std::string>()) {
+        os << indent << name << " = '" << Teuchos::getValue<std::string>(entry) << "'\n";
+      }
+      else if (entry.isArray()) {
+        os << indent << name << " =";
+        const bool known = writeArray<double>(os, entry) ||
+          writeArray<int>(os, entry) || writeArray<std::string>(os, entry);
+        TEUCHOS_TEST_FOR_EXCEPTION(!known, std::logic_error,
+           "TriKota Driver Error: unsupported array type for dakota keyword " << name);
+        os << "\n";
+      }
+      else {
+        os << indent << name << " = " << entry.getAny(false) << "\n";
+      }
+    }
+  }
+}
+
 // Dakota driver when linking in as a library 
 // Assumes MPI_COMM_WORLD both for Dakota and the model evaluation
 TriKota::Driver::Driver(std::string dakota_in,  
@@ -50,14 +182,154 @@ TriKota::Driver::Driver(std::string dakota_in,
 			std::string dakota_restart_out,
 			std::string dakota_restart_in,
 			const int stop_restart_evals)
- : rank_zero(true)
+ : construction_begin(std::chrono::steady_clock::now()),
+   rank_zero(true),
+   num_nodes(0),
+   ranks_per_node(1),
+   nodes_aligned(true),
+   align_servers(false),
+   threads_per_rank(1),
+   threads_option(0),
+   startup_time(0.0),
+   startup_reported(false),
+   assigned_interface(0),
+   discard_output(false),
+   summarize_stats(true),
+   num_runs(0)
 {
 
-  Teuchos::RCP<Teuchos::FancyOStream>
-    out = Teuchos::VerboseObjectBase::getDefaultOStream(); 
+#ifdef HAVE_MPI
+  dakota_comm = MPI_COMM_WORLD;
+  node_comm = MPI_COMM_NULL;
+#endif
+
+  printBanner();
+
+  // initialize library environment; no further updates until runtime
+  // (explicit default)
+  dakota_env = Teuchos::rcp(new Dakota::LibraryEnvironment(
+    programOptions(dakota_in, dakota_out, dakota_err, dakota_restart_out,
+                   dakota_restart_in, stop_restart_evals)));
+
+  setupParallelism();
+}
+
+// Dakota driver without any input file, on MPI_COMM_WORLD
+TriKota::Driver::Driver(const Teuchos::ParameterList& options)
+ : construction_begin(std::chrono::steady_clock::now()),
+   rank_zero(true),
+   num_nodes(0),
+   ranks_per_node(1),
+   nodes_aligned(true),
+   align_servers(false),
+   threads_per_rank(1),
+   threads_option(0),
+   startup_time(0.0),
+   startup_reported(false),
+   assigned_interface(0),
+   discard_output(false),
+   summarize_stats(true),
+   num_runs(0)
+{
+#ifdef HAVE_MPI
+  dakota_comm = MPI_COMM_WORLD;
+  node_comm = MPI_COMM_NULL;
+#endif
+
+  Teuchos::ParameterList validOptions(options);
+  const Dakota::ProgramOptions prog_opts = programOptions(validOptions);
+  printBanner();
+
+  const CaptureOutput capture(captured_output, discard_output);
+  dakota_env = Teuchos::rcp(new Dakota::LibraryEnvironment(prog_opts));
 
-  *out << "\nStarting TriKota_Driver!" << endl;
+  setupParallelism();
+}
+
+#ifdef HAVE_MPI
+// Dakota driver without any input file, on a user-supplied communicator
+TriKota::Driver::Driver(MPI_Comm dakota_comm_, const Teuchos::ParameterList& options)
+ : construction_begin(std::chrono::steady_clock::now()),
+   dakota_comm(dakota_comm_),
+   node_comm(MPI_COMM_NULL),
+   rank_zero(true),
+   num_nodes(0),
+   ranks_per_node(1),
+   nodes_aligned(true),
+   align_servers(false),
+   threads_per_rank(1),
+   threads_option(0),
+   startup_time(0.0),
+   startup_reported(false),
+   assigned_interface(0),
+   discard_output(false),
+   summarize_stats(true),
+   num_runs(0)
+{
+  Teuchos::ParameterList validOptions(options);
+  const Dakota::ProgramOptions prog_opts = programOptions(validOptions);
+  printBanner();
+
+  const CaptureOutput capture(captured_output, discard_output);
+  dakota_env = Teuchos::rcp(new Dakota::LibraryEnvironment(dakota_comm, prog_opts));
 
+  setupParallelism();
+}
+#endif
+
+#ifdef HAVE_MPI
+// Dakota driver on a user-supplied communicator, which may be a subset
+// of MPI_COMM_WORLD (e.g. one of several concurrent studies)
+TriKota::Driver::Driver(MPI_Comm dakota_comm_,
+			std::string dakota_in,  
+			std::string dakota_out,
+			std::string dakota_err,
+			std::string dakota_restart_out,
+			std::string dakota_restart_in,
+			const int stop_restart_evals)
+ : construction_begin(std::chrono::steady_clock::now()),
+   dakota_comm(dakota_comm_),
+   node_comm(MPI_COMM_NULL),
+   rank_zero(true),
+   num_nodes(0),
+   ranks_per_node(1),
+   nodes_aligned(true),
+   align_servers(false),
+   threads_per_rank(1),
+   threads_option(0),
+   startup_time(0.0),
+   startup_reported(false),
+   assigned_interface(0),
+   discard_output(false),
+   summarize_stats(true),
+   num_runs(0)
+{
+
+  printBanner();
+
+  dakota_env = Teuchos::rcp(new Dakota::LibraryEnvironment(dakota_comm,
+    programOptions(dakota_in, dakota_out, dakota_err, dakota_restart_out,
+                   dakota_restart_in, stop_restart_evals)));
+
+  setupParallelism();
+}
+#endif
+
+TriKota::Driver::~Driver()
+{
+#ifdef HAVE_MPI
+  if (node_comm != MPI_COMM_NULL) MPI_Comm_free(&node_comm);
+#endif
+}
+
+Dakota::ProgramOptions
+TriKota::Driver::programOptions(const std::string& dakota_in,
+                                const std::string& dakota_out,
+                                const std::string& dakota_err,
+                                const std::string& dakota_restart_out,
+                                const std::string& dakota_restart_in,
+                                const int stop_restart_evals) const
+{
   // set the Dakota input/output/etc in program options
   Dakota::ProgramOptions prog_opts;
   prog_opts.input_file(dakota_in);
@@ -66,14 +338,198 @@ TriKota::Driver::Driver(std::string dakota_in,
   prog_opts.write_restart_file(dakota_restart_out);
   prog_opts.read_restart_file(dakota_restart_in);
   prog_opts.stop_restart_evals(stop_restart_evals);
+  return prog_opts;
+}
 
-  // TODO: could expand this library instantiation to accept an MPI_Comm
-  //       other than world.
-  // initialize library environment; no further updates until runtime
-  // (explicit default)
-  bool done_modifying_db = true;
-  dakota_env = Teuchos::rcp(new Dakota::LibraryEnvironment(prog_opts));
+Dakota::ProgramOptions
+TriKota::Driver::programOptions(Teuchos::ParameterList& options)
+{
+  options.validateParametersAndSetDefaults(*getValidParameters());
+
+  threads_option = options.get<int>("Threads Per Rank");
+  align_servers = options.get<bool>("Node Aligned Servers");
+  if (align_servers) setupNodes();
+
+  Dakota::ProgramOptions prog_opts;
+  const std::string input = options.get<std::string>("Input String");
+  TEUCHOS_TEST_FOR_EXCEPTION(align_servers && !input.empty(), std::logic_error,
+     "TriKota Driver Error: \"Node Aligned Servers\" needs the dakota input in the"
+     " \"Input\" sublist, not in \"Input String\"");
+  const bool write_restart = options.get<bool>("Write Restart");
+  if (!input.empty())
+    prog_opts.input_string(write_restart ? input : deactivateRestart(input));
+  else {
+    TEUCHOS_TEST_FOR_EXCEPTION(options.sublist("Input").numParams() == 0, std::logic_error,
+       "TriKota Driver Error: neither \"Input String\" nor the \"Input\" sublist"
+       " holds a dakota input");
+    if (align_servers) alignServers(options.sublist("Input"));
+    if (!write_restart && options.sublist("Input").isSublist("interface"))
+      options.sublist("Input").sublist("interface").sublist("deactivate")
+        .set<bool>("restart_file", true);
+    prog_opts.input_string(inputFromParameterList(options.sublist("Input")));
+  }
+
+  // Empty names keep Dakota on the standard streams
+  const std::string output = options.get<std::string>("Output File");
+  const std::string error = options.get<std::string>("Error File");
+  if (!output.empty()) prog_opts.output_file(output);
+  if (!error.empty()) prog_opts.error_file(error);
+
+  // Without "Write Restart" the interfaces deactivate the restart file
+  if (write_restart)
+    prog_opts.write_restart_file(options.get<std::string>("Restart Output File"));
+  prog_opts.read_restart_file(options.get<std::string>("Restart Input File"));
+  prog_opts.stop_restart_evals(options.get<int>("Stop Restart Evals"));
+
+  // Ranks other than 0 would only repeat what rank 0 prints
+  int rank = 0;
+#ifdef HAVE_MPI
+  MPI_Comm_rank(dakota_comm, &rank);
+#endif
+  if (options.get<bool>("Capture Output"))
+    captured_output = Teuchos::rcp(new std::ostringstream);
+  else
+    discard_output = (rank != 0 && options.get<bool>("Rank Zero Output Only"));
 
+  return prog_opts;
+}
+
+Teuchos::RCP<const Teuchos::ParameterList> TriKota::Driver::getValidParameters()
+{
+  static Teuchos::RCP<Teuchos::ParameterList> validParams;
+  if (validParams == Teuchos::null) {
+    validParams = Teuchos::rcp(new Teuchos::ParameterList("TriKota::Driver"));
+    validParams->set<std::string>("Input String", "",
+      "Dakota input, as the contents of a dakota.in file");
+    validParams->sublist("Input", false,
+      "Dakota input, one sublist per block (see inputFromParameterList)")
+      .disableRecursiveValidation();
+    validParams->set<std::string>("Output File", "",
+      "Dakota output file, empty for the standard output");
+    validParams->set<std::string>("Error File", "",
+      "Dakota error file, empty for the standard error");
+    validParams->set<bool>("Capture Output", false,
+      "Keep Dakota's standard output in memory (see getOutput)");
+    validParams->set<bool>("Rank Zero Output Only", true,
+      "Discard the standard output of ranks other than 0 (unless \"Capture Output\")");
+    validParams->set<bool>("Write Restart", false,
+      "Write the Dakota restart file \"Restart Output File\"; if false every"
+      " interface block gets \"deactivate restart_file\"");
+    validParams->set<std::string>("Restart Output File", "dakota_restart.out",
+      "Dakota restart file written if \"Write Restart\" is true");
+    validParams->set<std::string>("Restart Input File", "",
+      "Dakota restart file to read, empty for none");
+    validParams->set<int>("Stop Restart Evals", 0,
+      "Number of restart entries to read, 0 for all");
+    validParams->set<bool>("Node Aligned Servers", false,
+      "Give every evaluation server the ranks of one node (sets processors_per_evaluation"
+      " in the interface block of \"Input\")");
+    validParams->set<int>("Threads Per Rank", 0,
+      "Threads per rank reported by getThreadsPerRank, 0 to share the node's hardware threads");
+  }
+  return validParams;
+}
+
+std::string TriKota::Driver::inputFromParameterList(const Teuchos::ParameterList& input)
+{
+  std::ostringstream os;
+  for (Teuchos::ParameterList::ConstIterator it = input.begin(); it != input.end(); ++it) {
+    TEUCHOS_TEST_FOR_EXCEPTION(!input.entry(it).isList(), std::logic_error,
+       "TriKota Driver Error: dakota input entry " << input.name(it)
+       << " is not a block (sublist)");
+    os << input.name(it) << "\n";
+    writeKeywords(os, input.sublist(input.name(it)), "  ");
+  }
+  return os.str();
+}
+
+std::string TriKota::Driver::getOutput() const
+{
+  return (captured_output != Teuchos::null) ? captured_output->str() : std::string();
+}
+
+void TriKota::Driver::printBanner() const
+{
+  // Ranks other than 0 would only repeat it
+  int rank = 0;
+#ifdef HAVE_MPI
+  MPI_Comm_rank(dakota_comm, &rank);
+#endif
+  if (rank == 0 && captured_output == Teuchos::null && !discard_output)
+    *Teuchos::VerboseObjectBase::getDefaultOStream() << "\nStarting TriKota_Driver!" << endl;
+}
+
+void TriKota::Driver::setupNodes()
+{
+  // Known once the nodes have been counted
+  if (num_nodes > 0) return;
+
+#ifdef HAVE_MPI
+  int rank, node_rank;
+  MPI_Comm_rank(dakota_comm, &rank);
+  MPI_Comm_split_type(dakota_comm, MPI_COMM_TYPE_SHARED, rank, MPI_INFO_NULL, &node_comm);
+  MPI_Comm_rank(node_comm, &node_rank);
+  MPI_Comm_size(node_comm, &ranks_per_node);
+
+  int leader = (node_rank == 0) ? 1 : 0;
+  MPI_Allreduce(&leader, &num_nodes, 1, MPI_INT, MPI_SUM, dakota_comm);
+
+  // Dakota hands out consecutive blocks of ranks, which are the nodes
+  // if each node has the same number of ranks and they are consecutive
+  int first = rank - node_rank;
+  MPI_Bcast(&first, 1, MPI_INT, 0, node_comm);
+  int local[3] = { ranks_per_node, -ranks_per_node, (first + node_rank == rank) ? 1 : 0 };
+  int global[3];
+  MPI_Allreduce(local, global, 3, MPI_INT, MPI_MIN, dakota_comm);
+  nodes_aligned = (global[0] == -global[1]) && (global[2] == 1);
+#else
+  num_nodes = 1;
+#endif
+
+  const int hardware = std::thread::hardware_concurrency();
+  threads_per_rank = (threads_option > 0) ? threads_option :
+    std::max(1, hardware/ranks_per_node);
+}
+
+void TriKota::Driver::alignServers(Teuchos::ParameterList& input)
+{
+  TEUCHOS_TEST_FOR_EXCEPTION(!nodes_aligned, std::logic_error,
+     "TriKota Driver Error: \"Node Aligned Servers\" needs the same number of"
+     " consecutive ranks on every node");
+  TEUCHOS_TEST_FOR_EXCEPTION(!input.isSublist("interface"), std::logic_error,
+     "TriKota Driver Error: \"Node Aligned Servers\" needs an \"interface\" block"
+     " in the \"Input\" sublist");
+  Teuchos::ParameterList& interface = input.sublist("interface");
+  if (!interface.isParameter("processors_per_evaluation"))
+    interface.set<int>("processors_per_evaluation", ranks_per_node);
+
+#ifdef HAVE_MPI
+  // With a dedicated master Dakota keeps rank 0 for scheduling and the
+  // servers start at rank 1; without one, whole nodes are split into
+  // peer servers from rank 0
+  const int master = dedicatedMaster(interface) ? 1 : 0;
+  const int ppe = interface.get<int>("processors_per_evaluation");
+  int rank, node_rank;
+  MPI_Comm_rank(dakota_comm, &rank);
+  MPI_Comm_rank(node_comm, &node_rank);
+  const int node_first = rank - node_rank;
+  int inside = 1;
+  if (rank >= master && ppe > 0) {
+    const int server_first = master + ((rank - master)/ppe)*ppe;
+    inside = (server_first >= node_first &&
+              server_first + ppe <= node_first + ranks_per_node) ? 1 : 0;
+  }
+  int all_inside = 1;
+  MPI_Allreduce(&inside, &all_inside, 1, MPI_INT, MPI_MIN, dakota_comm);
+  TEUCHOS_TEST_FOR_EXCEPTION(!all_inside, std::logic_error,
+     "TriKota Driver Error: \"Node Aligned Servers\" cannot fit evaluation servers of "
+     << ppe << " ranks" << (master ? " after Dakota's dedicated master rank" : "")
+     << " into nodes of " << ranks_per_node << " ranks");
+#endif
+}
+
+void TriKota::Driver::setupParallelism()
+{
   // BMA TODO: is the analysis comm needed at construct time? should
   // we protect against model type:
   //
@@ -83,19 +539,38 @@ TriKota::Driver::Driver(std::string dakota_in,
   // ModelList ml = 
   //   dakota_env.filtered_model_list(model_type, interf_type, an_driver);
 
-  // BMA: the following assumes there is only one model and could be
-  // generalized
-  Model& first_model = *(dakota_env->problem_description_db().model_list().begin());
+  Model& first_model = firstModel();
   analysis_comm =
      first_model.parallel_configuration_iterator()->ea_parallel_level().server_intra_communicator();
 
 #ifdef HAVE_MPI
-  // Here we are determining the global rank, not the analysis rank
+  // An analysis communicator spanning nodes pays inter-node
+  // communication inside every evaluation
+  if (align_servers && analysis_comm != MPI_COMM_NULL) {
+    MPI_Comm analysis_node_comm;
+    int analysis_rank, analysis_size, analysis_node_size;
+    MPI_Comm_rank(analysis_comm, &analysis_rank);
+    MPI_Comm_size(analysis_comm, &analysis_size);
+    MPI_Comm_split_type(analysis_comm, MPI_COMM_TYPE_SHARED, analysis_rank,
+                        MPI_INFO_NULL, &analysis_node_comm);
+    MPI_Comm_size(analysis_node_comm, &analysis_node_size);
+    MPI_Comm_free(&analysis_node_comm);
+    if (analysis_node_size != analysis_size && analysis_rank == 0)
+      *Teuchos::VerboseObjectBase::getDefaultOStream()
+        << "TriKota:: Warning: the analysis communicator of " << analysis_size
+        << " ranks spans several nodes" << endl;
+  }
+
+  // Here we are determining the rank within the Dakota communicator,
+  // not the analysis rank
   int rank;
-  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_rank(dakota_comm, &rank);
   if (rank==0) rank_zero = true;
   else         rank_zero = false;
 #endif
+
+  startup_time = std::chrono::duration<double>(
+    std::chrono::steady_clock::now() - construction_begin).count();
 }
 
 
@@ -109,6 +584,20 @@ int TriKota::Driver::getAnalysisComm()
 { return 0; }
 #endif
 
+#ifdef HAVE_MPI
+MPI_Comm TriKota::Driver::getAnalysisComm(const std::string& interface_id)
+{
+  return getModel(interface_id).parallel_configuration_iterator()->
+    ea_parallel_level().server_intra_communicator();
+}
+#else
+int TriKota::Driver::getAnalysisComm(const std::string& interface_id)
+{
+  getModel(interface_id);
+  return 0;
+}
+#endif
+
 ProblemDescDB& TriKota::Driver::getProblemDescDB()
 {
   return dakota_env->problem_description_db();
@@ -117,13 +606,152 @@ ProblemDescDB& TriKota::Driver::getProblemDescDB()
 void TriKota::Driver::run(Dakota::DirectApplicInterface* appInterface)
 {
 
-  Model& first_model = *(dakota_env->problem_description_db().model_list().begin());
-  Interface& interface  = first_model.derived_interface();
+  // Pass a pointer to a Dakota::DirectApplicInterface, once per
+  // interface: repeated runs keep the registration
+  if (appInterface != assigned_interface) {
+    Interface& interface = firstModel().derived_interface();
+    interface.assign_rep(appInterface, false);
+    assigned_interface = appInterface;
+    assigned_interfaces.clear();
+  }
+
+  reportStartup(appInterface);
+  if (captured_output != Teuchos::null) captured_output->str("");
+  {
+    const CaptureOutput capture(captured_output, discard_output);
+    dakota_env->execute();
+  }
+  num_runs++;
+
+  if (summarize_stats) summarize(appInterface);
+}
+
+void TriKota::Driver::run(const std::map<std::string, Dakota::DirectApplicInterface*>& appInterfaces)
+{
+  typedef std::map<std::string, Dakota::DirectApplicInterface*>::const_iterator Iter;
+
+  // Each model of a listed interface gets that adapter, once
+  ModelList& models = dakota_env->problem_description_db().model_list();
+  for (Iter it = appInterfaces.begin(); it != appInterfaces.end(); ++it) {
+    bool found = false;
+    for (ModelLIter ml_iter = models.begin(); ml_iter != models.end(); ++ml_iter) {
+      if (ml_iter->interface_id() != it->first) continue;
+      found = true;
+      Dakota::DirectApplicInterface*& assigned = assigned_interfaces[&*ml_iter];
+      if (assigned != it->second) {
+        ml_iter->derived_interface().assign_rep(it->second, false);
+        assigned = it->second;
+      }
+    }
+    TEUCHOS_TEST_FOR_EXCEPTION(!found, std::logic_error,
+       "TriKota Driver Error: no model of the dakota input uses the interface "
+       << it->first);
+  }
+  assigned_interface = 0;
+
+  for (Iter it = appInterfaces.begin(); it != appInterfaces.end(); ++it)
+    reportStartup(it->second);
+  if (captured_output != Teuchos::null) captured_output->str("");
+  {
+    const CaptureOutput capture(captured_output, discard_output);
+    dakota_env->execute();
+  }
+  num_runs++;
+
+  if (summarize_stats)
+    for (Iter it = appInterfaces.begin(); it != appInterfaces.end(); ++it)
+      summarize(it->second, it->first);
+}
+
+void TriKota::Driver::reportStartup(const Dakota::DirectApplicInterface* appInterface)
+{
+  // Charged once, to the first instrumented adapter run
+  const InstrumentedInterface* instrumented =
+    dynamic_cast<const InstrumentedInterface*>(appInterface);
+  if (startup_reported || instrumented == 0 ||
+      instrumented->getEvaluationStatistics() == Teuchos::null) return;
+  instrumented->getEvaluationStatistics()->addStartupTime(startup_time);
+  startup_reported = true;
+}
+
+void TriKota::Driver::summarize(const Dakota::DirectApplicInterface* appInterface,
+                                const std::string& label)
+{
+  // Per-rank evaluation statistics of the TriKota adapters
+  const InstrumentedInterface* instrumented =
+    dynamic_cast<const InstrumentedInterface*>(appInterface);
+  if (instrumented == 0 || instrumented->getEvaluationStatistics() == Teuchos::null) return;
+
+  Teuchos::RCP<Teuchos::FancyOStream>
+    out = Teuchos::VerboseObjectBase::getDefaultOStream();
+#ifdef HAVE_MPI
+  const Teuchos::MpiComm<int> comm(Teuchos::opaqueWrapper(dakota_comm));
+#else
+  const Teuchos::SerialComm<int> comm;
+#endif
+  if (!label.empty() && rank_zero) *out << "\nTriKota:: Interface " << label << ":" << endl;
+  instrumented->getEvaluationStatistics()->summarize(*out, comm);
+}
 
-  // Pass a pointer to a Dakota::DirectApplicInterface
-  interface.assign_rep(appInterface, false);
+std::vector<std::string> TriKota::Driver::getInterfaceIds()
+{
+  std::vector<std::string> ids;
+  ModelList& models = dakota_env->problem_description_db().model_list();
+  for (ModelLIter ml_iter = models.begin(); ml_iter != models.end(); ++ml_iter) {
+    const std::string id = ml_iter->interface_id();
+    if (!id.empty() && std::find(ids.begin(), ids.end(), id) == ids.end()) ids.push_back(id);
+  }
+  return ids;
+}
 
-  dakota_env->execute();
+Dakota::Model& TriKota::Driver::getModel(const std::string& interface_id)
+{
+  ModelList& models = dakota_env->problem_description_db().model_list();
+  ModelLIter ml_iter = models.begin();
+  while (ml_iter != models.end() && ml_iter->interface_id() != interface_id) ++ml_iter;
+  TEUCHOS_TEST_FOR_EXCEPTION(ml_iter == models.end(), std::logic_error,
+     "TriKota Driver Error: no model of the dakota input uses the interface "
+     << interface_id);
+  return *ml_iter;
+}
+
+void TriKota::Driver::setInitialPoint(const Dakota::RealVector& x)
+{
+  Model& first_model = firstModel();
+  TEUCHOS_TEST_FOR_EXCEPTION(x.length() != (int) first_model.cv(), std::logic_error,
+     "TriKota Driver Error: initial point of length " << x.length()
+     << ", the model has " << first_model.cv() << " continuous variables");
+  first_model.continuous_variables(x);
+}
+
+void TriKota::Driver::setBounds(const Dakota::RealVector& lower,
+                                const Dakota::RealVector& upper)
+{
+  Model& first_model = firstModel();
+  TEUCHOS_TEST_FOR_EXCEPTION(lower.length() != (int) first_model.cv() ||
+                             upper.length() != (int) first_model.cv(), std::logic_error,
+     "TriKota Driver Error: bounds of length " << lower.length() << " and "
+     << upper.length() << ", the model has " << first_model.cv()
+     << " continuous variables");
+  first_model.continuous_lower_bounds(lower);
+  first_model.continuous_upper_bounds(upper);
+}
+
+void TriKota::Driver::setEqualityTargets(const Dakota::RealVector& targets)
+{
+  Model& first_model = firstModel();
+  TEUCHOS_TEST_FOR_EXCEPTION(
+     targets.length() != (int) first_model.num_nonlinear_eq_constraints(), std::logic_error,
+     "TriKota Driver Error: " << targets.length() << " equality targets, the model has "
+     << first_model.num_nonlinear_eq_constraints() << " equality constraints");
+  first_model.nonlinear_eq_constraint_targets(targets);
+}
+
+Dakota::Model& TriKota::Driver::firstModel()
+{
+  // BMA: the following assumes there is only one model and could be
+  // generalized
+  return *(dakota_env->problem_description_db().model_list().begin());
 }
 
 const Dakota::Variables TriKota::Driver::getFinalSolution() const
@@ -132,3 +760,24 @@ const Dakota::Variables TriKota::Driver::getFinalSolution() const
     throw std::logic_error("getFinalSolution can only be called for rank==0 as of Nov 2010.");
   return dakota_env->variables_results();
 }
+
+void TriKota::Driver::getFinalResults(std::vector<double>& variables,
+                                      std::vector<double>& responses) const
+{
+  int sizes[2] = {0, 0};
+  if (rank_zero) {
+    const Dakota::RealVector& x = dakota_env->variables_results().continuous_variables();
+    const Dakota::RealVector& g = dakota_env->response_results().function_values();
+    variables.assign(x.values(), x.values() + x.length());
+    responses.assign(g.values(), g.values() + g.length());
+    sizes[0] = variables.size();
+    sizes[1] = responses.size();
+  }
+#ifdef HAVE_MPI
+  MPI_Bcast(sizes, 2, MPI_INT, 0, dakota_comm);
+  variables.resize(sizes[0]);
+  responses.resize(sizes[1]);
+  if (sizes[0] > 0) MPI_Bcast(&variables[0], sizes[0], MPI_DOUBLE, 0, dakota_comm);
+  if (sizes[1] > 0) MPI_Bcast(&responses[0], sizes[1], MPI_DOUBLE, 0, dakota_comm);
+#endif
+}
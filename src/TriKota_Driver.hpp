@@ -43,10 +43,19 @@
 namespace Dakota {
   class DirectApplicInterface;
   class LibraryEnvironment;
+  class Model;
+  class ProgramOptions;
 }
 
 //Trilinos includes
 #include "Teuchos_RCP.hpp"
+#include "Teuchos_ParameterList.hpp"
+
+#include <chrono>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
 
 namespace TriKota {
 
@@ -66,7 +75,55 @@ public:
 	 const int stop_restart_evals=0
   	 );
 
-  ~Driver() { }
+  /*! \brief Constructor reading nothing from the file system.
+    The dakota input comes from the string parameter "Input String" or,
+    if absent, from the sublist "Input" (see inputFromParameterList()).
+    Empty "Output File"/"Error File" names (the default) leave Dakota on
+    the standard streams, which "Capture Output" redirects into memory
+    (see getOutput()); ranks other than 0 discard theirs unless "Rank
+    Zero Output Only" is false. Restart output is off (the interface
+    blocks get "deactivate restart_file") unless "Write Restart" is
+    true. getValidParameters() lists all options with their defaults.
+  */
+  Driver(const Teuchos::ParameterList& options);
+
+#ifdef HAVE_MPI
+  /*! \brief Constructor running Dakota on the communicator dakota_comm
+     instead of MPI_COMM_WORLD, e.g. one color of an MPI_Comm_split so that
+     several independent studies share one job. The analysis
+     communicators and rankZero() are relative to dakota_comm.
+  */
+  Driver(MPI_Comm dakota_comm,
+	 std::string dakota_in="dakota.in",  
+	 std::string dakota_out="dakota.out",
+	 std::string dakota_err="dakota.err",
+	 std::string dakota_restart_out="dakota_restart.out",
+	 std::string dakota_restart_in="",
+	 const int stop_restart_evals=0
+  	 );
+
+  //! File-free constructor (see above) on the communicator dakota_comm
+  Driver(MPI_Comm dakota_comm, const Teuchos::ParameterList& options);
+#endif
+
+  ~Driver();
+
+  //! Options of the ParameterList constructors, with their defaults
+  static Teuchos::RCP<const Teuchos::ParameterList> getValidParameters();
+
+  /*! \brief Dakota input text for a parameter list with one sublist per
+    block (environment, method, model, variables, interface, responses),
+    in insertion order. Inside a block a sublist is a keyword followed by
+    its own entries, a true bool a bare keyword (false ones are dropped),
+    an array a list of values and a string a quoted value; other entries
+    are written as keyword = value.
+  */
+  static std::string inputFromParameterList(const Teuchos::ParameterList& input);
+
+  /*! \brief Dakota output captured in memory ("Capture Output") since
+    the start of the last run() (or the construction, before any run),
+    empty otherwise */
+  std::string getOutput() const;
 
   /*! \brief Accessor to get an MPI_Comm from Dakota. This allows Dakota to
      choose the parallelism, and the application to be constructed as a 
@@ -79,6 +136,13 @@ public:
   int      getAnalysisComm(); 
 #endif
 
+  //! Analysis communicator (see above) of the models using the interface interface_id
+#ifdef HAVE_MPI
+  MPI_Comm getAnalysisComm(const std::string& interface_id);
+#else
+  int      getAnalysisComm(const std::string& interface_id);
+#endif
+
   /*! \brief Accessor to get problem description from Dakota. 
     This hook is used within TriKota::DirectApplicInterface to
     (re)set the initial parameters in Dakota using those selected
@@ -89,29 +153,174 @@ public:
   /*! \brief Main call to execute the dakota analysis. 
      The argument may be of type TriKota::DirectApplicInterface, 
      whoch wraps an EpetraExt::ModelEvaluator.
+     Adapters that are a TriKota::InstrumentedInterface get their
+     EvaluationStatistics printed per rank once Dakota is done, so all
+     ranks of the Dakota communicator must call run.
   */
   void run(Dakota::DirectApplicInterface* appInterface);
 
+  /*! \brief Execute the dakota analysis with one adapter per Dakota
+    interface, keyed by the id_interface of the interface blocks, for
+    studies over several models (multifidelity UQ, surrogate based
+    optimization). Every model using one of these interfaces is
+    evaluated through its adapter, on that model's analysis communicator
+    (see getAnalysisComm(interface_id)), so a cheap model can run on small
+    communicators at high evaluation concurrency and an expensive one on
+    wide communicators. All ranks must pass the same ids.
+  */
+  void run(const std::map<std::string, Dakota::DirectApplicInterface*>& appInterfaces);
+
+  //! Ids of the interfaces of the models in the input, each once, in model order
+  std::vector<std::string> getInterfaceIds();
+
+  /*! \brief The first model evaluated through the interface interface_id,
+    e.g. to size the adapter of that interface */
+  Dakota::Model& getModel(const std::string& interface_id);
+
+  /*! \brief Set the initial point of the continuous variables for the
+    next run(). The parsed input and the environment are kept between
+    runs, so a sequence of small studies (e.g. one per time step) only
+    pays for parsing once; without this call a run starts where the
+    previous one left the model.
+  */
+  void setInitialPoint(const Dakota::RealVector& x);
+
+  //! Set the bounds of the continuous variables for the next run()
+  void setBounds(const Dakota::RealVector& lower, const Dakota::RealVector& upper);
+
+  //! Set the targets of the nonlinear equality constraints for the next run()
+  void setEqualityTargets(const Dakota::RealVector& targets);
+
+  /*! \brief Print the statistics summary after every run() (the default).
+    Turn off when run() is called in a tight loop. */
+  void setSummarizeStatistics(const bool summarize) { summarize_stats = summarize; }
+
+  //! Number of completed calls to run()
+  int numRuns() const { return num_runs; }
+
   //! Accessor for final parameters after an optimization run.
   const Dakota::Variables getFinalSolution() const;
 
+  /*! \brief Continuous variables and function values of the final
+    solution, on every rank of the Dakota communicator. Collective: rank
+    0 broadcasts this one point only; the history of the evaluations is
+    streamed by a TriKota::ResultsWriter instead. */
+  void getFinalResults(std::vector<double>& variables,
+                       std::vector<double>& responses) const;
+
   // BMA: do you want Dakota rank 0 or application rank 0
   // I think you could query the Dakota environment for it's rank within the Dakota MPI_Comm...
   //! Query if current processor is rankZero for this iterator
   bool rankZero() const { return rank_zero;};
 
+#ifdef HAVE_MPI
+  //! Accessor for the communicator Dakota runs on (MPI_COMM_WORLD by default)
+  MPI_Comm getDakotaComm() const { return dakota_comm; }
+
+  /*! \brief Ranks of the Dakota communicator that share this rank's node.
+    The nodes are only discovered when first asked for (or for "Node
+    Aligned Servers"): the first call of this or of the accessors below
+    is collective over the Dakota communicator. */
+  MPI_Comm getNodeComm() { setupNodes(); return node_comm; }
+#endif
+
+  //! Number of shared-memory nodes the Dakota communicator spans
+  int numNodes() { setupNodes(); return num_nodes; }
+
+  //! Number of ranks on this rank's node
+  int ranksPerNode() { setupNodes(); return ranks_per_node; }
+
+  /*! \brief True if every node holds the same number of ranks and they
+    are consecutive in the Dakota communicator, so that Dakota's blocks
+    of processors_per_evaluation = ranksPerNode() ranks are the nodes. */
+  bool nodesAligned() { setupNodes(); return nodes_aligned; }
+
+  /*! \brief Threads a multithreaded (Kokkos, OpenMP) model should use
+    on each rank: "Threads Per Rank" if given, otherwise the hardware
+    threads of the node shared by its ranks. Meant for the model factory
+    called with getAnalysisComm(). */
+  int getThreadsPerRank() { setupNodes(); return threads_per_rank; }
+
+  /*! \brief Wall time of the constructor (seconds). It is added to the
+    startup time of the EvaluationStatistics of the first instrumented
+    adapter run. */
+  double getStartupTime() const { return startup_time; }
+
 private:
 
+  //! Program options shared by the constructors
+  Dakota::ProgramOptions programOptions(const std::string& dakota_in,
+                                        const std::string& dakota_out,
+                                        const std::string& dakota_err,
+                                        const std::string& dakota_restart_out,
+                                        const std::string& dakota_restart_in,
+                                        const int stop_restart_evals) const;
+
+  //! Program options of the ParameterList constructors
+  Dakota::ProgramOptions programOptions(Teuchos::ParameterList& options);
+
+  //! Query the analysis communicator and rank once dakota_env exists
+  void setupParallelism();
+
+  //! Discover the nodes of the Dakota communicator (once)
+  void setupNodes();
+
+  //! Print the banner on rank 0 (unless its output is captured)
+  void printBanner() const;
+
+  //! Charge the construction time to the statistics of appInterface, once
+  void reportStartup(const Dakota::DirectApplicInterface* appInterface);
+
+  /*! \brief Make the evaluation servers of the "Input" sublist one node
+    each ("Node Aligned Servers"). Throws if the servers, offset by
+    Dakota's dedicated master rank when the interface block asks for
+    one, would straddle node boundaries. */
+  void alignServers(Teuchos::ParameterList& input);
+
+  //! The model the adapters are registered with (the first in the input)
+  Dakota::Model& firstModel();
+
+  //! Print the statistics of appInterface if it is a TriKota::InstrumentedInterface
+  void summarize(const Dakota::DirectApplicInterface* appInterface,
+                 const std::string& label = "");
+
+  //! Start of the construction, for the startup time
+  const std::chrono::steady_clock::time_point construction_begin;
+
   /// The Dakota library environment that manages Dakota instances
   Teuchos::RCP<Dakota::LibraryEnvironment> dakota_env;
 
 #ifdef HAVE_MPI
+  MPI_Comm dakota_comm;
   MPI_Comm analysis_comm;
+  MPI_Comm node_comm;
 #else
   int      analysis_comm;
 #endif
   bool rank_zero;
 
+  // Node topology of the Dakota communicator
+  int num_nodes;
+  int ranks_per_node;
+  bool nodes_aligned;
+  bool align_servers;
+  int threads_per_rank;
+  int threads_option;
+
+  double startup_time;
+  bool startup_reported;
+
+  //! Interface registered with the model by the last run(), if any
+  Dakota::DirectApplicInterface* assigned_interface;
+  //! Interfaces registered per model by the last run() over interface ids
+  std::map<Dakota::Model*, Dakota::DirectApplicInterface*> assigned_interfaces;
+  //! Standard output of Dakota, when captured
+  Teuchos::RCP<std::ostringstream> captured_output;
+  //! Standard output of Dakota dropped (ranks other than 0)
+  bool discard_output;
+  bool summarize_stats;
+  int num_runs;
+
 }; // end of class Driver
 
 } // namespace TriKota
@@ -0,0 +1,179 @@
+// @HEADER
+// ************************************************************************
+// 
+//        TriKota: A Trilinos Wrapper for the Dakota Framework
+//                  Copyright (2009) Sandia Corporation
+// 
+// Under the terms of Contract DE-AC04-94AL85000 with Sandia Corporation,
+// the U.S. Government retains certain rights in this software.
+// 
+// This library is free software; you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation; either version 2.1 of the
+// License, or (at your option) any later version.
+//  
+// This library is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301
+// USA
+// 
+// Questions? Contact Andy Salinger (agsalin@sandia.gov), Sandia
+// National Laboratories.
+// 
+// ************************************************************************
+// @HEADER
+
+#include "TriKota_EvaluationCache.hpp"
+
+#include <cmath>
+#include <cstring>
+#include <functional>
+
+TriKota::EvaluationCache::EvaluationCache(const double tolerance,
+                                          const std::size_t maxBytes_)
+  : tol(tolerance),
+    maxBytes(maxBytes_),
+    bytes(0),
+    hits(0),
+    partialHits(0),
+    misses(0),
+    evictions(0)
+{
+}
+
+void TriKota::EvaluationCache::lookup(const double* x, const int numVars, const int numFns,
+                                      const bool wantGradients,
+                                      double* g, double* grads, const int ldGrads,
+                                      bool& foundValues, bool& foundGradients)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  foundValues = false;
+  foundGradients = false;
+
+  const EntryList::iterator entry = find(x, numVars, hashPoint(x, numVars));
+  if (entry != entries.end()) {
+    if ((int) entry->g.size() == numFns) {
+      std::memcpy(g, &entry->g[0], sizeof(double)*numFns);
+      foundValues = true;
+    }
+    if (wantGradients && (int) entry->grads.size() == numVars*numFns) {
+      for (int j=0; j<numFns; j++)
+        std::memcpy(grads + j*ldGrads, &entry->grads[j*numVars], sizeof(double)*numVars);
+      foundGradients = true;
+    }
+    // Move to the front of the LRU list; iterators stay valid
+    entries.splice(entries.begin(), entries, entry);
+  }
+
+  if (foundValues && (foundGradients || !wantGradients)) hits++;
+  else if (foundValues || foundGradients)              partialHits++;
+  else                                                 misses++;
+}
+
+void TriKota::EvaluationCache::store(const double* x, const int numVars, const int numFns,
+                                     const double* g, const double* grads, const int ldGrads)
+{
+  if (g == 0 && grads == 0) return;
+  std::lock_guard<std::mutex> lock(mutex);
+
+  const std::size_t hash = hashPoint(x, numVars);
+  EntryList::iterator entry = find(x, numVars, hash);
+  std::size_t oldBytes = 0;
+  if (entry == entries.end()) {
+    entries.push_front(Entry());
+    entry = entries.begin();
+    entry->hash = hash;
+    entry->x.assign(x, x+numVars);
+    index.insert(std::make_pair(hash, entry));
+  }
+  else {
+    oldBytes = entryBytes(*entry);
+    entries.splice(entries.begin(), entries, entry);
+  }
+
+  bytes -= oldBytes;
+  if (g != 0) entry->g.assign(g, g+numFns);
+  if (grads != 0) {
+    entry->grads.resize(numVars*numFns);
+    for (int j=0; j<numFns; j++)
+      std::memcpy(&entry->grads[j*numVars], grads + j*ldGrads, sizeof(double)*numVars);
+  }
+  bytes += entryBytes(*entry);
+
+  evict();
+}
+
+void TriKota::EvaluationCache::clear()
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  entries.clear();
+  index.clear();
+  bytes = 0;
+}
+
+void TriKota::EvaluationCache::print(std::ostream& os) const
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  os << "TriKota::EvaluationCache: " << hits << " hits, "
+     << partialHits << " partial hits (gradient only computed), "
+     << misses << " misses, " << evictions << " evictions, "
+     << entries.size() << " entries using " << bytes << " of "
+     << maxBytes << " bytes" << std::endl;
+}
+
+std::size_t TriKota::EvaluationCache::hashPoint(const double* x, const int numVars) const
+{
+  std::size_t hash = numVars;
+  for (int i=0; i<numVars; i++) {
+    // Hash the tolerance grid cell, or the exact value for tol == 0
+    const std::size_t h = (tol > 0.0) ?
+      std::hash<long long>()(std::llround(x[i]/tol)) :
+      std::hash<double>()(x[i]);
+    hash ^= h + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+  }
+  return hash;
+}
+
+TriKota::EvaluationCache::EntryList::iterator
+TriKota::EvaluationCache::find(const double* x, const int numVars, const std::size_t hash)
+{
+  typedef std::unordered_multimap<std::size_t, EntryList::iterator>::iterator IndexIter;
+  const std::pair<IndexIter, IndexIter> range = index.equal_range(hash);
+  for (IndexIter it = range.first; it != range.second; ++it) {
+    const Entry& entry = *(it->second);
+    if ((int) entry.x.size() != numVars) continue;
+    bool match = true;
+    for (int i=0; i<numVars && match; i++)
+      match = (std::fabs(entry.x[i] - x[i]) <= tol);
+    if (match) return it->second;
+  }
+  return entries.end();
+}
+
+std::size_t TriKota::EvaluationCache::entryBytes(const Entry& entry) const
+{
+  return sizeof(Entry) +
+    sizeof(double)*(entry.x.size() + entry.g.size() + entry.grads.size());
+}
+
+void TriKota::EvaluationCache::evict()
+{
+  typedef std::unordered_multimap<std::size_t, EntryList::iterator>::iterator IndexIter;
+
+  // Never drop the entry that was just stored
+  while (bytes > maxBytes && entries.size() > 1) {
+    const EntryList::iterator last = --entries.end();
+    const std::pair<IndexIter, IndexIter> range = index.equal_range(last->hash);
+    for (IndexIter it = range.first; it != range.second; ++it) {
+      if (it->second == last) { index.erase(it); break; }
+    }
+    bytes -= entryBytes(*last);
+    entries.erase(last);
+    evictions++;
+  }
+}
@@ -0,0 +1,136 @@
+// @HEADER
+// ************************************************************************
+// 
+//        TriKota: A Trilinos Wrapper for the Dakota Framework
+//                  Copyright (2009) Sandia Corporation
+// 
+// Under the terms of Contract DE-AC04-94AL85000 with Sandia Corporation,
+// the U.S. Government retains certain rights in this software.
+// 
+// This library is free software; you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation; either version 2.1 of the
+// License, or (at your option) any later version.
+//  
+// This library is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301
+// USA
+// 
+// Questions? Contact Andy Salinger (agsalin@sandia.gov), Sandia
+// National Laboratories.
+// 
+// ************************************************************************
+// @HEADER
+
+#ifndef TRIKOTA_EVALUATIONCACHE
+#define TRIKOTA_EVALUATIONCACHE
+
+#include <cstddef>
+#include <list>
+#include <mutex>
+#include <ostream>
+#include <unordered_map>
+#include <vector>
+
+namespace TriKota {
+
+/*! \brief Bounded, least-recently-used cache of model evaluations.
+  It can be given to TriKota::DirectApplicInterface or
+  TriKota::ThyraDirectApplicInterface (and shared between several of
+  them) so that repeated requests at the same parameter point, e.g.
+  from several iterators run over one TriKota::Driver, do not call
+  evalModel again. Function values and gradients are cached separately:
+  a gradient request at a point whose values are cached only computes
+  the gradient.
+
+  Points are matched component-wise within an absolute tolerance.
+  They are hashed on the grid of that tolerance, so two points that
+  are within the tolerance but fall on different sides of a grid line
+  are (conservatively) treated as different.
+
+  In parallel runs every rank of the analysis communicator must see the
+  same sequence of lookups and stores, so that all ranks take the same
+  hit/miss decisions; the cached data itself is only required to be
+  correct on the rank that Dakota reads the response from.
+*/
+class EvaluationCache {
+public:
+
+  //! Constructor: matching tolerance and memory budget in bytes
+  EvaluationCache(const double tolerance = 0.0,
+                  const std::size_t maxBytes = 64*1024*1024);
+
+  ~EvaluationCache() {}
+
+  /*! \brief Look up the point x. Cached values are copied into g and
+    (if wantGradients) cached gradients into the column-major numVars x
+    numFns block grads. foundValues/foundGradients tell what was there.
+  */
+  void lookup(const double* x, const int numVars, const int numFns,
+              const bool wantGradients,
+              double* g, double* grads, const int ldGrads,
+              bool& foundValues, bool& foundGradients);
+
+  /*! \brief Store the values g and/or the gradients grads (either may
+    be null) computed at x, merging with an existing entry for x.
+  */
+  void store(const double* x, const int numVars, const int numFns,
+             const double* g, const double* grads, const int ldGrads);
+
+  //! Drop all entries, keeping the counters
+  void clear();
+
+  //! Lookups fully served from the cache
+  int numHits() const { return hits; }
+  //! Lookups where the values were cached but gradients had to be computed
+  int numPartialHits() const { return partialHits; }
+  //! Lookups that found nothing
+  int numMisses() const { return misses; }
+  //! Entries dropped to stay within the memory budget
+  int numEvictions() const { return evictions; }
+  //! Bytes of cached data currently held
+  std::size_t bytesUsed() const { return bytes; }
+
+  //! Print the counters
+  void print(std::ostream& os) const;
+
+private:
+
+  struct Entry {
+    std::size_t hash;
+    std::vector<double> x;
+    std::vector<double> g;
+    std::vector<double> grads;
+  };
+  typedef std::list<Entry> EntryList;
+
+  std::size_t hashPoint(const double* x, const int numVars) const;
+  EntryList::iterator find(const double* x, const int numVars, const std::size_t hash);
+  std::size_t entryBytes(const Entry& entry) const;
+  void evict();
+
+  mutable std::mutex mutex;
+
+  double tol;
+  std::size_t maxBytes;
+  std::size_t bytes;
+
+  // Most recently used entry first, indexed by the hash of the point
+  EntryList entries;
+  std::unordered_multimap<std::size_t, EntryList::iterator> index;
+
+  int hits;
+  int partialHits;
+  int misses;
+  int evictions;
+};
+
+} // namespace TriKota
+
+#endif //TRIKOTA_EVALUATIONCACHE
@@ -0,0 +1,302 @@
+// @HEADER
+// ************************************************************************
+// 
+//        TriKota: A Trilinos Wrapper for the Dakota Framework
+//                  Copyright (2009) Sandia Corporation
+// 
+// Under the terms of Contract DE-AC04-94AL85000 with Sandia Corporation,
+// the U.S. Government retains certain rights in this software.
+// 
+// This library is free software; you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation; either version 2.1 of the
+// License, or (at your option) any later version.
+//  
+// This library is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301
+// USA
+// 
+// Questions? Contact Andy Salinger (agsalin@sandia.gov), Sandia
+// National Laboratories.
+// 
+// ************************************************************************
+// @HEADER
+
+#include "TriKota_EvaluationJournal.hpp"
+
+#include "Teuchos_TestForException.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+  // File header: magic, then format version
+  const char journalMagic[8] = {'T','R','I','K','O','T','A','J'};
+  const unsigned int journalVersion = 1;
+  const std::size_t fileHeaderBytes = 16;
+}
+
+TriKota::EvaluationJournal::EvaluationJournal(const std::string& fileName_,
+                                              const std::size_t flushBytes_)
+  : fileName(fileName_),
+    flushBytes(flushBytes_),
+    mapped(0),
+    mappedBytes(0),
+    validBytes(0),
+    writing(false),
+    stopping(false),
+    writeError(0),
+    file(0),
+    restored(0),
+    hits(0),
+    appended(0)
+{
+  const int fd = ::open(fileName.c_str(), O_RDONLY);
+  if (fd < 0) return; // a new journal
+
+  struct stat st;
+  if (::fstat(fd, &st) == 0 && st.st_size > 0) {
+    void* p = ::mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (p != MAP_FAILED) {
+      mapped = static_cast<const char*>(p);
+      mappedBytes = st.st_size;
+    }
+  }
+  ::close(fd);
+
+  TEUCHOS_TEST_FOR_EXCEPTION(st.st_size > 0 && mapped == 0, std::logic_error,
+     "TriKota Adapter Error: could not map evaluation journal " << fileName);
+  if (mapped == 0) return;
+  try {
+    index();
+  }
+  catch (...) {
+    ::munmap(const_cast<char*>(mapped), mappedBytes);
+    throw;
+  }
+}
+
+TriKota::EvaluationJournal::~EvaluationJournal()
+{
+  if (file != 0) {
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      drain(lock);
+      stopping = true;
+    }
+    writerWake.notify_one();
+    writer.join();
+    if (std::fclose(file) != 0 && writeError == 0) writeError = errno;
+
+    // Destructors must not throw
+    if (writeError != 0)
+      std::cerr << "TriKota:: Warning: evaluation journal " << fileName
+                << " is incomplete: " << std::strerror(writeError) << std::endl;
+  }
+  if (mapped != 0) ::munmap(const_cast<char*>(mapped), mappedBytes);
+}
+
+void TriKota::EvaluationJournal::lookup(const double* x, const int numVars, const int numFns,
+                                        const bool wantGradients,
+                                        double* g, double* grads, const int ldGrads,
+                                        bool& foundValues, bool& foundGradients)
+{
+  foundValues = false;
+  foundGradients = false;
+  if (offsets.empty()) return;
+
+  typedef std::unordered_multimap<std::size_t, std::size_t>::const_iterator IndexIter;
+  const std::pair<IndexIter, IndexIter> range = offsets.equal_range(hashPoint(x, numVars));
+  for (IndexIter it = range.first; it != range.second; ++it) {
+    RecordHeader rh;
+    std::memcpy(&rh, mapped + it->second, sizeof(RecordHeader));
+    if ((int) rh.numVars != numVars || (int) rh.numFns != numFns) continue;
+    const double* data = reinterpret_cast<const double*>(mapped + it->second + sizeof(RecordHeader));
+    if (std::memcmp(data, x, sizeof(double)*numVars) != 0) continue;
+
+    std::memcpy(g, data + numVars, sizeof(double)*numFns);
+    foundValues = true;
+    if (wantGradients && (rh.flags & HAS_GRADIENTS)) {
+      const double* recGrads = data + numVars + numFns;
+      for (int j=0; j<numFns; j++)
+        std::memcpy(grads + j*ldGrads, recGrads + j*numVars, sizeof(double)*numVars);
+      foundGradients = true;
+    }
+    // A later record of the same point can only add gradients
+    if (foundGradients || !wantGradients) break;
+  }
+
+  if (foundValues) {
+    std::lock_guard<std::mutex> lock(mutex);
+    hits++;
+  }
+}
+
+void TriKota::EvaluationJournal::append(const double* x, const int numVars, const int numFns,
+                                        const double* g, const double* grads, const int ldGrads)
+{
+  if (g == 0) return;
+  std::lock_guard<std::mutex> lock(mutex);
+  checkWrites();
+  if (file == 0) openForAppend();
+
+  RecordHeader rh;
+  rh.numVars = numVars;
+  rh.numFns = numFns;
+  rh.flags = (grads != 0) ? HAS_GRADIENTS : 0;
+  rh.reserved = 0;
+
+  const std::size_t numDoubles = numVars + numFns + ((grads != 0) ? numVars*numFns : 0);
+  const std::size_t start = buffer.size();
+  buffer.resize(start + sizeof(RecordHeader) + sizeof(double)*numDoubles);
+  char* out = &buffer[start];
+  std::memcpy(out, &rh, sizeof(RecordHeader));         out += sizeof(RecordHeader);
+  std::memcpy(out, x, sizeof(double)*numVars);         out += sizeof(double)*numVars;
+  std::memcpy(out, g, sizeof(double)*numFns);          out += sizeof(double)*numFns;
+  if (grads != 0) {
+    for (int j=0; j<numFns; j++) {
+      std::memcpy(out, grads + j*ldGrads, sizeof(double)*numVars);
+      out += sizeof(double)*numVars;
+    }
+  }
+  appended++;
+
+  // Hand a full buffer to the writer unless it is still busy with the last one
+  if (buffer.size() >= flushBytes && pending.empty()) {
+    pending.swap(buffer);
+    writerWake.notify_one();
+  }
+}
+
+void TriKota::EvaluationJournal::flush()
+{
+  std::unique_lock<std::mutex> lock(mutex);
+  if (file == 0) return;
+  drain(lock);
+  checkWrites();
+}
+
+void TriKota::EvaluationJournal::drain(std::unique_lock<std::mutex>& lock)
+{
+  writerDone.wait(lock, [this]{ return pending.empty() && !writing; });
+  if (buffer.empty()) return;
+  pending.swap(buffer);
+  writerWake.notify_one();
+  writerDone.wait(lock, [this]{ return pending.empty() && !writing; });
+}
+
+void TriKota::EvaluationJournal::checkWrites() const
+{
+  TEUCHOS_TEST_FOR_EXCEPTION(writeError != 0, std::logic_error,
+     "TriKota Adapter Error: could not write evaluation journal " << fileName
+     << ": " << std::strerror(writeError));
+}
+
+void TriKota::EvaluationJournal::print(std::ostream& os) const
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  os << "TriKota::EvaluationJournal " << fileName << ": " << restored
+     << " records restored, " << hits << " evaluations replayed, "
+     << appended << " records appended" << std::endl;
+}
+
+void TriKota::EvaluationJournal::index()
+{
+  // Anything but a journal header is refused rather than truncated on
+  // the first append, so a wrong file name cannot destroy another file
+  TEUCHOS_TEST_FOR_EXCEPTION(mappedBytes < fileHeaderBytes ||
+     std::memcmp(mapped, journalMagic, sizeof(journalMagic)) != 0, std::logic_error,
+     "TriKota Adapter Error: " << fileName << " is not an evaluation journal");
+  unsigned int version;
+  std::memcpy(&version, mapped + sizeof(journalMagic), sizeof(version));
+  TEUCHOS_TEST_FOR_EXCEPTION(version != journalVersion, std::logic_error,
+     "TriKota Adapter Error: evaluation journal " << fileName
+     << " has version " << version << ", expected " << journalVersion);
+
+  std::size_t offset = fileHeaderBytes;
+  while (offset + sizeof(RecordHeader) <= mappedBytes) {
+    RecordHeader rh;
+    std::memcpy(&rh, mapped + offset, sizeof(RecordHeader));
+    const std::size_t numDoubles = std::size_t(rh.numVars) + rh.numFns +
+      ((rh.flags & HAS_GRADIENTS) ? std::size_t(rh.numVars)*rh.numFns : 0);
+    const std::size_t recordBytes = sizeof(RecordHeader) + sizeof(double)*numDoubles;
+    if (offset + recordBytes > mappedBytes) break; // cut short by a crash
+
+    const double* x = reinterpret_cast<const double*>(mapped + offset + sizeof(RecordHeader));
+    offsets.insert(std::make_pair(hashPoint(x, rh.numVars), offset));
+    restored++;
+    offset += recordBytes;
+  }
+  validBytes = offset;
+}
+
+void TriKota::EvaluationJournal::openForAppend()
+{
+  // Drop a torn tail record, so new records follow the last complete one
+  if (mappedBytes != validBytes)
+    TEUCHOS_TEST_FOR_EXCEPTION(::truncate(fileName.c_str(), validBytes) != 0, std::logic_error,
+       "TriKota Adapter Error: could not truncate evaluation journal " << fileName);
+
+  file = std::fopen(fileName.c_str(), "ab");
+  TEUCHOS_TEST_FOR_EXCEPTION(file == 0, std::logic_error,
+     "TriKota Adapter Error: could not open evaluation journal " << fileName);
+
+  if (validBytes == 0) {
+    char header[fileHeaderBytes] = {0};
+    std::memcpy(header, journalMagic, sizeof(journalMagic));
+    std::memcpy(header + sizeof(journalMagic), &journalVersion, sizeof(journalVersion));
+    buffer.insert(buffer.end(), header, header + fileHeaderBytes);
+  }
+
+  writer = std::thread(&EvaluationJournal::writerLoop, this);
+}
+
+std::size_t TriKota::EvaluationJournal::hashPoint(const double* x, const int numVars) const
+{
+  std::size_t hash = numVars;
+  for (int i=0; i<numVars; i++) {
+    const std::size_t h = std::hash<double>()(x[i]);
+    hash ^= h + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+  }
+  return hash;
+}
+
+void TriKota::EvaluationJournal::writerLoop()
+{
+  std::unique_lock<std::mutex> lock(mutex);
+  while (true) {
+    writerWake.wait(lock, [this]{ return stopping || !pending.empty(); });
+    if (pending.empty()) break; // stopping
+
+    // After a failed write the rest of the journal would not be readable
+    std::vector<char> data;
+    data.swap(pending);
+    writing = true;
+    const bool failed = (writeError != 0);
+    lock.unlock();
+    int error = 0;
+    if (!failed) {
+      errno = 0;
+      if (std::fwrite(&data[0], 1, data.size(), file) != data.size() || std::fflush(file) != 0)
+        error = (errno != 0) ? errno : EIO;
+    }
+    lock.lock();
+    if (error != 0 && writeError == 0) writeError = error;
+    writing = false;
+    writerDone.notify_all();
+  }
+}
@@ -0,0 +1,153 @@
+// @HEADER
+// ************************************************************************
+// 
+//        TriKota: A Trilinos Wrapper for the Dakota Framework
+//                  Copyright (2009) Sandia Corporation
+// 
+// Under the terms of Contract DE-AC04-94AL85000 with Sandia Corporation,
+// the U.S. Government retains certain rights in this software.
+// 
+// This library is free software; you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation; either version 2.1 of the
+// License, or (at your option) any later version.
+//  
+// This library is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301
+// USA
+// 
+// Questions? Contact Andy Salinger (agsalin@sandia.gov), Sandia
+// National Laboratories.
+// 
+// ************************************************************************
+// @HEADER
+
+#ifndef TRIKOTA_EVALUATIONJOURNAL
+#define TRIKOTA_EVALUATIONJOURNAL
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdio>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace TriKota {
+
+/*! \brief Append-only binary journal of model evaluations, used to
+  resume a study without replaying Dakota's restart file.
+  Every evaluation computed by an adapter that was given the journal is
+  appended as one record (x, function values and optionally gradients).
+  Appends are buffered in memory and written by a background thread.
+  When the journal is constructed over an existing file, the file is
+  memory mapped and indexed by point, so a resumed run finds the
+  evaluations of the previous run in O(1) and skips them; a record cut
+  short by a crash ends the index and is dropped on the first append.
+  A non-empty file without a journal header is refused (and left
+  untouched), and a failed write of the background thread is reported
+  by the next append() or flush().
+
+  Points are matched exactly (bitwise), which is what a resumed,
+  deterministic Dakota study asks for again. Only the records present
+  when the journal was opened are looked up; repeats within a run are
+  the job of TriKota::EvaluationCache.
+
+  In parallel runs every rank of the analysis communicator needs a
+  journal over the same file, so all ranks take the same decisions; the
+  adapters append only from the analysis rank 0, the one holding the
+  complete response. The file is only opened for writing on the first
+  append.
+*/
+class EvaluationJournal {
+public:
+
+  //! Open fileName, indexing the records it already holds
+  EvaluationJournal(const std::string& fileName,
+                    const std::size_t flushBytes = 1024*1024);
+
+  //! Writes out the buffered records
+  ~EvaluationJournal();
+
+  /*! \brief Look up the point x among the records of the previous
+    runs. Values are copied into g and (if wantGradients and recorded)
+    gradients into the column-major numVars x numFns block grads.
+  */
+  void lookup(const double* x, const int numVars, const int numFns,
+              const bool wantGradients,
+              double* g, double* grads, const int ldGrads,
+              bool& foundValues, bool& foundGradients);
+
+  //! Append the values g and the gradients grads (may be null) at x
+  void append(const double* x, const int numVars, const int numFns,
+              const double* g, const double* grads, const int ldGrads);
+
+  /*! \brief Hand the buffered records to the writer and wait until they
+    are on disk. Throws if a write failed. */
+  void flush();
+
+  //! Records found in the file when it was opened
+  std::size_t numRestored() const { return restored; }
+  //! Lookups served from the journal
+  int numHits() const { return hits; }
+  //! Records appended by this run
+  std::size_t numAppended() const { return appended; }
+
+  //! Print the counters
+  void print(std::ostream& os) const;
+
+private:
+
+  // Layout of one record, followed by numVars + numFns (+ numVars*numFns)
+  // doubles; 16 bytes keep the doubles of a mapped file aligned
+  struct RecordHeader {
+    unsigned int numVars;
+    unsigned int numFns;
+    unsigned int flags;
+    unsigned int reserved;
+  };
+  enum { HAS_GRADIENTS = 1 };
+
+  void index();
+  void openForAppend();
+  std::size_t hashPoint(const double* x, const int numVars) const;
+  void writerLoop();
+  void drain(std::unique_lock<std::mutex>& lock);
+  void checkWrites() const;
+
+  std::string fileName;
+  const std::size_t flushBytes;
+
+  // Read-only mapping of the records written by earlier runs
+  const char* mapped;
+  std::size_t mappedBytes;
+  std::size_t validBytes;
+  std::unordered_multimap<std::size_t, std::size_t> offsets;
+
+  mutable std::mutex mutex;
+  std::condition_variable writerWake;
+  std::condition_variable writerDone;
+  std::vector<char> buffer;
+  std::vector<char> pending;
+  bool writing;
+  bool stopping;
+  int writeError;
+  std::FILE* file;
+  std::thread writer;
+
+  std::size_t restored;
+  int hits;
+  std::size_t appended;
+};
+
+} // namespace TriKota
+
+#endif //TRIKOTA_EVALUATIONJOURNAL
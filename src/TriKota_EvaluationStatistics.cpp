@@ -0,0 +1,231 @@
+// @HEADER
+// ************************************************************************
+// 
+//        TriKota: A Trilinos Wrapper for the Dakota Framework
+//                  Copyright (2009) Sandia Corporation
+// 
+// Under the terms of Contract DE-AC04-94AL85000 with Sandia Corporation,
+// the U.S. Government retains certain rights in this software.
+// 
+// This library is free software; you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation; either version 2.1 of the
+// License, or (at your option) any later version.
+//  
+// This library is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301
+// USA
+// 
+// Questions? Contact Andy Salinger (agsalin@sandia.gov), Sandia
+// National Laboratories.
+// 
+// ************************************************************************
+// @HEADER
+
+#include "TriKota_EvaluationStatistics.hpp"
+
+#include <iomanip>
+#include <vector>
+
+#include "Teuchos_TimeMonitor.hpp"
+#include "Teuchos_CommHelpers.hpp"
+#include "Teuchos_TestForException.hpp"
+
+namespace {
+
+const char* phaseNames[TriKota::EvaluationStatistics::NUM_PHASES] =
+  { "Dakota bookkeeping", "parameter copy-in", "evalModel", "response copy-out" };
+
+double elapsed(const std::chrono::steady_clock::time_point& begin,
+               const std::chrono::steady_clock::time_point& end)
+{
+  return std::chrono::duration<double>(end - begin).count();
+}
+
+} // namespace
+
+TriKota::EvaluationStatistics::Record::Record()
+  : evalId(-1),
+    start(0.0),
+    gradient(false),
+    cached(false),
+    failed(false),
+    bytes(0)
+{
+  for (int i=0; i<NUM_PHASES; i++) phaseTime[i] = 0.0;
+}
+
+TriKota::EvaluationStatistics::PhaseTimer::PhaseTimer(Record& record_, const EPhase phase_,
+                                                      const Teuchos::RCP<Teuchos::Time>& timer_)
+  : record(record_),
+    phase(phase_),
+    timer(timer_),
+    begin(std::chrono::steady_clock::now())
+{
+  if (timer != Teuchos::null) timer->start();
+}
+
+TriKota::EvaluationStatistics::PhaseTimer::~PhaseTimer()
+{
+  if (timer != Teuchos::null) timer->stop();
+  record.phaseTime[phase] += elapsed(begin, std::chrono::steady_clock::now());
+}
+
+TriKota::EvaluationStatistics::EvaluationStatistics()
+  : origin(std::chrono::steady_clock::now()),
+    lastFinish(0.0),
+    nextEvalId(0),
+    evaluations(0),
+    gradientEvaluations(0),
+    cachedEvaluations(0),
+    failedEvaluations(0),
+    bytes(0),
+    startup(0.0),
+    traceJson(false)
+{
+  for (int i=0; i<NUM_PHASES; i++) {
+    timers[i] = Teuchos::TimeMonitor::getNewCounter(std::string("TriKota: ") + phaseNames[i]);
+    totals[i] = 0.0;
+  }
+}
+
+TriKota::EvaluationStatistics::~EvaluationStatistics()
+{
+  if (trace.is_open()) trace.close();
+}
+
+void TriKota::EvaluationStatistics::startEvaluation(Record& record)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  record.evalId = nextEvalId++;
+  record.start = now();
+  record.phaseTime[PHASE_BOOKKEEPING] = (lastFinish > 0.0) ? record.start - lastFinish : 0.0;
+}
+
+void TriKota::EvaluationStatistics::finishEvaluation(const Record& record)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  for (int i=0; i<NUM_PHASES; i++) totals[i] += record.phaseTime[i];
+  evaluations++;
+  if (record.gradient) gradientEvaluations++;
+  if (record.cached) cachedEvaluations++;
+  if (record.failed) failedEvaluations++;
+  bytes += record.bytes;
+  lastFinish = now();
+
+  if (trace.is_open()) {
+    if (traceJson) {
+      trace << "{\"eval\": " << record.evalId << ", \"start\": " << record.start;
+      for (int i=0; i<NUM_PHASES; i++)
+        trace << ", \"" << phaseNames[i] << "\": " << record.phaseTime[i];
+      trace << ", \"gradient\": " << (record.gradient ? "true" : "false")
+            << ", \"cached\": " << (record.cached ? "true" : "false")
+            << ", \"failed\": " << (record.failed ? "true" : "false")
+            << ", \"bytes\": " << record.bytes << "}\n";
+    }
+    else {
+      trace << record.evalId << "," << record.start;
+      for (int i=0; i<NUM_PHASES; i++) trace << "," << record.phaseTime[i];
+      trace << "," << record.gradient << "," << record.cached
+            << "," << record.failed << "," << record.bytes << "\n";
+    }
+  }
+}
+
+void TriKota::EvaluationStatistics::addStartupTime(const double seconds)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  startup += seconds;
+}
+
+void TriKota::EvaluationStatistics::enableTrace(const std::string& fileName)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  if (trace.is_open()) trace.close();
+  trace.open(fileName.c_str());
+  TEUCHOS_TEST_FOR_EXCEPTION(!trace, std::logic_error,
+     "TriKota Adapter Error: cannot open trace file " << fileName);
+  trace << std::setprecision(9);
+
+  const std::string json(".json");
+  traceJson = fileName.size() >= json.size() &&
+    fileName.compare(fileName.size() - json.size(), json.size(), json) == 0;
+  if (!traceJson) {
+    trace << "eval,start";
+    for (int i=0; i<NUM_PHASES; i++) trace << "," << phaseNames[i];
+    trace << ",gradient,cached,failed,bytes\n";
+  }
+}
+
+std::size_t TriKota::EvaluationStatistics::evaluationBytes(const unsigned int nVars,
+                                                          const unsigned int nFns,
+                                                          const bool values,
+                                                          const bool gradients)
+{
+  std::size_t n = nVars;
+  if (values) n += nFns;
+  if (gradients) n += (std::size_t) nVars*nFns;
+  return n*sizeof(double);
+}
+
+void TriKota::EvaluationStatistics::print(std::ostream& os) const
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  os << "TriKota::EvaluationStatistics: " << evaluations << " evaluations ("
+     << gradientEvaluations << " with gradients, " << cachedEvaluations << " cached, "
+     << failedEvaluations << " failed), " << bytes << " bytes transferred, "
+     << startup << " s startup\n";
+  for (int i=0; i<NUM_PHASES; i++)
+    os << "  " << std::setw(20) << std::left << phaseNames[i] << std::right
+       << " " << totals[i] << " s\n";
+  os << std::flush;
+}
+
+void TriKota::EvaluationStatistics::summarize(std::ostream& os,
+                                              const Teuchos::Comm<int>& comm) const
+{
+  const int numValues = NUM_PHASES + 6;
+  std::vector<double> local(numValues);
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (int i=0; i<NUM_PHASES; i++) local[i] = totals[i];
+    local[NUM_PHASES]   = evaluations;
+    local[NUM_PHASES+1] = gradientEvaluations;
+    local[NUM_PHASES+2] = cachedEvaluations;
+    local[NUM_PHASES+3] = failedEvaluations;
+    local[NUM_PHASES+4] = (double) bytes;
+    local[NUM_PHASES+5] = startup;
+  }
+
+  const int numRanks = comm.getSize();
+  std::vector<double> all(numValues*numRanks);
+  Teuchos::gatherAll<int,double>(comm, numValues, &local[0], numValues*numRanks, &all[0]);
+  if (comm.getRank() != 0) return;
+
+  os << "TriKota::EvaluationStatistics (seconds per phase):\n"
+     << std::setw(6) << "rank" << std::setw(8) << "evals" << std::setw(8) << "grads"
+     << std::setw(8) << "cached" << std::setw(8) << "failed" << std::setw(14) << "bytes"
+     << std::setw(10) << "startup";
+  for (int i=0; i<NUM_PHASES; i++) os << "  " << phaseNames[i];
+  os << "\n";
+  for (int r=0; r<numRanks; r++) {
+    const double* v = &all[r*numValues];
+    os << std::setw(6) << r;
+    for (int i=0; i<4; i++) os << std::setw(8) << (long) v[NUM_PHASES+i];
+    os << std::setw(14) << (long long) v[NUM_PHASES+4] << std::setw(10) << v[NUM_PHASES+5];
+    for (int i=0; i<NUM_PHASES; i++) os << "  " << v[i];
+    os << "\n";
+  }
+  os << std::flush;
+}
+
+double TriKota::EvaluationStatistics::now() const
+{
+  return elapsed(origin, std::chrono::steady_clock::now());
+}
@@ -0,0 +1,177 @@
+// @HEADER
+// ************************************************************************
+// 
+//        TriKota: A Trilinos Wrapper for the Dakota Framework
+//                  Copyright (2009) Sandia Corporation
+// 
+// Under the terms of Contract DE-AC04-94AL85000 with Sandia Corporation,
+// the U.S. Government retains certain rights in this software.
+// 
+// This library is free software; you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation; either version 2.1 of the
+// License, or (at your option) any later version.
+//  
+// This library is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301
+// USA
+// 
+// Questions? Contact Andy Salinger (agsalin@sandia.gov), Sandia
+// National Laboratories.
+// 
+// ************************************************************************
+// @HEADER
+
+#ifndef TRIKOTA_EVALUATIONSTATISTICS
+#define TRIKOTA_EVALUATIONSTATISTICS
+
+#include <chrono>
+#include <cstddef>
+#include <fstream>
+#include <mutex>
+#include <ostream>
+#include <string>
+
+#include "Teuchos_RCP.hpp"
+#include "Teuchos_Comm.hpp"
+#include "Teuchos_Time.hpp"
+
+namespace TriKota {
+
+/*! \brief Timers and counters collected by the TriKota adapters.
+  Every evaluation is split into Dakota bookkeeping (the time spent
+  outside the adapter since the previous evaluation), the parameter
+  copy-in, the evalModel call and the fnVals/fnGrads copy-out. The
+  synchronous path also feeds Teuchos::TimeMonitor timers named
+  "TriKota: ...", so they show up in Teuchos::TimeMonitor::summarize().
+  Collection costs a few clock reads per evaluation and is always on;
+  a per-evaluation trace can be written with enableTrace().
+*/
+class EvaluationStatistics {
+public:
+
+  //! Phases of one evaluation
+  enum EPhase {
+    PHASE_BOOKKEEPING,
+    PHASE_COPY_IN,
+    PHASE_EVAL_MODEL,
+    PHASE_COPY_OUT,
+    NUM_PHASES
+  };
+
+  //! Timings and sizes of one evaluation
+  struct Record {
+    Record();
+    int evalId;
+    double start;
+    double phaseTime[NUM_PHASES];
+    bool gradient;
+    bool cached;
+    bool failed;
+    std::size_t bytes;
+  };
+
+  //! Scoped timer adding the time of a phase to a Record
+  class PhaseTimer {
+  public:
+    //! If timer is non-null it is also started and stopped (main thread only)
+    PhaseTimer(Record& record, const EPhase phase,
+               const Teuchos::RCP<Teuchos::Time>& timer = Teuchos::null);
+    ~PhaseTimer();
+  private:
+    Record& record;
+    const EPhase phase;
+    const Teuchos::RCP<Teuchos::Time> timer;
+    const std::chrono::steady_clock::time_point begin;
+  };
+
+  EvaluationStatistics();
+
+  ~EvaluationStatistics();
+
+  //! Teuchos timer of a phase
+  Teuchos::RCP<Teuchos::Time> timer(const EPhase phase) const { return timers[phase]; }
+
+  /*! \brief Start a record for a new evaluation, charging the time since
+    the end of the previous one to Dakota bookkeeping. */
+  void startEvaluation(Record& record);
+
+  //! Accumulate a finished evaluation (thread safe)
+  void finishEvaluation(const Record& record);
+
+  /*! \brief Write one line per evaluation to fileName: JSON objects if
+    the name ends in ".json", comma separated values otherwise. */
+  void enableTrace(const std::string& fileName);
+
+  //! Time spent in a phase, summed over all evaluations (seconds)
+  double totalTime(const EPhase phase) const { return totals[phase]; }
+  //! Number of evaluations, including the ones served from a cache
+  int numEvaluations() const { return evaluations; }
+  //! Number of evaluations that computed gradients
+  int numGradientEvaluations() const { return gradientEvaluations; }
+  //! Number of evaluations served entirely from a cache
+  int numCachedEvaluations() const { return cachedEvaluations; }
+  //! Number of evaluations where the model failed
+  int numFailedEvaluations() const { return failedEvaluations; }
+  //! Bytes moved between Dakota and the model
+  std::size_t bytesTransferred() const { return bytes; }
+
+  //! Add one-time setup (Driver, adapter construction) to the startup time
+  void addStartupTime(const double seconds);
+  //! One-time setup time charged to these statistics (seconds)
+  double startupTime() const { return startup; }
+
+  //! Bytes moved by one evaluation of nVars parameters and nFns responses
+  static std::size_t evaluationBytes(const unsigned int nVars, const unsigned int nFns,
+                                     const bool values, const bool gradients);
+
+  //! Print the statistics of this rank
+  void print(std::ostream& os) const;
+
+  /*! \brief Print one line per rank of comm on its rank 0.
+    Collective over comm. */
+  void summarize(std::ostream& os, const Teuchos::Comm<int>& comm) const;
+
+private:
+
+  double now() const;
+
+  mutable std::mutex mutex;
+
+  const std::chrono::steady_clock::time_point origin;
+  double lastFinish;
+
+  Teuchos::RCP<Teuchos::Time> timers[NUM_PHASES];
+  double totals[NUM_PHASES];
+  int nextEvalId;
+  int evaluations;
+  int gradientEvaluations;
+  int cachedEvaluations;
+  int failedEvaluations;
+  std::size_t bytes;
+  double startup;
+
+  std::ofstream trace;
+  bool traceJson;
+};
+
+/*! \brief Mix-in for Dakota interfaces that collect
+  EvaluationStatistics, so TriKota::Driver::run can report them.
+*/
+class InstrumentedInterface {
+public:
+  virtual ~InstrumentedInterface() {}
+
+  //! Statistics collected by this interface
+  virtual Teuchos::RCP<EvaluationStatistics> getEvaluationStatistics() const = 0;
+};
+
+} // namespace TriKota
+
+#endif //TRIKOTA_EVALUATIONSTATISTICS
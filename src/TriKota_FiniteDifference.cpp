@@ -0,0 +1,90 @@
+// @HEADER
+// ************************************************************************
+// 
+//        TriKota: A Trilinos Wrapper for the Dakota Framework
+//                  Copyright (2009) Sandia Corporation
+// 
+// Under the terms of Contract DE-AC04-94AL85000 with Sandia Corporation,
+// the U.S. Government retains certain rights in this software.
+// 
+// This library is free software; you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation; either version 2.1 of the
+// License, or (at your option) any later version.
+//  
+// This library is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301
+// USA
+// 
+// Questions? Contact Andy Salinger (agsalin@sandia.gov), Sandia
+// National Laboratories.
+// 
+// ************************************************************************
+// @HEADER
+
+#include "TriKota_FiniteDifference.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+int TriKota::finiteDifferencePoints(const EFiniteDifference method, const int nVars)
+{
+  switch (method) {
+  case FD_FORWARD: return nVars;
+  case FD_CENTRAL: return 2*nVars;
+  default:         return 0;
+  }
+}
+
+void TriKota::finiteDifferenceSteps(const int nVars, const double* x,
+                                    const double relativeStep, const double* steps,
+                                    double* h)
+{
+  for (int i=0; i<nVars; i++) {
+    const double step = (steps != 0) ? steps[i] :
+      relativeStep*std::max(std::fabs(x[i]), 1.0);
+    // Use the step that is actually representable at x_i
+    volatile double perturbed = x[i] + step;
+    h[i] = perturbed - x[i];
+  }
+}
+
+void TriKota::finiteDifferencePoint(const EFiniteDifference method, const int k,
+                                    const double* h, int& variable, double& step)
+{
+  if (method == FD_CENTRAL) {
+    variable = k/2;
+    step = (k % 2 == 0) ? h[variable] : -h[variable];
+  }
+  else {
+    variable = k;
+    step = h[k];
+  }
+}
+
+void TriKota::finiteDifferenceGradients(const EFiniteDifference method,
+                                        const int nVars, const int nFns,
+                                        const double* h, const double* g0,
+                                        const double* G, const int ldG,
+                                        double* grads, const int ldGrads)
+{
+  for (int i=0; i<nVars; i++) {
+    if (method == FD_CENTRAL) {
+      const double* gPlus = G + (2*i)*ldG;
+      const double* gMinus = G + (2*i+1)*ldG;
+      for (int j=0; j<nFns; j++)
+        grads[i + j*ldGrads] = (gPlus[j] - gMinus[j])/(2.0*h[i]);
+    }
+    else {
+      const double* gPlus = G + i*ldG;
+      for (int j=0; j<nFns; j++)
+        grads[i + j*ldGrads] = (gPlus[j] - g0[j])/h[i];
+    }
+  }
+}
@@ -0,0 +1,72 @@
+// @HEADER
+// ************************************************************************
+// 
+//        TriKota: A Trilinos Wrapper for the Dakota Framework
+//                  Copyright (2009) Sandia Corporation
+// 
+// Under the terms of Contract DE-AC04-94AL85000 with Sandia Corporation,
+// the U.S. Government retains certain rights in this software.
+// 
+// This library is free software; you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation; either version 2.1 of the
+// License, or (at your option) any later version.
+//  
+// This library is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301
+// USA
+// 
+// Questions? Contact Andy Salinger (agsalin@sandia.gov), Sandia
+// National Laboratories.
+// 
+// ************************************************************************
+// @HEADER
+
+#ifndef TRIKOTA_FINITEDIFFERENCE
+#define TRIKOTA_FINITEDIFFERENCE
+
+namespace TriKota {
+
+//! Finite-difference gradients computed by the adapters
+enum EFiniteDifference {
+  FD_NONE,     //!< Gradients come from the model's DgDp (the default)
+  FD_FORWARD,  //!< (g(x + h_i e_i) - g(x)) / h_i, one point per variable
+  FD_CENTRAL   //!< (g(x + h_i e_i) - g(x - h_i e_i)) / 2h_i, two points per variable
+};
+
+//! Number of perturbed points of the stencil over nVars variables
+int finiteDifferencePoints(const EFiniteDifference method, const int nVars);
+
+/*! \brief Steps h_i at the point x: steps[i] if steps is not null
+  (absolute, per variable), relativeStep*max(|x_i|,1) otherwise.
+  The step is then rounded so that x_i + h_i - x_i == h_i exactly. */
+void finiteDifferenceSteps(const int nVars, const double* x,
+                           const double relativeStep, const double* steps,
+                           double* h);
+
+/*! \brief Perturbed point k of the stencil, as (variable, signed step):
+  for FD_FORWARD point i is x + h_i e_i, for FD_CENTRAL point 2i is
+  x + h_i e_i and point 2i+1 is x - h_i e_i. */
+void finiteDifferencePoint(const EFiniteDifference method, const int k,
+                           const double* h, int& variable, double& step);
+
+/*! \brief Assemble the gradients from the responses of the stencil.
+  g0 are the responses at x (only read for FD_FORWARD), column k of the
+  column-major nFns x finiteDifferencePoints() block G the responses at
+  point k. Column j of the nVars x nFns block grads receives the
+  gradient of response j, as Dakota's fnGrads. */
+void finiteDifferenceGradients(const EFiniteDifference method,
+                               const int nVars, const int nFns,
+                               const double* h, const double* g0,
+                               const double* G, const int ldG,
+                               double* grads, const int ldGrads);
+
+} // namespace TriKota
+
+#endif //TRIKOTA_FINITEDIFFERENCE
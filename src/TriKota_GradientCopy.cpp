@@ -0,0 +1,76 @@
+// @HEADER
+// ************************************************************************
+// 
+//        TriKota: A Trilinos Wrapper for the Dakota Framework
+//                  Copyright (2009) Sandia Corporation
+// 
+// Under the terms of Contract DE-AC04-94AL85000 with Sandia Corporation,
+// the U.S. Government retains certain rights in this software.
+// 
+// This library is free software; you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation; either version 2.1 of the
+// License, or (at your option) any later version.
+//  
+// This library is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301
+// USA
+// 
+// Questions? Contact Andy Salinger (agsalin@sandia.gov), Sandia
+// National Laboratories.
+// 
+// ************************************************************************
+// @HEADER
+
+#include "TriKota_GradientCopy.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+
+namespace {
+
+// Tile edge, chosen so that a source and a destination tile of doubles
+// fit together in a typical L1 cache
+const int tileSize = 32;
+
+} // namespace
+
+void TriKota::copyGradientBlock(const int m, const int n,
+                                const double* A, const int lda,
+                                double* B, const int ldb)
+{
+  if (m <= 0 || n <= 0 || A == B) return;
+
+  if (lda == m && ldb == m) {
+    std::memcpy(B, A, sizeof(double)*std::size_t(m)*std::size_t(n));
+    return;
+  }
+  // Offsets in ptrdiff_t: numVars*numFns may not fit in an int
+  for (std::ptrdiff_t j=0; j<n; j++)
+    std::memcpy(B + j*ldb, A + j*lda, sizeof(double)*m);
+}
+
+void TriKota::transposeGradientBlock(const int m, const int n,
+                                     const double* A, const int lda,
+                                     double* B, const int ldb)
+{
+  for (int jb=0; jb<n; jb+=tileSize) {
+    const int jEnd = std::min(jb+tileSize, n);
+    for (int ib=0; ib<m; ib+=tileSize) {
+      const int iEnd = std::min(ib+tileSize, m);
+      // Column i of B is row i of A: write it contiguously
+      for (std::ptrdiff_t i=ib; i<iEnd; i++) {
+        const double* a = A + i;
+        double* b = B + i*ldb;
+        for (std::ptrdiff_t j=jb; j<jEnd; j++) b[j] = a[j*lda];
+      }
+    }
+  }
+}
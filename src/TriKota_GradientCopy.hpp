@@ -0,0 +1,55 @@
+// @HEADER
+// ************************************************************************
+// 
+//        TriKota: A Trilinos Wrapper for the Dakota Framework
+//                  Copyright (2009) Sandia Corporation
+// 
+// Under the terms of Contract DE-AC04-94AL85000 with Sandia Corporation,
+// the U.S. Government retains certain rights in this software.
+// 
+// This library is free software; you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation; either version 2.1 of the
+// License, or (at your option) any later version.
+//  
+// This library is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301
+// USA
+// 
+// Questions? Contact Andy Salinger (agsalin@sandia.gov), Sandia
+// National Laboratories.
+// 
+// ************************************************************************
+// @HEADER
+
+#ifndef TRIKOTA_GRADIENTCOPY
+#define TRIKOTA_GRADIENTCOPY
+
+namespace TriKota {
+
+/*! \brief Copy the m x n column-major block A into B (B = A).
+  Used when the sensitivities are already stored one gradient per
+  column, as Dakota's fnGrads is.
+*/
+void copyGradientBlock(const int m, const int n,
+                       const double* A, const int lda,
+                       double* B, const int ldb);
+
+/*! \brief Transpose the m x n column-major block A into B (B = A^T).
+  The copy is tiled so that both the strided reads of A and the
+  contiguous writes of B stay in cache, which is what makes copying a
+  DERIV_MV_BY_COL DgDp into fnGrads cheap for many parameters.
+*/
+void transposeGradientBlock(const int m, const int n,
+                            const double* A, const int lda,
+                            double* B, const int ldb);
+
+} // namespace TriKota
+
+#endif //TRIKOTA_GRADIENTCOPY
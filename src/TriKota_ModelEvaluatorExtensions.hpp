@@ -0,0 +1,177 @@
+// @HEADER
+// ************************************************************************
+// 
+//        TriKota: A Trilinos Wrapper for the Dakota Framework
+//                  Copyright (2009) Sandia Corporation
+// 
+// Under the terms of Contract DE-AC04-94AL85000 with Sandia Corporation,
+// the U.S. Government retains certain rights in this software.
+// 
+// This library is free software; you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation; either version 2.1 of the
+// License, or (at your option) any later version.
+//  
+// This library is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301
+// USA
+// 
+// Questions? Contact Andy Salinger (agsalin@sandia.gov), Sandia
+// National Laboratories.
+// 
+// ************************************************************************
+// @HEADER
+
+#ifndef TRIKOTA_MODELEVALUATOREXTENSIONS
+#define TRIKOTA_MODELEVALUATOREXTENSIONS
+
+#include "Thyra_ModelEvaluatorBase.hpp"
+#include "Thyra_MultiVectorBase.hpp"
+
+#include "Teuchos_RCP.hpp"
+#include "Teuchos_ArrayView.hpp"
+
+namespace TriKota {
+
+/*! \brief Optional "multi-point" extension of a Thyra::ModelEvaluator.
+  A model that also inherits from this class can evaluate several
+  parameter sets in one call. TriKota::ThyraDirectApplicInterface
+  detects it with a dynamic_cast and uses it to evaluate the whole
+  queue of pending Dakota evaluations at once (asynchronous mode),
+  falling back to one evalModel call per evaluation otherwise.
+*/
+class MultiPointModelEvaluator
+{
+public:
+
+  virtual ~MultiPointModelEvaluator() {}
+
+  /*! \brief Evaluate the model at the parameter sets stored as the
+    columns of P (a multivector over get_p_space(p_index)).
+
+    Column k of G (over get_g_space(g_index)) receives g(P[k]).
+    If DgDp[k] is non-null, it receives DgDp(g_index,p_index) at P[k]
+    in the requested orientation; null entries mean no gradient was
+    requested for that point.
+  */
+  virtual void evalMultiPoint(
+    const int p_index,
+    const int g_index,
+    const Thyra::MultiVectorBase<double>& P,
+    const Teuchos::Ptr<Thyra::MultiVectorBase<double> >& G,
+    const Teuchos::ArrayView<const Teuchos::RCP<Thyra::MultiVectorBase<double> > >& DgDp,
+    const Thyra::ModelEvaluatorBase::EDerivativeMultiVectorOrientation orientation
+    ) const = 0;
+
+};
+
+/*! \brief Optional "active set" extension of a model evaluator
+  (Thyra::ModelEvaluator or EpetraExt::ModelEvaluator).
+  Before an evalModel call that requests DgDp(g_index,p_index), the
+  TriKota adapters pass the responses whose gradients Dakota's active
+  set vector asks for. The model may skip the sensitivity (e.g. adjoint)
+  solves of the other responses: their columns of a
+  DERIV_TRANS_MV_BY_ROW, or rows of a DERIV_MV_BY_COL, DgDp are not read.
+  Threaded evaluations share the model, so before them the active set is
+  reset to all responses.
+*/
+class ActiveSetModelEvaluator
+{
+public:
+
+  virtual ~ActiveSetModelEvaluator() {}
+
+  /*! \brief Restrict the following DgDp evaluations of response block
+    g_index to the (increasing) entries in responses; an empty list
+    means all responses. */
+  virtual void setActiveGradients(
+    const int g_index,
+    const Teuchos::ArrayView<const int>& responses
+    ) const = 0;
+
+};
+
+/*! \brief Optional "warm start" extension of a model evaluator that
+  solves for its state internally (e.g. a response-only model).
+  VectorType is the state vector type: Thyra::VectorBase<double> for
+  the Thyra and Tpetra adapters, Epetra_Vector for the Epetra adapter.
+  When warm starting is enabled on the adapter (setWarmStart), it keeps
+  the states returned by getLastState() in a TriKota::StatePool and,
+  before each evalModel call, passes the state of the nearest earlier
+  parameter point to setInitialState() (null: use the model's own
+  initial guess). A state is kept only when the last evalModel call of
+  the evaluation was the solve at the Dakota point, not when
+  finite-difference gradients or Hessians followed it. Threaded and
+  multi-point evaluations are not warm started.
+*/
+template<class VectorType>
+class WarmStartModelEvaluator
+{
+public:
+
+  virtual ~WarmStartModelEvaluator() {}
+
+  //! Initial guess for the nonlinear solve of the next evalModel call
+  virtual void setInitialState(const Teuchos::RCP<const VectorType>& x) const = 0;
+
+  /*! \brief State computed by the last evalModel call, null if none.
+    The model must not modify the returned vector afterwards. */
+  virtual Teuchos::RCP<const VectorType> getLastState() const = 0;
+
+};
+
+/*! \brief Optional "forward solve reuse" extension of an implicit
+  model evaluator (Thyra::ModelEvaluator or EpetraExt::ModelEvaluator).
+  Many Dakota methods ask for the values at a point and then, in a
+  separate evaluation, for the gradients at that same point. When an
+  evalModel call requests DgDp(g_index,p_index) at exactly (bitwise) the
+  parameters of the previous, successful evalModel call of the adapter,
+  the TriKota adapters set reuse = true for the duration of that call
+  only: the model may skip the forward (nonlinear) solve and compute the
+  sensitivities from the state and linearization it retained, so only
+  the adjoint or sensitivity solves are paid the second time.
+  Threaded, multi-point and finite-difference evaluations move the
+  model away from its last state, so the evaluation following them is
+  never flagged.
+*/
+class ForwardReuseModelEvaluator
+{
+public:
+
+  virtual ~ForwardReuseModelEvaluator() {}
+
+  //! Let the next evalModel call of response block g_index reuse the last forward solve
+  virtual void setReuseForwardSolve(const int g_index, const bool reuse) const = 0;
+
+};
+
+/*! \brief Flags the evalModel calls made during its lifetime as reusing
+  the last forward solve (if reuse is true), and clears the flag again
+  even if the evaluation throws. */
+class ForwardReuseScope
+{
+public:
+
+  ForwardReuseScope(const ForwardReuseModelEvaluator* model_, const int g_index_,
+                    const bool reuse_)
+    : model(reuse_ ? model_ : 0), g_index(g_index_)
+    { if (model != 0) model->setReuseForwardSolve(g_index, true); }
+
+  ~ForwardReuseScope() { if (model != 0) model->setReuseForwardSolve(g_index, false); }
+
+private:
+
+  const ForwardReuseModelEvaluator* model;
+  const int g_index;
+
+};
+
+} // namespace TriKota
+
+#endif //TRIKOTA_MODELEVALUATOREXTENSIONS
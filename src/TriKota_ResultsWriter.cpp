@@ -0,0 +1,316 @@
+// @HEADER
+// ************************************************************************
+// 
+//        TriKota: A Trilinos Wrapper for the Dakota Framework
+//                  Copyright (2009) Sandia Corporation
+// 
+// Under the terms of Contract DE-AC04-94AL85000 with Sandia Corporation,
+// the U.S. Government retains certain rights in this software.
+// 
+// This library is free software; you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation; either version 2.1 of the
+// License, or (at your option) any later version.
+//  
+// This library is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301
+// USA
+// 
+// Questions? Contact Andy Salinger (agsalin@sandia.gov), Sandia
+// National Laboratories.
+// 
+// ************************************************************************
+// @HEADER
+
+#include "TriKota_ResultsWriter.hpp"
+#include "TriKota_ConfigDefs.hpp"
+
+#include "Teuchos_TestForException.hpp"
+
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+#ifdef HAVE_TRIKOTA_HDF5
+#include "hdf5.h"
+#endif
+
+namespace {
+  // File header: magic, format version, numVars, numFns, flags, chunkRows
+  const char resultsMagic[8] = {'T','R','I','K','O','T','A','R'};
+  const unsigned int resultsVersion = 1;
+  const std::size_t fileHeaderBytes = 32;
+  enum { HAS_GRADIENTS = 1 };
+
+  // Each chunk starts with its number of rows; 16 bytes keep the doubles aligned
+  const std::size_t chunkHeaderBytes = 16;
+}
+
+#ifdef HAVE_TRIKOTA_HDF5
+struct TriKota::ResultsWriter::Hdf5Handles {
+  hid_t file;
+  hid_t datasets[3];
+  int columns[3];
+  std::size_t written;
+};
+
+namespace {
+  const char* const hdf5Datasets[3] = {"variables", "responses", "gradients"};
+}
+#else
+struct TriKota::ResultsWriter::Hdf5Handles {};
+#endif
+
+TriKota::ResultsWriter::ResultsWriter(const std::string& fileName_,
+                                      const bool withGradients_,
+                                      const int chunkRows_,
+                                      const EFormat format_,
+                                      const int compression_)
+  : fileName(fileName_),
+    withGradients(withGradients_),
+    chunkRows(chunkRows_ > 0 ? chunkRows_ : 1),
+    format(format_),
+    compression(compression_),
+    nVars(-1),
+    nFns(-1),
+    chunkFill(0),
+    file(0),
+    hdf5(0),
+    rows(0),
+    chunks(0)
+{
+  TEUCHOS_TEST_FOR_EXCEPTION(format == FORMAT_HDF5 && !hdf5Available(), std::logic_error,
+     "TriKota Adapter Error: results file " << fileName
+     << " asks for HDF5, but TriKota was built without the HDF5 TPL");
+
+  // Truncate now, so a stale file of an earlier run is not mistaken for this one
+  if (format == FORMAT_NATIVE) {
+    file = std::fopen(fileName.c_str(), "wb");
+    TEUCHOS_TEST_FOR_EXCEPTION(file == 0, std::logic_error,
+       "TriKota Adapter Error: could not open results file " << fileName);
+  }
+}
+
+TriKota::ResultsWriter::~ResultsWriter()
+{
+  flush();
+  if (file != 0) std::fclose(file);
+#ifdef HAVE_TRIKOTA_HDF5
+  if (hdf5 != 0) {
+    for (int d=0; d<3; d++)
+      if (hdf5->columns[d] > 0) H5Dclose(hdf5->datasets[d]);
+    H5Fclose(hdf5->file);
+  }
+#endif
+  delete hdf5;
+}
+
+bool TriKota::ResultsWriter::hdf5Available()
+{
+#ifdef HAVE_TRIKOTA_HDF5
+  return true;
+#else
+  return false;
+#endif
+}
+
+int TriKota::ResultsWriter::numColumns() const
+{
+  return nVars + nFns + (withGradients ? nVars*nFns : 0);
+}
+
+void TriKota::ResultsWriter::append(const double* x, const int numVars, const int numFns,
+                                    const double* g, const double* grads, const int ldGrads)
+{
+  if (g == 0) return;
+  std::lock_guard<std::mutex> lock(mutex);
+  if (nVars < 0) open(numVars, numFns);
+  TEUCHOS_TEST_FOR_EXCEPTION(numVars != nVars || numFns != nFns, std::logic_error,
+     "TriKota Adapter Error: results file " << fileName << " has " << nVars
+     << " variables and " << nFns << " functions, a row with " << numVars
+     << " and " << numFns << " was appended");
+
+  // Column c of the chunk holds its rows at c*chunkRows..
+  double* row = &chunk[chunkFill];
+  for (int i=0; i<nVars; i++) row[i*chunkRows] = x[i];
+  row += nVars*chunkRows;
+  for (int j=0; j<nFns; j++) row[j*chunkRows] = g[j];
+  row += nFns*chunkRows;
+  if (withGradients) {
+    const double missing = std::numeric_limits<double>::quiet_NaN();
+    for (int j=0; j<nFns; j++)
+      for (int i=0; i<nVars; i++)
+        row[(j*nVars + i)*chunkRows] = (grads != 0) ? grads[j*ldGrads + i] : missing;
+  }
+  rows++;
+
+  if (++chunkFill == chunkRows) writeChunk();
+}
+
+void TriKota::ResultsWriter::flush()
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  if (chunkFill > 0) writeChunk();
+  if (file != 0) std::fflush(file);
+#ifdef HAVE_TRIKOTA_HDF5
+  if (hdf5 != 0) H5Fflush(hdf5->file, H5F_SCOPE_LOCAL);
+#endif
+}
+
+void TriKota::ResultsWriter::print(std::ostream& os) const
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  os << "TriKota::ResultsWriter " << fileName << ": " << rows << " rows in "
+     << chunks << " chunks of up to " << chunkRows << " rows" << std::endl;
+}
+
+void TriKota::ResultsWriter::open(const int numVars, const int numFns)
+{
+  nVars = numVars;
+  nFns = numFns;
+  chunk.assign(numColumns()*chunkRows, 0.0);
+
+  if (format == FORMAT_NATIVE) {
+    char header[fileHeaderBytes] = {0};
+    const unsigned int fields[4] = {resultsVersion, (unsigned int) nVars, (unsigned int) nFns,
+                                    withGradients ? (unsigned int) HAS_GRADIENTS : 0u};
+    const unsigned long long rowsPerChunk = chunkRows;
+    std::memcpy(header, resultsMagic, sizeof(resultsMagic));
+    std::memcpy(header + sizeof(resultsMagic), fields, sizeof(fields));
+    std::memcpy(header + sizeof(resultsMagic) + sizeof(fields), &rowsPerChunk, sizeof(rowsPerChunk));
+    std::fwrite(header, 1, fileHeaderBytes, file);
+    return;
+  }
+
+#ifdef HAVE_TRIKOTA_HDF5
+  hdf5 = new Hdf5Handles;
+  hdf5->written = 0;
+  hdf5->columns[0] = nVars;
+  hdf5->columns[1] = nFns;
+  hdf5->columns[2] = withGradients ? nVars*nFns : 0;
+  hdf5->file = H5Fcreate(fileName.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
+  TEUCHOS_TEST_FOR_EXCEPTION(hdf5->file < 0, std::logic_error,
+     "TriKota Adapter Error: could not create HDF5 results file " << fileName);
+
+  // One chunk per column and chunkRows rows, so each column compresses on its own
+  for (int d=0; d<3; d++) {
+    if (hdf5->columns[d] == 0) continue;
+    const hsize_t dims[2] = {(hsize_t) hdf5->columns[d], 0};
+    const hsize_t maxDims[2] = {(hsize_t) hdf5->columns[d], H5S_UNLIMITED};
+    const hsize_t chunkDims[2] = {1, (hsize_t) chunkRows};
+    const hid_t space = H5Screate_simple(2, dims, maxDims);
+    const hid_t plist = H5Pcreate(H5P_DATASET_CREATE);
+    H5Pset_chunk(plist, 2, chunkDims);
+    if (compression > 0) {
+      H5Pset_shuffle(plist);
+      H5Pset_deflate(plist, compression);
+    }
+    hdf5->datasets[d] = H5Dcreate2(hdf5->file, hdf5Datasets[d], H5T_NATIVE_DOUBLE,
+                                   space, H5P_DEFAULT, plist, H5P_DEFAULT);
+    H5Pclose(plist);
+    H5Sclose(space);
+    TEUCHOS_TEST_FOR_EXCEPTION(hdf5->datasets[d] < 0, std::logic_error,
+       "TriKota Adapter Error: could not create dataset " << hdf5Datasets[d]
+       << " in " << fileName);
+  }
+#endif
+}
+
+void TriKota::ResultsWriter::writeChunk()
+{
+  if (format == FORMAT_NATIVE) {
+    char header[chunkHeaderBytes] = {0};
+    const unsigned long long fill = chunkFill;
+    std::memcpy(header, &fill, sizeof(fill));
+    std::fwrite(header, 1, chunkHeaderBytes, file);
+    const int nColumns = numColumns();
+    for (int c=0; c<nColumns; c++)
+      std::fwrite(&chunk[c*chunkRows], sizeof(double), chunkFill, file);
+  }
+#ifdef HAVE_TRIKOTA_HDF5
+  else {
+    // The chunk holds the datasets one after the other, each one as
+    // columns x chunkRows of which the first chunkFill rows are written
+    std::size_t offset = 0;
+    for (int d=0; d<3; d++) {
+      if (hdf5->columns[d] == 0) continue;
+      const hsize_t columns = hdf5->columns[d];
+      const hsize_t newDims[2] = {columns, (hsize_t) (hdf5->written + chunkFill)};
+      const hsize_t fileStart[2] = {0, (hsize_t) hdf5->written};
+      const hsize_t memDims[2] = {columns, (hsize_t) chunkRows};
+      const hsize_t memStart[2] = {0, 0};
+      const hsize_t count[2] = {columns, (hsize_t) chunkFill};
+      H5Dset_extent(hdf5->datasets[d], newDims);
+      const hid_t fileSpace = H5Dget_space(hdf5->datasets[d]);
+      H5Sselect_hyperslab(fileSpace, H5S_SELECT_SET, fileStart, NULL, count, NULL);
+      const hid_t memSpace = H5Screate_simple(2, memDims, NULL);
+      H5Sselect_hyperslab(memSpace, H5S_SELECT_SET, memStart, NULL, count, NULL);
+      const herr_t status = H5Dwrite(hdf5->datasets[d], H5T_NATIVE_DOUBLE, memSpace,
+                                     fileSpace, H5P_DEFAULT, &chunk[offset]);
+      H5Sclose(memSpace);
+      H5Sclose(fileSpace);
+      TEUCHOS_TEST_FOR_EXCEPTION(status < 0, std::logic_error,
+         "TriKota Adapter Error: could not write dataset " << hdf5Datasets[d]
+         << " of " << fileName);
+      offset += columns*chunkRows;
+    }
+    hdf5->written += chunkFill;
+  }
+#endif
+  chunkFill = 0;
+  chunks++;
+}
+
+TriKota::ResultsTable TriKota::readResults(const std::string& fileName)
+{
+  std::FILE* file = std::fopen(fileName.c_str(), "rb");
+  TEUCHOS_TEST_FOR_EXCEPTION(file == 0, std::logic_error,
+     "TriKota Adapter Error: could not open results file " << fileName);
+
+  ResultsTable table;
+  char header[fileHeaderBytes];
+  if (std::fread(header, 1, fileHeaderBytes, file) != fileHeaderBytes) {
+    std::fclose(file);
+    return table; // nothing was appended
+  }
+  const bool isResults = std::memcmp(header, resultsMagic, sizeof(resultsMagic)) == 0;
+  unsigned int fields[4];
+  std::memcpy(fields, header + sizeof(resultsMagic), sizeof(fields));
+  if (!isResults || fields[0] != resultsVersion) std::fclose(file);
+  TEUCHOS_TEST_FOR_EXCEPTION(!isResults, std::logic_error,
+     "TriKota Adapter Error: " << fileName << " is not a results file");
+  TEUCHOS_TEST_FOR_EXCEPTION(fields[0] != resultsVersion, std::logic_error,
+     "TriKota Adapter Error: results file " << fileName
+     << " has version " << fields[0] << ", expected " << resultsVersion);
+  table.numVars = fields[1];
+  table.numFns = fields[2];
+  table.hasGradients = (fields[3] & HAS_GRADIENTS) != 0;
+  const std::size_t nColumns = table.numVars + table.numFns +
+    (table.hasGradients ? std::size_t(table.numVars)*table.numFns : 0);
+
+  // Chunks are read column by column, then the columns are joined
+  std::vector<std::vector<double> > columns(nColumns);
+  char chunkHeader[chunkHeaderBytes];
+  while (std::fread(chunkHeader, 1, chunkHeaderBytes, file) == chunkHeaderBytes) {
+    unsigned long long fill;
+    std::memcpy(&fill, chunkHeader, sizeof(fill));
+    std::vector<double> data(nColumns*fill);
+    if (std::fread(data.empty() ? 0 : &data[0], sizeof(double), data.size(), file) != data.size())
+      break; // cut short by a crash
+    for (std::size_t c=0; c<nColumns; c++)
+      columns[c].insert(columns[c].end(), data.begin() + c*fill, data.begin() + (c+1)*fill);
+    table.numRows += fill;
+  }
+  std::fclose(file);
+
+  table.columns.reserve(nColumns*table.numRows);
+  for (std::size_t c=0; c<nColumns; c++)
+    table.columns.insert(table.columns.end(), columns[c].begin(), columns[c].end());
+  return table;
+}
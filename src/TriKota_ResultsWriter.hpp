@@ -0,0 +1,155 @@
+// @HEADER
+// ************************************************************************
+// 
+//        TriKota: A Trilinos Wrapper for the Dakota Framework
+//                  Copyright (2009) Sandia Corporation
+// 
+// Under the terms of Contract DE-AC04-94AL85000 with Sandia Corporation,
+// the U.S. Government retains certain rights in this software.
+// 
+// This library is free software; you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation; either version 2.1 of the
+// License, or (at your option) any later version.
+//  
+// This library is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301
+// USA
+// 
+// Questions? Contact Andy Salinger (agsalin@sandia.gov), Sandia
+// National Laboratories.
+// 
+// ************************************************************************
+// @HEADER
+
+#ifndef TRIKOTA_RESULTSWRITER
+#define TRIKOTA_RESULTSWRITER
+
+#include <cstddef>
+#include <cstdio>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace TriKota {
+
+/*! \brief Columnar results of a study, as read back by readResults().
+  Row r is the r-th evaluation written; the columns are the variables,
+  the function values and (if recorded) the gradients, each one
+  contiguous: variable(i)[r], value(j)[r] and gradient(j,i)[r] is
+  d g_j / d x_i. Gradients missing from a row are NaN.
+*/
+struct ResultsTable {
+  int numVars;
+  int numFns;
+  bool hasGradients;
+  std::size_t numRows;
+  std::vector<double> columns;
+
+  ResultsTable() : numVars(0), numFns(0), hasGradients(false), numRows(0) {}
+
+  const double* variable(const int i) const { return &columns[0] + i*numRows; }
+  const double* value(const int j) const { return &columns[0] + (numVars + j)*numRows; }
+  const double* gradient(const int j, const int i) const
+    { return &columns[0] + (numVars + numFns + j*numVars + i)*numRows; }
+};
+
+/*! \brief Streams every evaluation computed by an adapter (variables,
+  function values and optionally gradients) to a columnar binary file,
+  for post-processing large studies without parsing Dakota's tabular
+  output or stdout.
+
+  Rows are buffered by column and written a chunk of chunkRows rows at
+  a time, so a chunk of one column is contiguous on disk. The native
+  format is read back by readResults(). With HDF5 (FORMAT_HDF5, if
+  TriKota was built with the HDF5 TPL) the file holds the extendible
+  datasets "variables" (numVars x rows), "responses" (numFns x rows)
+  and, if recorded, "gradients" (numFns*numVars x rows), chunked by
+  column and compressed with shuffle + deflate.
+
+  The number of variables and functions is fixed by the first row. In
+  parallel runs the adapters append only from the analysis rank 0, the
+  one holding the complete response, so only that rank needs a writer;
+  once the file is complete every rank can read the results back with
+  readResults() instead of having them broadcast.
+*/
+class ResultsWriter {
+public:
+
+  enum EFormat { FORMAT_NATIVE, FORMAT_HDF5 };
+
+  /*! \brief Create (truncate) fileName. compression is the deflate
+    level of the HDF5 format; the native format is not compressed. */
+  ResultsWriter(const std::string& fileName,
+                const bool withGradients = false,
+                const int chunkRows = 4096,
+                const EFormat format = FORMAT_NATIVE,
+                const int compression = 4);
+
+  //! Writes out the buffered rows and closes the file
+  ~ResultsWriter();
+
+  /*! \brief Append the row x, g and the column-major numVars x numFns
+    gradients grads (may be null) */
+  void append(const double* x, const int numVars, const int numFns,
+              const double* g, const double* grads, const int ldGrads);
+
+  //! Write the buffered rows as a (short) chunk and flush the file
+  void flush();
+
+  //! Rows appended so far
+  std::size_t numRows() const { return rows; }
+  //! Chunks written so far
+  int numChunks() const { return chunks; }
+
+  //! Print the counters
+  void print(std::ostream& os) const;
+
+  //! True if TriKota was built with HDF5, that is FORMAT_HDF5 is available
+  static bool hdf5Available();
+
+private:
+
+  ResultsWriter(const ResultsWriter&);
+  ResultsWriter& operator=(const ResultsWriter&);
+
+  int numColumns() const;
+  void open(const int numVars, const int numFns);
+  void writeChunk();
+
+  std::string fileName;
+  const bool withGradients;
+  const std::size_t chunkRows;
+  const EFormat format;
+  const int compression;
+
+  int nVars;
+  int nFns;
+
+  mutable std::mutex mutex;
+  std::vector<double> chunk;
+  std::size_t chunkFill;
+  std::FILE* file;
+
+  // HDF5 file and datasets, defined in the implementation
+  struct Hdf5Handles;
+  Hdf5Handles* hdf5;
+
+  std::size_t rows;
+  int chunks;
+};
+
+/*! \brief Read a results file written by ResultsWriter in the native
+  format; a chunk cut short by a crash ends the table. */
+ResultsTable readResults(const std::string& fileName);
+
+} // namespace TriKota
+
+#endif //TRIKOTA_RESULTSWRITER
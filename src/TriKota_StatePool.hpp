@@ -0,0 +1,123 @@
+// @HEADER
+// ************************************************************************
+// 
+//        TriKota: A Trilinos Wrapper for the Dakota Framework
+//                  Copyright (2009) Sandia Corporation
+// 
+// Under the terms of Contract DE-AC04-94AL85000 with Sandia Corporation,
+// the U.S. Government retains certain rights in this software.
+// 
+// This library is free software; you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation; either version 2.1 of the
+// License, or (at your option) any later version.
+//  
+// This library is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301
+// USA
+// 
+// Questions? Contact Andy Salinger (agsalin@sandia.gov), Sandia
+// National Laboratories.
+// 
+// ************************************************************************
+// @HEADER
+
+#ifndef TRIKOTA_STATEPOOL
+#define TRIKOTA_STATEPOOL
+
+#include "Teuchos_RCP.hpp"
+
+#include <deque>
+#include <ostream>
+#include <vector>
+
+namespace TriKota {
+
+/*! \brief Small pool of model states (solutions x) keyed by the
+  parameter point they were computed at.
+  The adapters use it to warm start the nonlinear solve of an
+  evaluation from the state of the nearest earlier point (see
+  TriKota::WarmStartModelEvaluator). Points are compared by Euclidean
+  distance over the Dakota variables; a state farther than maxDistance
+  is not used. At most maxStates states are kept, the oldest is dropped
+  first, which suits optimizers and finite-difference stencils that
+  move through nearby points. VectorType is the model's state vector
+  type; the pool only holds references to the states it is given.
+*/
+template<class VectorType>
+class StatePool {
+public:
+
+  //! Pool of at most maxStates states, used within maxDistance
+  StatePool(const double maxDistance_, const int maxStates_)
+    : maxDistance(maxDistance_), maxStates(maxStates_), hits(0), misses(0) {}
+
+  //! State of the nearest point within maxDistance of x, null if none
+  Teuchos::RCP<const VectorType> nearest(const double* x, const int numVars)
+  {
+    const Entry* best = 0;
+    double bestDistance2 = maxDistance*maxDistance;
+    for (typename std::deque<Entry>::const_iterator it = entries.begin();
+         it != entries.end(); ++it) {
+      if ((int) it->x.size() != numVars) continue;
+      double distance2 = 0.0;
+      for (int i=0; i<numVars && distance2 <= bestDistance2; i++)
+        distance2 += (it->x[i] - x[i])*(it->x[i] - x[i]);
+      if (distance2 <= bestDistance2) { best = &(*it); bestDistance2 = distance2; }
+    }
+    if (best == 0) { misses++; return Teuchos::null; }
+    hits++;
+    return best->state;
+  }
+
+  //! Keep state, computed at x, dropping the oldest state if the pool is full
+  void insert(const double* x, const int numVars, const Teuchos::RCP<const VectorType>& state)
+  {
+    if (state == Teuchos::null || maxStates <= 0) return;
+    while ((int) entries.size() >= maxStates) entries.pop_front();
+    entries.push_back(Entry());
+    entries.back().x.assign(x, x+numVars);
+    entries.back().state = state;
+  }
+
+  //! Drop all states
+  void clear() { entries.clear(); }
+
+  //! Number of states held
+  int size() const { return entries.size(); }
+  //! Evaluations that were warm started
+  int numHits() const { return hits; }
+  //! Evaluations without a state close enough
+  int numMisses() const { return misses; }
+
+  //! Print the counters
+  void print(std::ostream& os) const
+  {
+    os << "TriKota::StatePool: " << hits << " warm starts, " << misses
+       << " cold starts, " << entries.size() << " of " << maxStates
+       << " states held" << std::endl;
+  }
+
+private:
+
+  struct Entry {
+    std::vector<double> x;
+    Teuchos::RCP<const VectorType> state;
+  };
+
+  const double maxDistance;
+  const int maxStates;
+  std::deque<Entry> entries;
+  int hits;
+  int misses;
+};
+
+} // namespace TriKota
+
+#endif //TRIKOTA_STATEPOOL
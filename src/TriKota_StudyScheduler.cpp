@@ -0,0 +1,247 @@
+// @HEADER
+// ************************************************************************
+// 
+//        TriKota: A Trilinos Wrapper for the Dakota Framework
+//                  Copyright (2009) Sandia Corporation
+// 
+// Under the terms of Contract DE-AC04-94AL85000 with Sandia Corporation,
+// the U.S. Government retains certain rights in this software.
+// 
+// This library is free software; you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation; either version 2.1 of the
+// License, or (at your option) any later version.
+//  
+// This library is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301
+// USA
+// 
+// Questions? Contact Andy Salinger (agsalin@sandia.gov), Sandia
+// National Laboratories.
+// 
+// ************************************************************************
+// @HEADER
+
+#include "TriKota_StudyScheduler.hpp"
+
+#include "Teuchos_TestForException.hpp"
+#include "Teuchos_VerboseObject.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+
+TriKota::StudyScheduler::StudyScheduler(const int numColors)
+  :
+#ifdef HAVE_MPI
+    world_comm(MPI_COMM_WORLD),
+    color_comm(MPI_COMM_NULL),
+    queue_win(MPI_WIN_NULL),
+#endif
+    queue_head(0),
+    num_colors(1),
+    my_color(0),
+    world_rank(0),
+    world_size(1),
+    color_rank(0),
+    num_run(0)
+{
+  split(numColors);
+}
+
+#ifdef HAVE_MPI
+TriKota::StudyScheduler::StudyScheduler(MPI_Comm world, const int numColors)
+  : world_comm(world),
+    color_comm(MPI_COMM_NULL),
+    queue_win(MPI_WIN_NULL),
+    queue_head(0),
+    num_colors(1),
+    my_color(0),
+    world_rank(0),
+    world_size(1),
+    color_rank(0),
+    num_run(0)
+{
+  split(numColors);
+}
+#endif
+
+TriKota::StudyScheduler::~StudyScheduler()
+{
+#ifdef HAVE_MPI
+  if (queue_win != MPI_WIN_NULL) MPI_Win_free(&queue_win);
+  if (color_comm != MPI_COMM_NULL) MPI_Comm_free(&color_comm);
+#endif
+}
+
+void TriKota::StudyScheduler::split(const int numColors)
+{
+#ifdef HAVE_MPI
+  MPI_Comm_rank(world_comm, &world_rank);
+  MPI_Comm_size(world_comm, &world_size);
+#endif
+  TEUCHOS_TEST_FOR_EXCEPTION(numColors < 1 || numColors > world_size, std::logic_error,
+     "TriKota Driver Error: cannot split " << world_size << " ranks into "
+     << numColors << " colors");
+  num_colors = numColors;
+
+  // Consecutive blocks of ranks keep a color on as few nodes as possible
+  my_color = (int) ((long long) world_rank*num_colors/world_size);
+
+#ifdef HAVE_MPI
+  MPI_Comm_split(world_comm, my_color, world_rank, &color_comm);
+  MPI_Comm_rank(color_comm, &color_rank);
+
+  // The head of the queue lives on world rank 0; memory allocated by
+  // MPI lets a shared-memory window serve ranks on its node
+  MPI_Win_allocate((world_rank == 0) ? sizeof(long) : 0, sizeof(long),
+                   MPI_INFO_NULL, world_comm, &queue_head, &queue_win);
+#endif
+}
+
+int TriKota::StudyScheduler::nextScenario()
+{
+#ifdef HAVE_MPI
+  const long one = 1;
+  long next = 0;
+  MPI_Win_lock(MPI_LOCK_SHARED, 0, 0, queue_win);
+  MPI_Fetch_and_op(&one, &next, MPI_LONG, 0, 0, MPI_SUM, queue_win);
+  MPI_Win_unlock(0, queue_win);
+  return (int) next;
+#else
+  return (int) queue_head++;
+#endif
+}
+
+std::vector<TriKota::StudyScheduler::Result>
+TriKota::StudyScheduler::run(const int numScenarios, const ScenarioFunction& scenario,
+                             const std::vector<double>& costs)
+{
+  TEUCHOS_TEST_FOR_EXCEPTION(!costs.empty() && (int) costs.size() != numScenarios,
+     std::logic_error, "TriKota Driver Error: " << costs.size()
+     << " cost estimates for " << numScenarios << " scenarios");
+
+  // Queue position k holds scenario order[k], the most expensive first
+  std::vector<int> order(numScenarios);
+  for (int s=0; s<numScenarios; s++) order[s] = s;
+  if (!costs.empty())
+    std::stable_sort(order.begin(), order.end(),
+                     [&costs](int a, int b) { return costs[a] > costs[b]; });
+
+#ifdef HAVE_MPI
+  if (world_rank == 0) {
+    MPI_Win_lock(MPI_LOCK_EXCLUSIVE, 0, 0, queue_win);
+    *queue_head = 0;
+    MPI_Win_unlock(0, queue_win);
+  }
+  MPI_Barrier(world_comm);
+#else
+  queue_head = 0;
+#endif
+
+  // The leader packs scenario, failed, seconds, number of values, values
+  std::vector<double> packed;
+  num_run = 0;
+  while (true) {
+    int k = 0;
+    if (color_rank == 0) k = nextScenario();
+#ifdef HAVE_MPI
+    MPI_Bcast(&k, 1, MPI_INT, 0, color_comm);
+#endif
+    if (k >= numScenarios) break;
+
+    const int s = order[k];
+    const std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+    std::vector<double> values;
+    int failed = 0;
+    try {
+      values = scenario(s, *this);
+    }
+    catch (const std::exception& e) {
+      failed = 1;
+      *Teuchos::VerboseObjectBase::getDefaultOStream()
+        << "TriKota:: Scenario " << s << " failed: " << e.what() << std::endl;
+    }
+    catch (...) {
+      failed = 1;
+    }
+#ifdef HAVE_MPI
+    int anyFailed = failed;
+    MPI_Allreduce(&failed, &anyFailed, 1, MPI_INT, MPI_MAX, color_comm);
+    failed = anyFailed;
+#endif
+    const double seconds = std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - begin).count();
+    num_run++;
+
+    if (color_rank != 0) continue;
+    if (failed) values.clear();
+    packed.push_back(s);
+    packed.push_back(failed);
+    packed.push_back(seconds);
+    packed.push_back(values.size());
+    packed.insert(packed.end(), values.begin(), values.end());
+  }
+
+  // Only the leaders' results travel, in one gather to world rank 0
+  std::vector<double> all;
+  std::vector<int> counts(world_size, 0), displs(world_size, 0);
+#ifdef HAVE_MPI
+  int count = packed.size();
+  MPI_Gather(&count, 1, MPI_INT, &counts[0], 1, MPI_INT, 0, world_comm);
+  if (world_rank == 0) {
+    for (int r=1; r<world_size; r++) displs[r] = displs[r-1] + counts[r-1];
+    all.resize(displs[world_size-1] + counts[world_size-1]);
+  }
+  MPI_Gatherv(packed.empty() ? 0 : &packed[0], count, MPI_DOUBLE,
+              all.empty() ? 0 : &all[0], &counts[0], &displs[0], MPI_DOUBLE,
+              0, world_comm);
+#else
+  all.swap(packed);
+  counts[0] = all.size();
+#endif
+
+  last_results.clear();
+  if (world_rank != 0) return last_results;
+
+  last_results.resize(numScenarios);
+  for (int r=0; r<world_size; r++) {
+    std::size_t offset = displs[r];
+    const std::size_t end = offset + counts[r];
+    while (offset < end) {
+      Result& result = last_results[(int) all[offset]];
+      const std::size_t numValues = (std::size_t) all[offset+3];
+      result.color = (int) ((long long) r*num_colors/world_size);
+      result.failed = (all[offset+1] != 0.0);
+      result.seconds = all[offset+2];
+      result.values.assign(all.begin() + offset + 4, all.begin() + offset + 4 + numValues);
+      offset += 4 + numValues;
+    }
+  }
+  return last_results;
+}
+
+void TriKota::StudyScheduler::print(std::ostream& os) const
+{
+  if (world_rank != 0) return;
+  std::vector<int> scenarios(num_colors, 0), failures(num_colors, 0);
+  std::vector<double> seconds(num_colors, 0.0);
+  for (std::size_t s=0; s<last_results.size(); s++) {
+    const Result& result = last_results[s];
+    if (result.color < 0) continue;
+    scenarios[result.color]++;
+    if (result.failed) failures[result.color]++;
+    seconds[result.color] += result.seconds;
+  }
+  os << "TriKota::StudyScheduler: " << last_results.size() << " scenarios on "
+     << num_colors << " colors of " << world_size << " ranks" << std::endl;
+  for (int c=0; c<num_colors; c++)
+    os << "  color " << c << ": " << scenarios[c] << " scenarios, " << seconds[c]
+       << " s, " << failures[c] << " failed" << std::endl;
+}
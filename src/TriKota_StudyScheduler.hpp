@@ -0,0 +1,154 @@
+// @HEADER
+// ************************************************************************
+// 
+//        TriKota: A Trilinos Wrapper for the Dakota Framework
+//                  Copyright (2009) Sandia Corporation
+// 
+// Under the terms of Contract DE-AC04-94AL85000 with Sandia Corporation,
+// the U.S. Government retains certain rights in this software.
+// 
+// This library is free software; you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation; either version 2.1 of the
+// License, or (at your option) any later version.
+//  
+// This library is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301
+// USA
+// 
+// Questions? Contact Andy Salinger (agsalin@sandia.gov), Sandia
+// National Laboratories.
+// 
+// ************************************************************************
+// @HEADER
+
+#ifndef TRIKOTA_STUDYSCHEDULER
+#define TRIKOTA_STUDYSCHEDULER
+
+#include "TriKota_ConfigDefs.hpp"
+
+#ifdef HAVE_MPI
+#include <mpi.h>
+#endif
+
+#include <functional>
+#include <ostream>
+#include <vector>
+
+namespace TriKota {
+
+/*! \brief Runs independent scenarios of a nested study concurrently,
+  one TriKota::Driver per color of the world communicator.
+
+  The world communicator is split into numColors colors of consecutive
+  ranks. Every color takes the next scenario from a shared queue as soon
+  as its previous one is done, so colors whose inner studies finish
+  early take over the remaining scenarios (dynamic self-scheduling). The
+  queue is a counter on world rank 0 that color leaders advance with an
+  MPI one-sided fetch-and-add, so rank 0 does not have to serve
+  requests. With estimated costs, the most expensive scenarios are
+  handed out first.
+
+  A scenario function is called on every rank of a color. It typically
+  constructs a Driver on getColorComm() with the scenario's own dakota
+  input, an adapter around a model built on the Driver's analysis
+  communicator, and returns the numbers the outer study needs (e.g. from
+  Driver::getFinalResults()). Give each scenario its own Dakota output
+  files, since colors write concurrently. If it throws, on all ranks of
+  the color as a failed inner study does, the scenario is reported as
+  failed and the color moves on.
+*/
+class StudyScheduler {
+public:
+
+  //! Outcome of one scenario, collected on world rank 0
+  struct Result {
+    int color;
+    bool failed;
+    double seconds;
+    std::vector<double> values;
+
+    Result() : color(-1), failed(false), seconds(0.0) {}
+  };
+
+  //! Values returned by the color leader (color rank 0) are kept
+  typedef std::function<std::vector<double>(int scenario,
+                                            const StudyScheduler& scheduler)> ScenarioFunction;
+
+  //! Split MPI_COMM_WORLD into numColors colors
+  explicit StudyScheduler(const int numColors = 1);
+
+#ifdef HAVE_MPI
+  //! Split world into numColors colors
+  StudyScheduler(MPI_Comm world, const int numColors);
+
+  //! The ranks of this rank's color, for a Driver of the scenario
+  MPI_Comm getColorComm() const { return color_comm; }
+
+  //! The communicator split into the colors
+  MPI_Comm getWorldComm() const { return world_comm; }
+#endif
+
+  ~StudyScheduler();
+
+  //! Number of colors
+  int numColors() const { return num_colors; }
+
+  //! Color of this rank
+  int color() const { return my_color; }
+
+  //! True on rank 0 of the color
+  bool colorLeader() const { return color_rank == 0; }
+
+  //! True on rank 0 of the world communicator
+  bool worldRoot() const { return world_rank == 0; }
+
+  /*! \brief Run scenarios 0..numScenarios-1; collective over the world
+    communicator. costs (empty, or one estimate per scenario) orders the
+    queue. Returns the results indexed by scenario on world rank 0, an
+    empty vector on the other ranks. */
+  std::vector<Result> run(const int numScenarios, const ScenarioFunction& scenario,
+                          const std::vector<double>& costs = std::vector<double>());
+
+  //! Scenarios run by this rank's color in the last run()
+  int numScenariosRun() const { return num_run; }
+
+  //! Print the scenarios and time of each color of the last run(), on world rank 0
+  void print(std::ostream& os) const;
+
+private:
+
+  StudyScheduler(const StudyScheduler&);
+  StudyScheduler& operator=(const StudyScheduler&);
+
+  void split(const int numColors);
+  int nextScenario();
+
+#ifdef HAVE_MPI
+  MPI_Comm world_comm;
+  MPI_Comm color_comm;
+  MPI_Win queue_win;
+  long* queue_head;
+#else
+  long queue_head;
+#endif
+
+  int num_colors;
+  int my_color;
+  int world_rank;
+  int world_size;
+  int color_rank;
+
+  int num_run;
+  std::vector<Result> last_results;
+};
+
+} // namespace TriKota
+
+#endif //TRIKOTA_STUDYSCHEDULER
@@ -0,0 +1,232 @@
+// @HEADER
+// ************************************************************************
+// 
+//        TriKota: A Trilinos Wrapper for the Dakota Framework
+//                  Copyright (2009) Sandia Corporation
+// 
+// Under the terms of Contract DE-AC04-94AL85000 with Sandia Corporation,
+// the U.S. Government retains certain rights in this software.
+// 
+// This library is free software; you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation; either version 2.1 of the
+// License, or (at your option) any later version.
+//  
+// This library is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301
+// USA
+// 
+// Questions? Contact Andy Salinger (agsalin@sandia.gov), Sandia
+// National Laboratories.
+// 
+// ************************************************************************
+// @HEADER
+
+#include "TriKota_SurrogateDirectApplicInterface.hpp"
+#include "TriKota_GradientCopy.hpp"
+#include "Teuchos_CommHelpers.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include "ParamResponsePair.hpp"
+using namespace Dakota;
+
+namespace {
+
+// The curvature seen between the kept points only bounds the true one
+// from below
+const double safetyFactor = 2.0;
+
+} // namespace
+
+
+TriKota::SurrogateDirectApplicInterface::SurrogateDirectApplicInterface(
+  ProblemDescDB& problem_db_,
+  const Teuchos::RCP<Thyra::ModelEvaluatorDefaultBase<double> > App_,
+  const double tolerance_,
+  const int maxPoints_,
+  int p_index_,
+  int g_index_)
+  : ThyraDirectApplicInterface(problem_db_, App_, p_index_, g_index_),
+    App(App_),
+    tolerance(tolerance_),
+    maxPoints(maxPoints_),
+    numPairs(0),
+    saved(0),
+    forwarded(0)
+{
+  TEUCHOS_TEST_FOR_EXCEPTION(maxPoints < 1, std::logic_error,
+    "TriKota Adapter Error: the surrogate needs to keep at least one point, not " << maxPoints);
+}
+
+int TriKota::SurrogateDirectApplicInterface::derived_map_ac(const Dakota::String& ac_name)
+{
+  if (App == Teuchos::null) return ThyraDirectApplicInterface::derived_map_ac(ac_name);
+
+  // Rank 0 holds the responses and decides for the whole analysis
+  const Teuchos::RCP<const Teuchos::Comm<Thyra::Ordinal> > comm = getComm();
+  const bool rootRank = (comm == Teuchos::null || comm->getRank() == 0);
+  int answered = (rootRank && !hessFlag && estimate()) ? 1 : 0;
+  if (comm != Teuchos::null && comm->getSize() > 1)
+    Teuchos::broadcast<Thyra::Ordinal, int>(*comm, 0, &answered);
+  if (answered) {
+    saved++;
+    return 0;
+  }
+
+  forwarded++;
+  const int failed = ThyraDirectApplicInterface::derived_map_ac(ac_name);
+  if (!failed && rootRank) addSample();
+  return failed;
+}
+
+void TriKota::SurrogateDirectApplicInterface::wait_local_evaluations(PRPQueue& prp_queue)
+{
+  for (PRPQueueIter prp_iter = prp_queue.begin(); prp_iter != prp_queue.end(); ++prp_iter) {
+    Response response = prp_iter->response();
+    set_local_data(prp_iter->variables(), prp_iter->active_set(), response);
+    if (derived_map_ac(String()) == 0)
+      overlay_response(response);
+    else
+      manage_failure(prp_iter->variables(), prp_iter->active_set(), response,
+                     prp_iter->eval_id());
+    completionSet.insert(prp_iter->eval_id());
+  }
+}
+
+void TriKota::SurrogateDirectApplicInterface::test_local_evaluations(PRPQueue& prp_queue)
+{
+  // All evaluations are blocking, so testing completes the whole queue
+  wait_local_evaluations(prp_queue);
+}
+
+bool TriKota::SurrogateDirectApplicInterface::estimate()
+{
+  // Nothing is known about the curvature before two distinct points are
+  // compared
+  if (tolerance <= 0.0 || numPairs == 0 || curvature.size() != numFns) return false;
+
+  const Sample* nearest = 0;
+  double nearestDistance2 = 0.0;
+  for (unsigned int s=0; s<samples.size(); s++) {
+    if (samples[s].x.size() != numVars) continue;
+    double d2 = 0.0;
+    for (unsigned int i=0; i<numVars; i++) {
+      const double dx = xC[i] - samples[s].x[i];
+      d2 += dx*dx;
+    }
+    if (nearest == 0 || d2 < nearestDistance2) {
+      nearest = &samples[s];
+      nearestDistance2 = d2;
+    }
+  }
+  if (nearest == 0) return false;
+
+  const double d = std::sqrt(nearestDistance2);
+  for (unsigned int j=0; j<numFns; j++) {
+    const double L = safetyFactor*curvature[j];
+    if ((directFnASV[j] & 1) && 0.5*L*d*d > tolerance) return false;
+    if ((directFnASV[j] & 2) && L*d > tolerance) return false;
+  }
+
+  for (unsigned int j=0; j<numFns; j++) {
+    const double* grad = &nearest->grads[j*numVars];
+    double value = nearest->g[j];
+    for (unsigned int i=0; i<numVars; i++) value += grad[i]*(xC[i] - nearest->x[i]);
+    fnVals[j] = value;
+  }
+  if (gradFlag)
+    TriKota::copyGradientBlock(numVars, numFns, nearest->grads.data(), numVars,
+                               fnGrads.values(), fnGrads.stride());
+  return true;
+}
+
+void TriKota::SurrogateDirectApplicInterface::addSample()
+{
+  // Partial responses neither train nor join the surrogate
+  if (!requestsAll(1)) return;
+  const bool withGradients = gradFlag && requestsAll(2);
+
+  if (curvature.size() != numFns) {
+    samples.clear();
+    curvature.assign(numFns, 0.0);
+    numPairs = 0;
+  }
+
+  // A point already kept is not compared with itself
+  std::vector<double> dx(numVars);
+  Sample* duplicate = 0;
+  for (unsigned int s=0; s<samples.size(); s++) {
+    const Sample& sample = samples[s];
+    if (sample.x.size() != numVars) continue;
+    double d2 = 0.0;
+    for (unsigned int i=0; i<numVars; i++) {
+      dx[i] = xC[i] - sample.x[i];
+      d2 += dx[i]*dx[i];
+    }
+    if (d2 == 0.0) {
+      duplicate = &samples[s];
+      continue;
+    }
+    numPairs++;
+
+    for (unsigned int j=0; j<numFns; j++) {
+      // Mismatch of the Taylor estimate from the kept point
+      const double* grad = &sample.grads[j*numVars];
+      double predicted = sample.g[j];
+      for (unsigned int i=0; i<numVars; i++) predicted += grad[i]*dx[i];
+      double L = 2.0*std::fabs(fnVals[j] - predicted)/d2;
+
+      // Change of the gradient between the two points
+      if (withGradients) {
+        const double* newGrad = fnGrads.values() + j*fnGrads.stride();
+        double diff2 = 0.0;
+        for (unsigned int i=0; i<numVars; i++)
+          diff2 += (newGrad[i] - grad[i])*(newGrad[i] - grad[i]);
+        L = std::max(L, std::sqrt(diff2/d2));
+      }
+      curvature[j] = std::max(curvature[j], L);
+    }
+  }
+
+  // The latest evaluation at a kept point replaces it
+  if (!withGradients) return;
+  if (duplicate == 0) {
+    samples.push_back(Sample());
+    duplicate = &samples.back();
+  }
+  Sample& sample = *duplicate;
+  sample.x.assign(xC.values(), xC.values()+numVars);
+  sample.g.assign(fnVals.values(), fnVals.values()+numFns);
+  sample.grads.resize(numVars*numFns);
+  TriKota::copyGradientBlock(numVars, numFns, fnGrads.values(), fnGrads.stride(),
+                             sample.grads.data(), numVars);
+  if ((int) samples.size() > maxPoints) samples.pop_front();
+}
+
+bool TriKota::SurrogateDirectApplicInterface::requestsAll(const short bit) const
+{
+  for (unsigned int j=0; j<numFns; j++) if (!(directFnASV[j] & bit)) return false;
+  return numFns > 0;
+}
+
+void TriKota::SurrogateDirectApplicInterface::clear()
+{
+  samples.clear();
+  curvature.clear();
+  numPairs = 0;
+}
+
+void TriKota::SurrogateDirectApplicInterface::print(std::ostream& os) const
+{
+  os << "TriKota::SurrogateDirectApplicInterface: " << saved
+     << " requests answered by the surrogate, " << forwarded
+     << " passed to the model, " << samples.size() << " points kept" << std::endl;
+}
@@ -0,0 +1,140 @@
+// @HEADER
+// ************************************************************************
+// 
+//        TriKota: A Trilinos Wrapper for the Dakota Framework
+//                  Copyright (2009) Sandia Corporation
+// 
+// Under the terms of Contract DE-AC04-94AL85000 with Sandia Corporation,
+// the U.S. Government retains certain rights in this software.
+// 
+// This library is free software; you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation; either version 2.1 of the
+// License, or (at your option) any later version.
+//  
+// This library is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301
+// USA
+// 
+// Questions? Contact Andy Salinger (agsalin@sandia.gov), Sandia
+// National Laboratories.
+// 
+// ************************************************************************
+// @HEADER
+
+#ifndef TRIKOTA_SURROGATEDIRECTAPPLICINTERFACE
+#define TRIKOTA_SURROGATEDIRECTAPPLICINTERFACE
+
+#include "TriKota_ThyraDirectApplicInterface.hpp"
+
+#include <deque>
+#include <ostream>
+#include <vector>
+
+namespace TriKota {
+
+/*! \brief ThyraDirectApplicInterface that answers requests close to
+  earlier evaluations from a local first-order Taylor surrogate.
+
+  Every evaluation that returns all values and gradients is kept (up to
+  maxPoints, the oldest is dropped first). A request at x is answered
+  with g(x0) + DgDp(x0)^T (x - x0) and DgDp(x0) from the nearest kept
+  point x0 when the estimated error of every response stays within the
+  tolerance; otherwise it goes to the model as usual. The error of
+  response j is estimated as 0.5*L_j*|x - x0|^2 for values and
+  L_j*|x - x0| for gradients, where L_j is the largest curvature seen
+  between kept points (from the gradient differences and from how well
+  the surrogate predicted the new evaluations), times a safety factor.
+  No request is answered before the curvature has been estimated from
+  two distinct points; an evaluation at a point already kept replaces
+  it.
+  Hessian requests always go to the model.
+
+  The decision is taken on analysis rank 0, which holds the responses,
+  and broadcast to the other ranks.
+*/
+class SurrogateDirectApplicInterface : public ThyraDirectApplicInterface
+{
+public:
+
+  //! Constructor: the model to wrap and the absolute error budget per response
+  SurrogateDirectApplicInterface(
+    Dakota::ProblemDescDB& problem_db_,
+    const Teuchos::RCP<Thyra::ModelEvaluatorDefaultBase<double> > App_,
+    const double tolerance,
+    const int maxPoints = 32,
+    int p_index = 0,
+    int g_index = 0);
+
+  ~SurrogateDirectApplicInterface() {}
+
+  //! Change the error budget; 0 sends every request to the model
+  void setTolerance(const double tolerance_) { tolerance = tolerance_; }
+
+  //! Error budget per response
+  double getTolerance() const { return tolerance; }
+
+  //! Requests answered by the surrogate, i.e. model evaluations saved
+  int numSaved() const { return saved; }
+
+  //! Requests passed on to the model (possibly served by its cache)
+  int numForwarded() const { return forwarded; }
+
+  //! Forget the kept evaluations and the curvature estimates
+  void clear();
+
+  //! Print the counters
+  void print(std::ostream& os) const;
+
+protected:
+
+  /*! \brief Virtual function redefinition from Dakota::DirectApplicInterface.
+    Answers from the surrogate or calls the wrapped adapter. */
+  int derived_map_ac(const Dakota::String& ac_name);
+
+  /*! \brief Virtual function redefinition from Dakota::ApplicationInterface.
+    Every queued evaluation goes through derived_map_ac(), so each one
+    can be answered by the surrogate. */
+  void wait_local_evaluations(Dakota::PRPQueue& prp_queue);
+
+  //! Virtual function redefinition from Dakota::ApplicationInterface
+  void test_local_evaluations(Dakota::PRPQueue& prp_queue);
+
+private:
+
+  //! One kept evaluation; grads is column-major numVars x numFns
+  struct Sample {
+    std::vector<double> x;
+    std::vector<double> g;
+    std::vector<double> grads;
+  };
+
+  //! Fill fnVals/fnGrads from the surrogate if within the budget
+  bool estimate();
+
+  //! Keep the evaluation just returned and update the curvatures
+  void addSample();
+
+  //! True if the ASV asks for bit (1 value, 2 gradient) of every response
+  bool requestsAll(const short bit) const;
+
+  Teuchos::RCP<Thyra::ModelEvaluatorDefaultBase<double> > App;
+  double tolerance;
+  int maxPoints;
+  std::deque<Sample> samples;
+  std::vector<double> curvature;
+  //! Pairs of distinct points the curvature was estimated from
+  int numPairs;
+  int saved;
+  int forwarded;
+};
+
+} // namespace TriKota
+
+#endif //TRIKOTA_SURROGATEDIRECTAPPLICINTERFACE
@@ -0,0 +1,108 @@
+// @HEADER
+// ************************************************************************
+// 
+//        TriKota: A Trilinos Wrapper for the Dakota Framework
+//                  Copyright (2009) Sandia Corporation
+// 
+// Under the terms of Contract DE-AC04-94AL85000 with Sandia Corporation,
+// the U.S. Government retains certain rights in this software.
+// 
+// This library is free software; you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation; either version 2.1 of the
+// License, or (at your option) any later version.
+//  
+// This library is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301
+// USA
+// 
+// Questions? Contact Andy Salinger (agsalin@sandia.gov), Sandia
+// National Laboratories.
+// 
+// ************************************************************************
+// @HEADER
+
+#include "TriKota_ThreadPool.hpp"
+
+TriKota::ThreadPool::ThreadPool(const int numThreads_)
+  : currentTask(0),
+    numTasks(0),
+    nextTask(0),
+    activeWorkers(0),
+    generation(0),
+    shutdown(false)
+{
+  for (int i=0; i<numThreads_; i++)
+    threads.push_back(std::thread(&ThreadPool::workerLoop, this, i));
+}
+
+TriKota::ThreadPool::~ThreadPool()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    shutdown = true;
+  }
+  wakeCondition.notify_all();
+  for (unsigned int i=0; i<threads.size(); i++) threads[i].join();
+}
+
+void TriKota::ThreadPool::run(const int numTasks_,
+                              const std::function<void(int,int)>& task)
+{
+  if (numTasks_ <= 0) return;
+
+  std::unique_lock<std::mutex> lock(mutex);
+  currentTask = &task;
+  numTasks = numTasks_;
+  nextTask = 0;
+  activeWorkers = threads.size();
+  error = std::exception_ptr();
+  generation++;
+  wakeCondition.notify_all();
+
+  doneCondition.wait(lock, [this] { return activeWorkers == 0; });
+  currentTask = 0;
+
+  if (error) {
+    std::exception_ptr e = error;
+    error = std::exception_ptr();
+    std::rethrow_exception(e);
+  }
+}
+
+void TriKota::ThreadPool::workerLoop(const int worker)
+{
+  unsigned int seenGeneration = 0;
+  std::unique_lock<std::mutex> lock(mutex);
+
+  while (true) {
+    wakeCondition.wait(lock, [&] { return shutdown || generation != seenGeneration; });
+    if (shutdown) return;
+    seenGeneration = generation;
+
+    // Grab tasks until none are left
+    while (nextTask < numTasks) {
+      const int i = nextTask++;
+      lock.unlock();
+      try {
+        (*currentTask)(i, worker);
+      }
+      catch (...) {
+        lock.lock();
+        if (!error) error = std::current_exception();
+        // Skip the remaining tasks
+        nextTask = numTasks;
+        continue;
+      }
+      lock.lock();
+    }
+
+    if (--activeWorkers == 0) doneCondition.notify_one();
+  }
+}
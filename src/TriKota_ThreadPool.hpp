@@ -0,0 +1,87 @@
+// @HEADER
+// ************************************************************************
+// 
+//        TriKota: A Trilinos Wrapper for the Dakota Framework
+//                  Copyright (2009) Sandia Corporation
+// 
+// Under the terms of Contract DE-AC04-94AL85000 with Sandia Corporation,
+// the U.S. Government retains certain rights in this software.
+// 
+// This library is free software; you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation; either version 2.1 of the
+// License, or (at your option) any later version.
+//  
+// This library is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301
+// USA
+// 
+// Questions? Contact Andy Salinger (agsalin@sandia.gov), Sandia
+// National Laboratories.
+// 
+// ************************************************************************
+// @HEADER
+
+#ifndef TRIKOTA_THREADPOOL
+#define TRIKOTA_THREADPOOL
+
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace TriKota {
+
+/*! \brief Small persistent pool of worker threads.
+  Used by the adapters to run several model evaluations concurrently
+  inside one process. The threads are started once and sleep between
+  calls to run().
+*/
+class ThreadPool {
+public:
+
+  //! Start numThreads worker threads
+  explicit ThreadPool(const int numThreads);
+
+  //! Stop and join the worker threads
+  ~ThreadPool();
+
+  //! Number of worker threads
+  int numThreads() const { return threads.size(); }
+
+  /*! \brief Call task(i, worker) for every i in [0,numTasks), spread
+    dynamically over the workers, and wait for all of them. worker is
+    in [0,numThreads()) and identifies per-thread storage. The first
+    exception thrown by a task is rethrown here.
+  */
+  void run(const int numTasks, const std::function<void(int,int)>& task);
+
+private:
+
+  void workerLoop(const int worker);
+
+  std::vector<std::thread> threads;
+  std::mutex mutex;
+  std::condition_variable wakeCondition;
+  std::condition_variable doneCondition;
+
+  const std::function<void(int,int)>* currentTask;
+  int numTasks;
+  int nextTask;
+  int activeWorkers;
+  unsigned int generation;
+  bool shutdown;
+  std::exception_ptr error;
+};
+
+} // namespace TriKota
+
+#endif //TRIKOTA_THREADPOOL
@@ -30,14 +30,42 @@
 
 #include <iostream>
 #include "TriKota_ThyraDirectApplicInterface.hpp"
+#include "TriKota_GradientCopy.hpp"
+#include "TriKota_BlockedModelEvaluator.hpp"
 #include "Teuchos_VerboseObject.hpp"
 #include "Thyra_DetachedSpmdVectorView.hpp"
 #include "Thyra_DetachedVectorView.hpp"
+#include "Thyra_DetachedMultiVectorView.hpp"
+#include "Thyra_VectorStdOps.hpp"
+#include "Thyra_MultiVectorStdOps.hpp"
+#include "Teuchos_Array.hpp"
+#include "Teuchos_CommHelpers.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
 
 #include "DakotaModel.hpp"
+#include "DakotaResponse.hpp"
+#include "ParamResponsePair.hpp"
 using namespace Dakota;
 
 typedef Thyra::ModelEvaluatorBase MEB;
+typedef TriKota::EvaluationStatistics ES;
+
+namespace {
+
+// True if any queued evaluation sets the ASV bit (2 gradient, 4 Hessian)
+bool asvRequested(const PRPQueue& prp_queue, const short bit)
+{
+  for (PRPQueueCIter prp_iter = prp_queue.begin(); prp_iter != prp_queue.end(); ++prp_iter) {
+    const ShortArray& asv = prp_iter->active_set().request_vector();
+    for (size_t i=0; i<asv.size(); i++) if (asv[i] & bit) return true;
+  }
+  return false;
+}
+
+} // namespace
 
 
 // Define interface class
@@ -46,12 +74,39 @@ TriKota::ThyraDirectApplicInterface::ThyraDirectApplicInterface(
   const Teuchos::RCP<Thyra::ModelEvaluatorDefaultBase<double> > App_,
   int p_index_,
   int g_index_)
-  : Dakota::DirectApplicInterface(problem_db_),
+  : ThyraDirectApplicInterface(problem_db_, std::string(), App_, p_index_, g_index_)
+{
+}
+
+TriKota::ThyraDirectApplicInterface::ThyraDirectApplicInterface(
+  ProblemDescDB& problem_db_,
+  const std::string& interface_id,
+  const Teuchos::RCP<Thyra::ModelEvaluatorDefaultBase<double> > App_,
+  int p_index_,
+  int g_index_)
+  : Dakota::DirectApplicInterface(AdapterCore::selectInterface(problem_db_, interface_id)),
     App(App_),
     p_index(p_index_),
     g_index(g_index_),
-    orientation(MEB::DERIV_MV_BY_COL)
+    orientation(MEB::DERIV_MV_BY_COL),
+    supportsSensitivities(false),
+    supportsHessian(false),
+    supportsHessVecProd(false),
+    hessBlockSize(16),
+    fdMethod(FD_NONE),
+    fdRelativeStep(1.0e-6),
+    activeSetApp(0),
+    warmStartApp(0),
+    forwardReuseApp(0),
+    retrying(false),
+    localOffset(0),
+    localDim(0),
+    responsesReplicated(false),
+    fnGradsViewPtr(0),
+    orientationSelected(false),
+    evalStats(Teuchos::rcp(new EvaluationStatistics))
 {
+  const std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
   Teuchos::RCP<Teuchos::FancyOStream>
     out = Teuchos::VerboseObjectBase::getDefaultOStream();
 
@@ -59,44 +114,76 @@ TriKota::ThyraDirectApplicInterface::ThyraDirectApplicInterface(
     model_p = Thyra::createMember<double>(App->get_p_space(p_index));
     model_g = Thyra::createMember<double>(App->get_g_space(g_index));
 
-    Thyra::DetachedVectorView<double> my_p(model_p);
-    Thyra::DetachedVectorView<double> my_g(model_g);
-    
-    numParameters = my_p.subDim();
-    numResponses  = my_g.subDim();
+    numParameters = App->get_p_space(p_index)->dim();
+    numResponses  = App->get_g_space(g_index)->dim();
+
+    // With Spmd spaces only the locally owned parts are ever copied
+    spmd_p_space = Teuchos::rcp_dynamic_cast<const Thyra::SpmdVectorSpaceBase<double> >(
+      App->get_p_space(p_index));
+    const Teuchos::RCP<const Thyra::SpmdVectorSpaceBase<double> > spmd_g_space =
+      Teuchos::rcp_dynamic_cast<const Thyra::SpmdVectorSpaceBase<double> >(
+        App->get_g_space(g_index));
+    activeSetApp = dynamic_cast<const ActiveSetModelEvaluator*>(App.get());
+    forwardReuseApp = dynamic_cast<const ForwardReuseModelEvaluator*>(App.get());
+    default_spmd_p_space =
+      Teuchos::rcp_dynamic_cast<const Thyra::DefaultSpmdVectorSpace<double> >(spmd_p_space);
+    if (spmd_p_space != Teuchos::null) {
+      comm = spmd_p_space->getComm();
+      localOffset = spmd_p_space->localOffset();
+      localDim = spmd_p_space->localSubDim();
+    }
+    responsesReplicated =
+      spmd_g_space != Teuchos::null && spmd_g_space->isLocallyReplicated();
 
-    *out << "TriKota:: ModeEval has " << numParameters <<
-            " parameters and " << numResponses << " responses." << std::endl;
+    // Only analysis rank 0 reports and seeds Dakota's initial point
+    const bool rootRank = (comm == Teuchos::null || comm->getRank() == 0);
+    if (rootRank)
+      *out << "TriKota:: ModeEval has " << numParameters <<
+              " parameters and " << numResponses << " responses." << std::endl;
 
-    MEB::DerivativeSupport supportDgDp = 
-      App->createOutArgs().supports(MEB::OUT_ARG_DgDp, g_index, p_index);
+    supportDgDp = App->createOutArgs().supports(MEB::OUT_ARG_DgDp, g_index, p_index);
     supportsSensitivities = !(supportDgDp.none());
 
     // Create the MultiVector, then the Derivative object
     if (supportsSensitivities) {
-      *out << "TriKota:: ModeEval supports gradients calculation." << std::endl;
+      if (rootRank) *out << "TriKota:: ModeEval supports gradients calculation." << std::endl;
 
-      if (supportDgDp.supports(MEB::DERIV_TRANS_MV_BY_ROW)) {
-        orientation = MEB::DERIV_TRANS_MV_BY_ROW;
-        model_dgdp = Thyra::createMembers<double>(App->get_p_space(p_index), 
-						  numResponses);
-      }
-      else if (supportDgDp.supports(MEB::DERIV_MV_BY_COL)) {
-        orientation = MEB::DERIV_MV_BY_COL;
-        model_dgdp = Thyra::createMembers<double>(App->get_g_space(g_index), 
-						  numParameters);
-      }
-      else {
-        TEUCHOS_TEST_FOR_EXCEPTION(!supportDgDp.none(), std::logic_error,
+      TEUCHOS_TEST_FOR_EXCEPTION(!supportDgDp.supports(MEB::DERIV_TRANS_MV_BY_ROW) &&
+                                 !supportDgDp.supports(MEB::DERIV_MV_BY_COL), std::logic_error,
               "TriKota Adapter Error: DgDp data type not implemented");
+      selectOrientation();
+    }
+
+    // The parameters always live in model_p; the outputs are toggled per
+    // evaluation in setOutArgs
+    inArgs = App->createInArgs();
+    inArgs.set_p(p_index, model_p);
+    outArgs = App->createOutArgs();
+
+    // An explicit Hessian operator is evaluated once per response and
+    // applied to blocks of directions; Hessian-vector products need one
+    // model call per block
+    supportsHessian = outArgs.supports(MEB::OUT_ARG_hess_g_pp, g_index, p_index, p_index);
+    supportsHessVecProd =
+      outArgs.supports(MEB::OUT_ARG_hess_vec_prod_g_pp, g_index, p_index, p_index);
+    if (supportsHessian || supportsHessVecProd) {
+      if (rootRank) *out << "TriKota:: ModeEval supports Hessian calculation." << std::endl;
+      hessMultiplier = Thyra::createMember<double>(App->get_g_space(g_index));
+      hessInArgs = App->createInArgs();
+      hessInArgs.set_p(p_index, model_p);
+      hessInArgs.set_g_multiplier(g_index, hessMultiplier);
+      hessOutArgs = App->createOutArgs();
+      if (supportsHessian) {
+        hessOp = App->create_hess_g_pp(g_index, p_index, p_index);
+        hessOutArgs.set_hess_g_pp(g_index, p_index, p_index, hessOp);
       }
     }
 
-    *out << "TriKota:: Setting initial guess from Model Evaluator to Dakota " << std::endl;
-    const Thyra::ConstDetachedVectorView<double> my_pinit(App->getNominalValues().get_p(p_index));
-    for (unsigned int i=0; i<numParameters; i++) my_p[i] = my_pinit[i];
+    if (rootRank)
+      *out << "TriKota:: Setting initial guess from Model Evaluator to Dakota " << std::endl;
+    Thyra::assign(model_p.ptr(), *App->getNominalValues().get_p(p_index));
 
-    Model& first_model = *(problem_db_.model_list().begin());
+    Model& first_model = AdapterCore::interfaceModel(problem_db_, interface_id);
     unsigned int num_dakota_vars =  first_model.acv();
     Dakota::RealVector drv(num_dakota_vars);
 
@@ -107,8 +194,24 @@ TriKota::ThyraDirectApplicInterface::ThyraDirectApplicInterface(
       "\n is less then the number of continuous variables\n" << 
       " specified in the dakota.in input file " << num_dakota_vars << "\n" );
 
-    for (unsigned int i=0; i<num_dakota_vars; i++) drv[i] = my_p[i];
-    first_model.continuous_variables(drv);
+    if (spmd_p_space != Teuchos::null) {
+      // Each rank contributes its own entries; one reduction to rank 0
+      // assembles them
+      Teuchos::Array<double> local_drv(num_dakota_vars, 0.0);
+      const Thyra::ConstDetachedSpmdVectorView<double> my_p(model_p);
+      for (Thyra::Ordinal i=0; i<localDim; i++) {
+        const Thyra::Ordinal gi = localOffset + i;
+        if (gi < (Thyra::Ordinal) num_dakota_vars) local_drv[gi] = my_p[i];
+      }
+      if (num_dakota_vars > 0)
+        Teuchos::reduce<Thyra::Ordinal, double>(local_drv.getRawPtr(), drv.values(),
+          num_dakota_vars, Teuchos::REDUCE_SUM, 0, *comm);
+    }
+    else {
+      const Thyra::ConstDetachedVectorView<double> my_p(model_p);
+      for (unsigned int i=0; i<num_dakota_vars; i++) drv[i] = my_p[i];
+    }
+    if (rootRank) first_model.continuous_variables(drv);
 
   }
   else {
@@ -116,6 +219,20 @@ TriKota::ThyraDirectApplicInterface::ThyraDirectApplicInterface(
          << "\tModelEvaluator is null. This is OK iff Dakota has assigned"
          << " MPI_COMM_NULL to this Proc " << std::endl;
   }
+
+  evalStats->addStartupTime(std::chrono::duration<double>(
+    std::chrono::steady_clock::now() - begin).count());
+}
+
+TriKota::ThyraDirectApplicInterface::ThyraDirectApplicInterface(
+  ProblemDescDB& problem_db_,
+  const Teuchos::RCP<Thyra::ModelEvaluatorDefaultBase<double> > App_,
+  const Teuchos::Array<int>& p_indices,
+  const Teuchos::Array<int>& g_indices)
+  : ThyraDirectApplicInterface(problem_db_,
+      (App_ == Teuchos::null) ? Teuchos::null :
+      Teuchos::rcp(new BlockedModelEvaluator(App_, p_indices, g_indices)), 0, 0)
+{
 }
 
 int TriKota::ThyraDirectApplicInterface::derived_map_ac(const Dakota::String& ac_name)
@@ -128,47 +245,130 @@ int TriKota::ThyraDirectApplicInterface::derived_map_ac(const Dakota::String& ac
                        "TriKota_Dakota Adapter Error: ");
     TEUCHOS_TEST_FOR_EXCEPTION(numFns > numResponses, std::logic_error,
                        "TriKota_Dakota Adapter Error: ");
-    TEUCHOS_TEST_FOR_EXCEPTION(hessFlag, std::logic_error,
-                       "TriKota_Dakota Adapter Error: ");
+    TEUCHOS_TEST_FOR_EXCEPTION(hessFlag && !supportsHessian && !supportsHessVecProd,
+      std::logic_error, "TriKota Adapter Error: Dakota requests Hessians but the"
+      " ModelEvaluator supports neither OUT_ARG_hess_g_pp nor OUT_ARG_hess_vec_prod_g_pp");
 
-    MEB::InArgs<double> inArgs = App->createInArgs();
-    MEB::OutArgs<double> outArgs = App->createOutArgs();
+    TEUCHOS_TEST_FOR_EXCEPTION(gradFlag && !supportsSensitivities && fdMethod == FD_NONE,
+      std::logic_error, "TriKota Adapter Error: Dakota requests gradients but the"
+      " ModelEvaluator does not support OUT_ARG_DgDp; see setFiniteDifferenceGradients");
 
-    TEUCHOS_TEST_FOR_EXCEPTION(gradFlag && !supportsSensitivities, std::logic_error,
-                       "TriKota_Dakota Adapter Error: ");
+    // The retry of a point of a failed multi-point batch continues the
+    // record of its first attempt
+    ES::Record record;
+    if (retrying) {
+      record = retryRecord;
+      retrying = false;
+    }
+    else
+      evalStats->startEvaluation(record);
+    record.gradient = gradFlag;
+
+    // Responses whose gradients Dakota asks for; an empty list means all
+    // of the model's
+    activeGrads.clear();
+    const bool allGradients = !gradFlag ||
+      AdapterCore::loadActiveSet(directFnASV, numFns, numResponses, activeGrads);
+
+    // Only compute what the evaluation cache cannot supply (Hessians
+    // are never cached)
+    bool computeValues, computeGradients;
+    if (lookupCache(computeValues, computeGradients) && !hessFlag) {
+      record.cached = true;
+      evalStats->finishEvaluation(record);
+      return 0;
+    }
 
     // Load parameters from Dakota to ModelEval data structure
     {
-      Thyra::DetachedVectorView<double> my_p(model_p);
-      for (unsigned int i=0; i<numVars; i++) my_p[i]=xC[i];
+      ES::PhaseTimer timer(record, ES::PHASE_COPY_IN, evalStats->timer(ES::PHASE_COPY_IN));
+      loadParameters(xC.values(), numVars, *model_p);
     }
 
-    // Evaluate model
-    inArgs.set_p(p_index,model_p);
-    outArgs.set_g(g_index,model_g);
-    if (gradFlag) outArgs.set_DgDp(g_index,p_index,
-      MEB::DerivativeMultiVector<double>(model_dgdp,orientation));
-    App->evalModel(inArgs, outArgs);
+    // Finite differences only ask the model for responses
+    const bool fdGradients = computeGradients && fdMethod != FD_NONE;
+    const bool dgdpGradients = computeGradients && !fdGradients;
 
-    Thyra::DetachedVectorView<double> my_g(model_g);
-    for (unsigned int j=0; j<numFns; j++) fnVals[j]= my_g[j];
+    // When fnGrads has the layout of a row-oriented DgDp, let the model
+    // write the sensitivities straight into Dakota's storage
+    const bool gradsInPlace = dgdpGradients && gradientsViewable();
+    if (gradsInPlace && fnGrads.values() != fnGradsViewPtr) {
+      const RTOpPack::SubMultiVectorView<double> fnGradsRaw(
+        0, numParameters, 0, numResponses,
+        Teuchos::arcp(fnGrads.values(), 0, fnGrads.stride()*numResponses, false),
+        fnGrads.stride());
+      fnGradsView = Thyra::createMembersView<double>(App->get_p_space(p_index), fnGradsRaw);
+      fnGradsDeriv = MEB::DerivativeMultiVector<double>(fnGradsView, orientation);
+      fnGradsViewPtr = fnGrads.values();
+    }
 
-    if (gradFlag) {
-      if (orientation == MEB::DERIV_MV_BY_COL) {
-        for (unsigned int j=0; j<numVars; j++) {
-          Thyra::DetachedVectorView<double>
-             my_dgdp_j(model_dgdp->col(j));
-          for (unsigned int i=0; i<numFns; i++)  fnGrads[i][j]= my_dgdp_j[i];
-        }
+    // Evaluate model
+    if (dgdpGradients && !gradsInPlace) allocateSensitivities();
+    setOutArgs(outArgs, model_g, gradsInPlace ? fnGradsDeriv : model_dgdp_deriv,
+               computeValues, dgdpGradients);
+    if (dgdpGradients && activeSetApp != 0)
+      activeSetApp->setActiveGradients(g_index, activeGrads());
+    if (statePool != Teuchos::null)
+      warmStartApp->setInitialState(statePool->nearest(xC.values(), numVars));
+
+    // A gradient request at the point of the last forward solve (e.g. the
+    // values were asked for first) only pays the sensitivity solves
+    const bool reuseForward = forwardReuseApp != 0 && dgdpGradients &&
+      core.atForwardPoint(xC.values(), numVars);
+    if (reuseForward) core.countForwardReuse();
+    core.clearForwardPoint();
+    int failed = 0;
+    try {
+      ES::PhaseTimer timer(record, ES::PHASE_EVAL_MODEL, evalStats->timer(ES::PHASE_EVAL_MODEL));
+      if (computeValues || dgdpGradients) {
+        const ForwardReuseScope reuse(forwardReuseApp, g_index, reuseForward);
+        App->evalModel(inArgs, outArgs);
       }
-      else {
-        for (unsigned int j=0; j<numFns; j++) {
-          Thyra::DetachedVectorView<double>
-             my_dgdp_j(model_dgdp->col(j));
-          for (unsigned int i=0; i<numVars; i++) fnGrads[j][i]= my_dgdp_j[i]; 
-        }
+      if (fdGradients) {
+        if (computeValues) unloadResponses(*model_g, numFns, fnVals.values());
+        computeFiniteDifferenceGradients(fnVals.values());
       }
+      if (hessFlag) computeHessians();
+    }
+    catch (const std::exception& e) {
+      failed = 1;
+      *Teuchos::VerboseObjectBase::getDefaultOStream()
+        << "TriKota:: Model evaluation failed: " << e.what() << std::endl;
+    }
+    catch (...) {
+      failed = 1;
+    }
+
+    // A failure is reported to Dakota (failure_capture) by every rank
+    // of the analysis; the time spent is kept in the statistics
+    failed = AdapterCore::anyFailed(comm, failed);
+    if (failed) {
+      record.failed = true;
+      evalStats->finishEvaluation(record);
+      return failed;
+    }
+    // The model's last state belongs to xC only if it ended on the solve
+    // at xC, not on a finite-difference stencil point or a Hessian solve
+    if (statePool != Teuchos::null &&
+        (computeValues || dgdpGradients) && !fdGradients && !hessFlag)
+      statePool->insert(xC.values(), numVars, warmStartApp->getLastState());
+
+    // The finite-difference stencil moved the model away from xC
+    if ((computeValues || dgdpGradients) && !fdGradients)
+      core.setForwardPoint(xC.values(), numVars);
+
+    {
+      ES::PhaseTimer timer(record, ES::PHASE_COPY_OUT, evalStats->timer(ES::PHASE_COPY_OUT));
+      if (computeValues && !fdGradients) unloadResponses(*model_g, numFns, fnVals.values());
+      if (dgdpGradients && !gradsInPlace)
+        unloadGradients(*model_dgdp, numVars, numFns, fnGrads.values(), fnGrads.stride(),
+                        activeGrads());
+
+      // Partial gradients must not be served to later requests
+      storeCache(computeValues, computeGradients && allGradients);
     }
+    record.bytes = ES::evaluationBytes(numVars, numFns, computeValues, computeGradients);
+    evalStats->finishEvaluation(record);
   }
   else {
     TEUCHOS_TEST_FOR_EXCEPTION(
@@ -189,3 +389,680 @@ int TriKota::ThyraDirectApplicInterface::derived_map_of(const Dakota::String& ac
   *out << "Finished Dakota NLS Fitting!: " << std::setprecision(5) << std::endl;
   return 0;
 }
+
+void TriKota::ThyraDirectApplicInterface::derived_map_asynch(const ParamResponsePair& pair)
+{
+  // Nothing to launch: the queued evaluations are performed as a batch
+  // in wait_local_evaluations
+}
+
+void TriKota::ThyraDirectApplicInterface::wait_local_evaluations(PRPQueue& prp_queue)
+{
+  const MultiPointModelEvaluator* multiPointApp =
+    dynamic_cast<const MultiPointModelEvaluator*>(App.get());
+
+  // Hessians are only assembled by the one-at-a-time path, which also
+  // batches the finite-difference stencils itself
+  const bool batchable = prp_queue.size() > 1 && !asvRequested(prp_queue, 4) &&
+    (fdMethod == FD_NONE || !asvRequested(prp_queue, 2));
+
+  if (multiPointApp != 0 && batchable) {
+    evalMultiPoint(*multiPointApp, prp_queue);
+    return;
+  }
+
+  if (threadPool != Teuchos::null && batchable) {
+    evalThreaded(prp_queue);
+    return;
+  }
+
+  // Fall back to one evalModel call per queued evaluation
+  for (PRPQueueIter prp_iter = prp_queue.begin(); prp_iter != prp_queue.end(); ++prp_iter)
+    evalQueued(*prp_iter);
+}
+
+void TriKota::ThyraDirectApplicInterface::evalQueued(const ParamResponsePair& pair)
+{
+  Response response = pair.response();
+  set_local_data(pair.variables(), pair.active_set(), response);
+  if (derived_map_ac(String()) == 0)
+    overlay_response(response);
+  else
+    manage_failure(pair.variables(), pair.active_set(), response, pair.eval_id());
+  completionSet.insert(pair.eval_id());
+}
+
+void TriKota::ThyraDirectApplicInterface::test_local_evaluations(PRPQueue& prp_queue)
+{
+  // All evaluations are blocking, so testing completes the whole queue
+  wait_local_evaluations(prp_queue);
+}
+
+void TriKota::ThyraDirectApplicInterface::evalMultiPoint(
+  const MultiPointModelEvaluator& multiPointApp, PRPQueue& prp_queue)
+{
+  // Pack one column per evaluation that the cache cannot fully supply;
+  // entries beyond the Dakota variables keep the values held in model_p
+  core.clearForwardPoint();
+  Teuchos::Array<int> column(prp_queue.size(), -1);
+  Teuchos::Array<char> computeGradients(prp_queue.size(), false);
+  Teuchos::Array<ES::Record> records(prp_queue.size());
+  int k = 0, numPoints = 0;
+  for (PRPQueueIter prp_iter = prp_queue.begin(); prp_iter != prp_queue.end(); ++prp_iter, ++k) {
+    Response response = prp_iter->response();
+    set_local_data(prp_iter->variables(), prp_iter->active_set(), response);
+
+    TEUCHOS_TEST_FOR_EXCEPTION(numVars > numParameters, std::logic_error,
+                       "TriKota_Dakota Adapter Error: ");
+    TEUCHOS_TEST_FOR_EXCEPTION(numFns > numResponses, std::logic_error,
+                       "TriKota_Dakota Adapter Error: ");
+    TEUCHOS_TEST_FOR_EXCEPTION(hessFlag, std::logic_error,
+                       "TriKota_Dakota Adapter Error: ");
+    TEUCHOS_TEST_FOR_EXCEPTION(gradFlag && !supportsSensitivities, std::logic_error,
+                       "TriKota_Dakota Adapter Error: ");
+
+    evalStats->startEvaluation(records[k]);
+    records[k].gradient = gradFlag;
+
+    bool computeValues, computeGradients_k;
+    if (lookupCache(computeValues, computeGradients_k)) {
+      records[k].cached = true;
+      evalStats->finishEvaluation(records[k]);
+      overlay_response(response);
+      completionSet.insert(prp_iter->eval_id());
+      continue;
+    }
+    column[k] = numPoints++;
+    computeGradients[k] = computeGradients_k;
+  }
+  if (numPoints == 0) return;
+
+  const Teuchos::RCP<Thyra::MultiVectorBase<double> > P =
+    Thyra::createMembers<double>(App->get_p_space(p_index), numPoints);
+  const Teuchos::RCP<Thyra::MultiVectorBase<double> > G =
+    Thyra::createMembers<double>(App->get_g_space(g_index), numPoints);
+  Teuchos::Array<Teuchos::RCP<Thyra::MultiVectorBase<double> > > DgDp(numPoints);
+
+  k = 0;
+  for (PRPQueueIter prp_iter = prp_queue.begin(); prp_iter != prp_queue.end(); ++prp_iter, ++k) {
+    if (column[k] < 0) continue;
+    ES::PhaseTimer timer(records[k], ES::PHASE_COPY_IN);
+    set_local_data(prp_iter->variables(), prp_iter->active_set());
+    const Teuchos::RCP<Thyra::VectorBase<double> > p_k = P->col(column[k]);
+    Thyra::assign(p_k.ptr(), *model_p);
+    loadParameters(xC.values(), numVars, *p_k);
+    if (computeGradients[k]) DgDp[column[k]] = createSensitivities();
+  }
+
+  // The batch time is shared evenly between its points
+  ES::Record batch;
+  int failed = 0;
+  try {
+    ES::PhaseTimer timer(batch, ES::PHASE_EVAL_MODEL, evalStats->timer(ES::PHASE_EVAL_MODEL));
+    multiPointApp.evalMultiPoint(p_index, g_index, *P, G.ptr(), DgDp(), orientation);
+  }
+  catch (...) {
+    failed = 1;
+  }
+  failed = AdapterCore::anyFailed(comm, failed);
+  if (failed) {
+    // Redo the batch one point at a time so only the points that fail go
+    // to Dakota's failure capture; each point is recorded once, by its
+    // retry, with its share of the failed batch
+    k = 0;
+    for (PRPQueueIter prp_iter = prp_queue.begin(); prp_iter != prp_queue.end(); ++prp_iter, ++k) {
+      if (column[k] < 0) continue;
+      records[k].phaseTime[ES::PHASE_EVAL_MODEL] = batch.phaseTime[ES::PHASE_EVAL_MODEL]/numPoints;
+      retryRecord = records[k];
+      retrying = true;
+      evalQueued(*prp_iter);
+    }
+    return;
+  }
+
+  // Scatter results back to the Dakota responses
+  k = 0;
+  for (PRPQueueIter prp_iter = prp_queue.begin(); prp_iter != prp_queue.end(); ++prp_iter, ++k) {
+    if (column[k] < 0) continue;
+    records[k].phaseTime[ES::PHASE_EVAL_MODEL] = batch.phaseTime[ES::PHASE_EVAL_MODEL]/numPoints;
+    Response response = prp_iter->response();
+    {
+      ES::PhaseTimer timer(records[k], ES::PHASE_COPY_OUT);
+      set_local_data(prp_iter->variables(), prp_iter->active_set(), response);
+      unloadResponses(*G->col(column[k]), numFns, fnVals.values());
+      if (computeGradients[k])
+        unloadGradients(*DgDp[column[k]], numVars, numFns, fnGrads.values(), fnGrads.stride());
+      storeCache(true, computeGradients[k]);
+    }
+    records[k].bytes = ES::evaluationBytes(numVars, numFns, true, computeGradients[k]);
+    evalStats->finishEvaluation(records[k]);
+    overlay_response(response);
+    completionSet.insert(prp_iter->eval_id());
+  }
+}
+
+void TriKota::ThyraDirectApplicInterface::setEvaluationThreads(const int numThreads_)
+{
+  const int numThreads = (numThreads_ < 0) ? asynchLocalEvalConcurrency : numThreads_;
+
+  threadPool = Teuchos::null;
+  workspaces.clear();
+  if (App == Teuchos::null || numThreads <= 1) return;
+
+  TEUCHOS_TEST_FOR_EXCEPTION(comm != Teuchos::null && comm->getSize() > 1, std::logic_error,
+    "TriKota Adapter Error: threaded evaluations require an analysis communicator"
+    " with a single rank, this one has " << comm->getSize());
+
+  // Entries beyond the Dakota variables start from the values in model_p
+  workspaces.resize(numThreads);
+  for (int i=0; i<numThreads; i++) {
+    workspaces[i].p = model_p->clone_v();
+    workspaces[i].g = Thyra::createMember<double>(App->get_g_space(g_index));
+    workspaces[i].inArgs = App->createInArgs();
+    workspaces[i].inArgs.set_p(p_index, workspaces[i].p);
+    workspaces[i].outArgs = App->createOutArgs();
+  }
+  threadPool = Teuchos::rcp(new ThreadPool(numThreads));
+}
+
+void TriKota::ThyraDirectApplicInterface::evalThreaded(PRPQueue& prp_queue)
+{
+  // Everything touching Dakota's data members (and the cache lookups,
+  // which must stay in queue order) happens on this thread
+  core.clearForwardPoint();
+  std::vector<EvalTask> tasks;
+  std::vector<PRPQueueIter> pending;
+  tasks.reserve(prp_queue.size());
+  pending.reserve(prp_queue.size());
+
+  for (PRPQueueIter prp_iter = prp_queue.begin(); prp_iter != prp_queue.end(); ++prp_iter) {
+    Response response = prp_iter->response();
+    set_local_data(prp_iter->variables(), prp_iter->active_set(), response);
+
+    TEUCHOS_TEST_FOR_EXCEPTION(numVars > numParameters, std::logic_error,
+                       "TriKota_Dakota Adapter Error: ");
+    TEUCHOS_TEST_FOR_EXCEPTION(numFns > numResponses, std::logic_error,
+                       "TriKota_Dakota Adapter Error: ");
+    TEUCHOS_TEST_FOR_EXCEPTION(hessFlag, std::logic_error,
+                       "TriKota_Dakota Adapter Error: ");
+    TEUCHOS_TEST_FOR_EXCEPTION(gradFlag && !supportsSensitivities, std::logic_error,
+                       "TriKota_Dakota Adapter Error: ");
+
+    ES::Record record;
+    evalStats->startEvaluation(record);
+    record.gradient = gradFlag;
+
+    bool computeValues, computeGradients;
+    if (lookupCache(computeValues, computeGradients)) {
+      record.cached = true;
+      evalStats->finishEvaluation(record);
+      overlay_response(response);
+      completionSet.insert(prp_iter->eval_id());
+      continue;
+    }
+
+    // Keep whatever the cache supplied next to the computed parts
+    tasks.push_back(EvalTask());
+    EvalTask& task = tasks.back();
+    task.record = record;
+    task.x.assign(xC.values(), xC.values()+numVars);
+    task.numVars = numVars;
+    task.numFns = numFns;
+    task.computeValues = computeValues;
+    task.computeGradients = computeGradients;
+    task.failed = false;
+    task.allGradients = !gradFlag ||
+      AdapterCore::loadActiveSet(directFnASV, numFns, numResponses, task.activeGrads);
+    task.vals.assign(fnVals.values(), fnVals.values()+numFns);
+    if (gradFlag) {
+      task.grads.resize(std::size_t(numVars)*numFns);
+      TriKota::copyGradientBlock(numVars, numFns, fnGrads.values(), fnGrads.stride(),
+                                 task.grads.data(), numVars);
+    }
+    pending.push_back(prp_iter);
+  }
+
+  // Sensitivity storage of the threads, on the first gradient request
+  for (unsigned int i=0; i<tasks.size(); i++) {
+    if (!tasks[i].computeGradients) continue;
+    for (int w=0; w<workspaces.size(); w++) {
+      if (workspaces[w].dgdp != Teuchos::null) continue;
+      workspaces[w].dgdp = createSensitivities();
+      workspaces[w].dgdpDeriv = MEB::DerivativeMultiVector<double>(workspaces[w].dgdp, orientation);
+    }
+    break;
+  }
+
+  // The threads share the model: drop an active set left by a
+  // one-at-a-time evaluation, they only copy the active columns
+  if (activeSetApp != 0) activeSetApp->setActiveGradients(g_index, Teuchos::null);
+
+  threadPool->run(tasks.size(), [this, &tasks](int i, int worker) {
+    evalTask(workspaces[worker], tasks[i]);
+  });
+
+  for (unsigned int i=0; i<tasks.size(); i++) {
+    const EvalTask& task = tasks[i];
+    Response response = pending[i]->response();
+    set_local_data(pending[i]->variables(), pending[i]->active_set(), response);
+    if (task.failed) {
+      manage_failure(pending[i]->variables(), pending[i]->active_set(), response,
+                     pending[i]->eval_id());
+      completionSet.insert(pending[i]->eval_id());
+      continue;
+    }
+    std::copy(task.vals.begin(), task.vals.end(), fnVals.values());
+    if (gradFlag)
+      TriKota::copyGradientBlock(numVars, numFns, task.grads.data(), numVars,
+                                 fnGrads.values(), fnGrads.stride());
+    storeCache(task.computeValues, task.computeGradients && task.allGradients);
+    overlay_response(response);
+    completionSet.insert(pending[i]->eval_id());
+  }
+}
+
+void TriKota::ThyraDirectApplicInterface::evalTask(EvalWorkspace& workspace, EvalTask& task)
+{
+  // Teuchos timers are not thread safe, only the record is updated here
+  {
+    ES::PhaseTimer timer(task.record, ES::PHASE_COPY_IN);
+    loadParameters(task.x.data(), task.numVars, *workspace.p);
+  }
+
+  setOutArgs(workspace.outArgs, workspace.g, workspace.dgdpDeriv,
+             task.computeValues, task.computeGradients);
+  try {
+    ES::PhaseTimer timer(task.record, ES::PHASE_EVAL_MODEL);
+    App->evalModel(workspace.inArgs, workspace.outArgs);
+  }
+  catch (...) {
+    // Handed to Dakota's failure capture once all threads are done
+    task.failed = task.record.failed = true;
+    evalStats->finishEvaluation(task.record);
+    return;
+  }
+
+  {
+    ES::PhaseTimer timer(task.record, ES::PHASE_COPY_OUT);
+    if (task.computeValues)
+      unloadResponses(*workspace.g, task.numFns, task.vals.data());
+    if (task.computeGradients)
+      unloadGradients(*workspace.dgdp, task.numVars, task.numFns,
+                      task.grads.data(), task.numVars, task.activeGrads());
+  }
+  task.record.bytes = ES::evaluationBytes(task.numVars, task.numFns,
+                                          task.computeValues, task.computeGradients);
+  evalStats->finishEvaluation(task.record);
+}
+
+void TriKota::ThyraDirectApplicInterface::setWarmStart(const double maxDistance, const int maxStates)
+{
+  statePool = AdapterCore::createStatePool(App.get(), maxDistance, maxStates, warmStartApp,
+                                          "Thyra::VectorBase<double>");
+}
+
+void TriKota::ThyraDirectApplicInterface::setFiniteDifferenceGradients(
+  const EFiniteDifference method, const double relativeStep,
+  const Teuchos::ArrayView<const double>& steps)
+{
+  TEUCHOS_TEST_FOR_EXCEPTION(method != FD_NONE && steps.size() == 0 && relativeStep <= 0.0,
+    std::logic_error, "TriKota Adapter Error: finite-difference step must be positive, not "
+    << relativeStep);
+  for (int i=0; i<steps.size(); i++)
+    TEUCHOS_TEST_FOR_EXCEPTION(steps[i] == 0.0, std::logic_error,
+      "TriKota Adapter Error: finite-difference step " << i << " is zero");
+  fdMethod = method;
+  fdRelativeStep = relativeStep;
+  fdSteps.assign(steps.begin(), steps.end());
+}
+
+void TriKota::ThyraDirectApplicInterface::computeFiniteDifferenceGradients(const double* g0)
+{
+  const int nPoints = finiteDifferencePoints(fdMethod, numVars);
+  if (nPoints == 0 || numFns == 0) return;
+  TEUCHOS_TEST_FOR_EXCEPTION(fdSteps.size() != 0 && fdSteps.size() < (int) numVars,
+    std::logic_error, "TriKota Adapter Error: " << fdSteps.size() <<
+    " finite-difference steps given for " << numVars << " variables");
+
+  Teuchos::Array<double> h(numVars);
+  TriKota::finiteDifferenceSteps(numVars, xC.values(), fdRelativeStep,
+    fdSteps.size() ? fdSteps.getRawPtr() : 0, h.getRawPtr());
+
+  // One column per perturbed point; the other entries are those of model_p
+  const Teuchos::RCP<Thyra::MultiVectorBase<double> > P =
+    Thyra::createMembers<double>(App->get_p_space(p_index), nPoints);
+  const Teuchos::RCP<Thyra::MultiVectorBase<double> > G =
+    Thyra::createMembers<double>(App->get_g_space(g_index), nPoints);
+  for (int k=0; k<nPoints; k++) {
+    int i;
+    double step;
+    TriKota::finiteDifferencePoint(fdMethod, k, h.getRawPtr(), i, step);
+    const Teuchos::RCP<Thyra::VectorBase<double> > p_k = P->col(k);
+    Thyra::assign(p_k.ptr(), *model_p);
+    Thyra::set_ele(i, xC[i] + step, p_k.ptr());
+  }
+
+  evalStencil(*P, *G);
+
+  const Thyra::ConstDetachedMultiVectorView<double> my_G(G,
+    Teuchos::Range1D(0, numFns-1), Teuchos::Range1D(0, nPoints-1));
+  TriKota::finiteDifferenceGradients(fdMethod, numVars, numFns, h.getRawPtr(), g0,
+    my_G.values(), my_G.leadingDim(), fnGrads.values(), fnGrads.stride());
+}
+
+void TriKota::ThyraDirectApplicInterface::evalStencil(const Thyra::MultiVectorBase<double>& P,
+                                                      Thyra::MultiVectorBase<double>& G)
+{
+  const int nPoints = P.domain()->dim();
+  const MultiPointModelEvaluator* multiPointApp =
+    dynamic_cast<const MultiPointModelEvaluator*>(App.get());
+
+  if (multiPointApp != 0) {
+    const Teuchos::Array<Teuchos::RCP<Thyra::MultiVectorBase<double> > > noDgDp(nPoints);
+    multiPointApp->evalMultiPoint(p_index, g_index, P, Teuchos::ptrFromRef(G), noDgDp(),
+                                  orientation);
+  }
+  else if (threadPool != Teuchos::null) {
+    threadPool->run(nPoints, [this, &P, &G](int k, int worker) {
+      EvalWorkspace& workspace = workspaces[worker];
+      Thyra::assign(workspace.p.ptr(), *P.col(k));
+      setOutArgs(workspace.outArgs, workspace.g, MEB::Derivative<double>(), true, false);
+      App->evalModel(workspace.inArgs, workspace.outArgs);
+      Thyra::assign(G.col(k).ptr(), *workspace.g);
+    });
+  }
+  else {
+    // Copies of the argument objects, pointed at the stencil columns
+    MEB::InArgs<double> fdInArgs = inArgs;
+    MEB::OutArgs<double> fdOutArgs = App->createOutArgs();
+    for (int k=0; k<nPoints; k++) {
+      fdInArgs.set_p(p_index, P.col(k));
+      fdOutArgs.set_g(g_index, G.col(k));
+      App->evalModel(fdInArgs, fdOutArgs);
+    }
+  }
+}
+
+bool TriKota::ThyraDirectApplicInterface::lookupCache(bool& computeValues,
+                                                      bool& computeGradients)
+{
+  return core.lookup(xC.values(), numVars, numFns, gradFlag,
+                     fnVals.values(), fnGrads.values(), fnGrads.stride(),
+                     computeValues, computeGradients);
+}
+
+void TriKota::ThyraDirectApplicInterface::storeCache(const bool computedValues,
+                                                     const bool computedGradients)
+{
+  // The journal and the results writer are written by the rank holding the response
+  core.store(xC.values(), numVars, numFns, fnVals.values(), fnGrads.values(), fnGrads.stride(),
+             computedValues, computedGradients, comm == Teuchos::null || comm->getRank() == 0);
+}
+
+void TriKota::ThyraDirectApplicInterface::setOutArgs(
+  MEB::OutArgs<double>& outArgs_, const Teuchos::RCP<Thyra::VectorBase<double> >& g,
+  const MEB::Derivative<double>& dgdpDeriv,
+  const bool computeValues, const bool computeGradients) const
+{
+  outArgs_.set_g(g_index, computeValues ? g : Teuchos::null);
+  if (supportsSensitivities)
+    outArgs_.set_DgDp(g_index, p_index,
+                      computeGradients ? dgdpDeriv : MEB::Derivative<double>());
+}
+
+void TriKota::ThyraDirectApplicInterface::loadParameters(
+  const double* x, const unsigned int nVars, Thyra::VectorBase<double>& p) const
+{
+  if (spmd_p_space != Teuchos::null) {
+    // Only the locally owned entries are touched, so no gather/scatter
+    Thyra::DetachedSpmdVectorView<double> my_p(Teuchos::rcpFromRef(p));
+    const Thyra::Ordinal globalEnd = std::min<Thyra::Ordinal>(localOffset+localDim, nVars);
+    for (Thyra::Ordinal gi=localOffset; gi<globalEnd; gi++) my_p[gi-localOffset]=x[gi];
+  }
+  else {
+    Thyra::DetachedVectorView<double> my_p(Teuchos::rcpFromRef(p));
+    for (unsigned int i=0; i<nVars; i++) my_p[i]=x[i];
+  }
+}
+
+void TriKota::ThyraDirectApplicInterface::unloadResponses(
+  const Thyra::VectorBase<double>& g, const unsigned int nFns, double* vals) const
+{
+  if (responsesReplicated) {
+    const Thyra::ConstDetachedSpmdVectorView<double> my_g(Teuchos::rcpFromRef(g));
+    for (unsigned int j=0; j<nFns; j++) vals[j]= my_g[j];
+  }
+  else {
+    const Thyra::ConstDetachedVectorView<double> my_g(Teuchos::rcpFromRef(g));
+    for (unsigned int j=0; j<nFns; j++) vals[j]= my_g[j];
+  }
+}
+
+void TriKota::ThyraDirectApplicInterface::unloadGradients(
+  const Thyra::MultiVectorBase<double>& dgdp,
+  const unsigned int nVars, const unsigned int nFns,
+  double* grads, const int ldGrads, const Teuchos::ArrayView<const int>& active)
+{
+  if (nVars == 0 || nFns == 0) return;
+
+  // Copy all responses, or only the ones in the active set
+  const bool all = (active.size() == 0);
+  const int nCopy = all ? nFns : active.size();
+
+  const Teuchos::RCP<const Thyra::MultiVectorBase<double> > dgdp_rcp = Teuchos::rcpFromRef(dgdp);
+
+  if (orientation == MEB::DERIV_TRANS_MV_BY_ROW && spmd_p_space != Teuchos::null) {
+    // Each rank copies the rows it owns; a single reduction to the analysis
+    // rank 0, the one Dakota reads the response from, assembles fnGrads.
+    // The reduction buffer only holds the copied columns.
+    const Thyra::Ordinal globalEnd = std::min<Thyra::Ordinal>(localOffset+localDim, nVars);
+    const bool distributed = comm->getSize() > 1;
+    const Thyra::Ordinal nCopied = Thyra::Ordinal(nVars)*nCopy;
+    if (distributed) gradBuffer.assign(nCopied, 0.0);
+
+    if (globalEnd > localOffset) {
+      const Thyra::ConstDetachedMultiVectorView<double> my_dgdp(dgdp_rcp,
+        Teuchos::Range1D(localOffset, globalEnd-1), Teuchos::Range1D(0, nFns-1));
+      const int nRows = globalEnd-localOffset;
+      if (all) {
+        double* target = distributed ? gradBuffer.getRawPtr() : grads;
+        TriKota::copyGradientBlock(nRows, nFns, my_dgdp.values(), my_dgdp.leadingDim(),
+          target+localOffset, distributed ? nVars : ldGrads);
+      }
+      else {
+        for (Thyra::Ordinal c=0; c<nCopy; c++) {
+          double* target = distributed ?
+            gradBuffer.getRawPtr() + c*nVars : grads + active[c]*Thyra::Ordinal(ldGrads);
+          TriKota::copyGradientBlock(nRows, 1, my_dgdp.values() + active[c]*my_dgdp.leadingDim(),
+            my_dgdp.leadingDim(), target+localOffset, nVars);
+        }
+      }
+    }
+
+    if (distributed) {
+      const bool direct = all && ((unsigned int) ldGrads == nVars);
+      if (!direct) gradResult.resize(nCopied);
+      double* result = direct ? grads : gradResult.getRawPtr();
+      Teuchos::reduce<Thyra::Ordinal, double>(gradBuffer.getRawPtr(), result,
+        nCopied, Teuchos::REDUCE_SUM, 0, *comm);
+      if (!direct && comm->getRank() == 0) {
+        for (Thyra::Ordinal c=0; c<nCopy; c++)
+          TriKota::copyGradientBlock(nVars, 1, result + c*nVars, nVars,
+                                     grads + (all ? c : active[c])*Thyra::Ordinal(ldGrads), ldGrads);
+      }
+    }
+  }
+  else if (orientation == MEB::DERIV_MV_BY_COL) {
+    // One view of the whole block (local when g is replicated), then a
+    // tiled transpose into fnGrads, or one row per active response
+    const Thyra::ConstDetachedMultiVectorView<double> my_dgdp(dgdp_rcp,
+      Teuchos::Range1D(0, nFns-1), Teuchos::Range1D(0, nVars-1));
+    if (all) {
+      TriKota::transposeGradientBlock(nFns, nVars, my_dgdp.values(), my_dgdp.leadingDim(),
+                                      grads, ldGrads);
+    }
+    else {
+      for (int c=0; c<nCopy; c++)
+        TriKota::transposeGradientBlock(1, nVars, my_dgdp.values() + active[c],
+          my_dgdp.leadingDim(), grads + active[c]*Thyra::Ordinal(ldGrads), ldGrads);
+    }
+  }
+  else {
+    const Thyra::ConstDetachedMultiVectorView<double> my_dgdp(dgdp_rcp,
+      Teuchos::Range1D(0, nVars-1), Teuchos::Range1D(0, nFns-1));
+    if (all) {
+      TriKota::copyGradientBlock(nVars, nFns, my_dgdp.values(), my_dgdp.leadingDim(),
+                                 grads, ldGrads);
+    }
+    else {
+      for (int c=0; c<nCopy; c++)
+        TriKota::copyGradientBlock(nVars, 1, my_dgdp.values() + active[c]*my_dgdp.leadingDim(),
+          my_dgdp.leadingDim(), grads + active[c]*Thyra::Ordinal(ldGrads), ldGrads);
+    }
+  }
+}
+
+void TriKota::ThyraDirectApplicInterface::setSensitivityCosts(const double adjointCost_,
+                                                              const double forwardCost_)
+{
+  core.setSensitivityCosts(adjointCost_, forwardCost_);
+  if (App != Teuchos::null && supportsSensitivities) selectOrientation();
+}
+
+void TriKota::ThyraDirectApplicInterface::calibrateSensitivityOrientation()
+{
+  if (App == Teuchos::null || !supportsSensitivities) return;
+
+  double cost[2] = { core.getAdjointCost(), core.getForwardCost() };
+  const MEB::EDerivativeMultiVectorOrientation orientations[2] =
+    { MEB::DERIV_TRANS_MV_BY_ROW, MEB::DERIV_MV_BY_COL };
+  MEB::OutArgs<double> calibrationOutArgs = App->createOutArgs();
+  for (int o=0; o<2; o++) {
+    if (!supportDgDp.supports(orientations[o])) continue;
+    const Teuchos::RCP<Thyra::MultiVectorBase<double> > dgdp = (o == 0) ?
+      Thyra::createMembers<double>(App->get_p_space(p_index), numResponses) :
+      Thyra::createMembers<double>(App->get_g_space(g_index), numParameters);
+    calibrationOutArgs.set_DgDp(g_index, p_index,
+      MEB::DerivativeMultiVector<double>(dgdp, orientations[o]));
+
+    const std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+    App->evalModel(inArgs, calibrationOutArgs);
+    const double local = std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - begin).count();
+
+    // Every rank has to make the same choice
+    double slowest = local;
+    if (comm != Teuchos::null)
+      Teuchos::reduceAll<Thyra::Ordinal, double>(*comm, Teuchos::REDUCE_MAX, 1, &local, &slowest);
+    const unsigned int solves = (o == 0) ? numResponses : numParameters;
+    cost[o] = AdapterCore::solveCost(slowest, solves);
+  }
+  setSensitivityCosts(cost[0], cost[1]);
+}
+
+void TriKota::ThyraDirectApplicInterface::selectOrientation()
+{
+  const bool trans = supportDgDp.supports(MEB::DERIV_TRANS_MV_BY_ROW);
+  const bool byCol = supportDgDp.supports(MEB::DERIV_MV_BY_COL);
+  const MEB::EDerivativeMultiVectorOrientation selected =
+    core.preferAdjoint(trans, byCol, numParameters, numResponses) ?
+    MEB::DERIV_TRANS_MV_BY_ROW : MEB::DERIV_MV_BY_COL;
+  if (orientationSelected && selected == orientation) return;
+  orientationSelected = true;
+  orientation = selected;
+
+  // Storage shaped by the orientation is (re)allocated by the next
+  // gradient request, so studies without gradients never allocate it
+  model_dgdp = Teuchos::null;
+  model_dgdp_deriv = MEB::Derivative<double>();
+  fnGradsView = Teuchos::null;
+  fnGradsViewPtr = 0;
+  for (int w=0; w<workspaces.size(); w++) {
+    workspaces[w].dgdp = Teuchos::null;
+    workspaces[w].dgdpDeriv = MEB::Derivative<double>();
+  }
+
+  if (comm == Teuchos::null || comm->getRank() == 0)
+    core.reportOrientation(orientation == MEB::DERIV_TRANS_MV_BY_ROW, trans, byCol,
+                           numParameters, numResponses);
+}
+
+Teuchos::RCP<Thyra::MultiVectorBase<double> >
+TriKota::ThyraDirectApplicInterface::createSensitivities() const
+{
+  if (orientation == MEB::DERIV_TRANS_MV_BY_ROW)
+    return Thyra::createMembers<double>(App->get_p_space(p_index), numResponses);
+  else
+    return Thyra::createMembers<double>(App->get_g_space(g_index), numParameters);
+}
+
+void TriKota::ThyraDirectApplicInterface::allocateSensitivities()
+{
+  if (model_dgdp != Teuchos::null) return;
+  model_dgdp = createSensitivities();
+  model_dgdp_deriv = MEB::DerivativeMultiVector<double>(model_dgdp, orientation);
+}
+
+void TriKota::ThyraDirectApplicInterface::setHessianBlockSize(const int blockSize)
+{
+  TEUCHOS_TEST_FOR_EXCEPTION(blockSize < 1, std::logic_error,
+    "TriKota Adapter Error: Hessian block size must be positive, not " << blockSize);
+  hessBlockSize = blockSize;
+  hessDirections = Teuchos::null;
+  hessProducts = Teuchos::null;
+}
+
+void TriKota::ThyraDirectApplicInterface::computeHessians()
+{
+  const int n = numVars;
+  if (n == 0) return;
+  const int blockSize = std::min(hessBlockSize, n);
+
+  if (hessDirections == Teuchos::null || hessDirections->domain()->dim() != blockSize) {
+    hessDirections = Thyra::createMembers<double>(App->get_p_space(p_index), blockSize);
+    hessProducts = Thyra::createMembers<double>(App->get_p_space(p_index), blockSize);
+    if (!supportsHessian) {
+      hessInArgs.set_p_direction(p_index, hessDirections);
+      hessOutArgs.set_hess_vec_prod_g_pp(g_index, p_index, p_index, hessProducts);
+    }
+  }
+
+  for (unsigned int k=0; k<numFns; k++) {
+    if (!(directFnASV[k] & 4)) continue;
+
+    // Hessian of response k alone
+    Thyra::put_scalar(0.0, hessMultiplier.ptr());
+    Thyra::set_ele(k, 1.0, hessMultiplier.ptr());
+    if (supportsHessian) App->evalModel(hessInArgs, hessOutArgs);
+
+    RealSymMatrix& hessian = fnHessians[k];
+    for (int c0=0; c0<n; c0+=blockSize) {
+      const int nb = std::min(blockSize, n-c0);
+      Thyra::assign(hessDirections.ptr(), 0.0);
+      for (int j=0; j<nb; j++) Thyra::set_ele(c0+j, 1.0, hessDirections->col(j).ptr());
+
+      if (supportsHessian)
+        hessOp->apply(Thyra::NOTRANS, *hessDirections, hessProducts.ptr(), 1.0, 0.0);
+      else
+        App->evalModel(hessInArgs, hessOutArgs);
+
+      // Columns c0..c0+nb-1, written to both triangles so the result does
+      // not depend on which one the symmetric matrix stores
+      const Thyra::ConstDetachedMultiVectorView<double> products(hessProducts,
+        Teuchos::Range1D(0, n-1), Teuchos::Range1D(0, nb-1));
+      for (int j=0; j<nb; j++)
+        for (int i=c0+j; i<n; i++) hessian(i, c0+j) = hessian(c0+j, i) = products(i, j);
+    }
+  }
+}
+
+bool TriKota::ThyraDirectApplicInterface::gradientsViewable() const
+{
+  return orientation == MEB::DERIV_TRANS_MV_BY_ROW
+    && default_spmd_p_space != Teuchos::null
+    && comm->getSize() == 1
+    && numVars == numParameters
+    && numFns == numResponses
+    && (unsigned int) fnGrads.numRows() == numParameters
+    && (unsigned int) fnGrads.numCols() == numResponses;
+}
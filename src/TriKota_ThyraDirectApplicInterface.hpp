@@ -38,10 +38,22 @@
 #include "ProblemDescDB.hpp"
 
 #include "Thyra_ModelEvaluatorDefaultBase.hpp"
+#include "Thyra_LinearOpBase.hpp"
+#include "Thyra_SpmdVectorSpaceBase.hpp"
+#include "Thyra_DefaultSpmdVectorSpace.hpp"
+#include "TriKota_ModelEvaluatorExtensions.hpp"
+#include "TriKota_AdapterCore.hpp"
+#include "TriKota_ThreadPool.hpp"
+#include "TriKota_EvaluationStatistics.hpp"
+#include "TriKota_FiniteDifference.hpp"
 
 #include "Teuchos_RCP.hpp"
+#include "Teuchos_Array.hpp"
+#include "Teuchos_Comm.hpp"
 #include "Teuchos_Assert.hpp"
 
+#include <vector>
+
 //!  TriKota namespace
 namespace TriKota {
 
@@ -50,7 +62,8 @@ namespace TriKota {
   and wraps an EpetraExt::ModelEvaluator. It can then be passed in
   as the argument to the TriKota::Driver::run method.
 */
-class ThyraDirectApplicInterface : public Dakota::DirectApplicInterface
+class ThyraDirectApplicInterface : public Dakota::DirectApplicInterface,
+                                   public InstrumentedInterface
 {
 public:
 
@@ -62,13 +75,140 @@ public:
      //const Teuchos::RCP<Thyra::ModelEvaluator<double> > App_);
      int p_index = 0,
      int g_index = 0);
+
+   /*! \brief Constructor for the Dakota interface interface_id (the
+     id_interface of its block in the input), for studies over several
+     models run through TriKota::Driver::run(appInterfaces). The adapter
+     reads that interface block and seeds the first model using it; an
+     empty id is the first model of the input. */
+   ThyraDirectApplicInterface(
+     Dakota::ProblemDescDB& problem_db_,
+     const std::string& interface_id,
+     const Teuchos::RCP<Thyra::ModelEvaluatorDefaultBase<double> > App_,
+     int p_index = 0,
+     int g_index = 0);
+
+  /*! \brief Constructor mapping Dakota's continuous variables across the
+    parameter blocks p_indices and its response functions across the
+    response blocks g_indices, in the order given. All blocks come from
+    one evalModel call; see TriKota::BlockedModelEvaluator. */
+   ThyraDirectApplicInterface(
+     Dakota::ProblemDescDB& problem_db_,
+     const Teuchos::RCP<Thyra::ModelEvaluatorDefaultBase<double> > App_,
+     const Teuchos::Array<int>& p_indices,
+     const Teuchos::Array<int>& g_indices);
   
 
   ~ThyraDirectApplicInterface() {};
 
+  /*! \brief Use an evaluation cache (may be shared with other adapters).
+    A null cache (the default) turns caching off. */
+  void setEvaluationCache(const Teuchos::RCP<EvaluationCache>& cache)
+    { core.setEvaluationCache(cache); }
+
+  //! Accessor for the evaluation cache, null if none is used
+  Teuchos::RCP<EvaluationCache> getEvaluationCache() const { return core.getEvaluationCache(); }
+
+  /*! \brief Replay the evaluations of earlier runs from a journal and
+    append the new ones to it. A null journal (the default) turns it off.
+    Give every rank of the analysis communicator a journal over the same
+    file; only rank 0 appends. */
+  void setEvaluationJournal(const Teuchos::RCP<EvaluationJournal>& journal)
+    { core.setEvaluationJournal(journal); }
+
+  //! Accessor for the evaluation journal, null if none is used
+  Teuchos::RCP<EvaluationJournal> getEvaluationJournal() const { return core.getEvaluationJournal(); }
+
+  /*! \brief Stream every evaluation computed by the model (variables,
+    values and, if the writer records them, gradients) to a columnar
+    results file. A null writer (the default) turns it off. Only the
+    analysis rank 0 appends, so the other ranks may pass null. */
+  void setResultsWriter(const Teuchos::RCP<ResultsWriter>& writer)
+    { core.setResultsWriter(writer); }
+
+  //! Accessor for the results writer, null if none is used
+  Teuchos::RCP<ResultsWriter> getResultsWriter() const { return core.getResultsWriter(); }
+
+  /*! \brief Run the evaluations queued in asynchronous mode
+    (\c asynchronous \c evaluation_concurrency = N in the dakota input)
+    concurrently on numThreads local threads, each with its own
+    parameter, response and sensitivity storage. A negative value uses
+    Dakota's evaluation concurrency, 0 or 1 turns threading off (the
+    default). The model must support concurrent evalModel calls and run
+    on an analysis communicator of a single rank. A model that is a
+    TriKota::MultiPointModelEvaluator is still evaluated as one batch.
+  */
+  void setEvaluationThreads(const int numThreads);
+
+  /*! \brief Number of Hessian columns assembled per model call when
+    Dakota asks for Hessians (default 16). The Hessian of each response
+    is applied to blockSize unit directions at a time, through
+    OUT_ARG_hess_g_pp if the model supports it and
+    OUT_ARG_hess_vec_prod_g_pp otherwise, so the adapter only stores
+    numParameters x blockSize blocks; the dense matrix is fnHessians. */
+  void setHessianBlockSize(const int blockSize);
+
+  /*! \brief Relative cost of one adjoint solve (DERIV_TRANS_MV_BY_ROW
+    needs one per response) and one forward sensitivity solve
+    (DERIV_MV_BY_COL needs one per parameter). If the model supports
+    both orientations, the one with the smaller numResponses*adjointCost
+    or numParameters*forwardCost is used. Both costs default to 1, which
+    compares the dimensions; ties go to DERIV_TRANS_MV_BY_ROW.
+  */
+  void setSensitivityCosts(const double adjointCost, const double forwardCost);
+
+  /*! \brief Measure the sensitivity costs by timing one DgDp evaluation
+    in each supported orientation at the current parameters (slowest
+    rank), then select the orientation as in setSensitivityCosts(). */
+  void calibrateSensitivityOrientation();
+
+  //! Orientation of the DgDp requested from the model
+  Thyra::ModelEvaluatorBase::EDerivativeMultiVectorOrientation
+  getSensitivityOrientation() const { return orientation; }
+
+  /*! \brief Compute the gradients Dakota asks for by finite differences
+    of the responses instead of the model's DgDp (needed when the model
+    does not support OUT_ARG_DgDp). The steps are steps[i] if given (one
+    per Dakota variable), relativeStep*max(|x_i|,1) otherwise. All
+    perturbed points of one gradient are columns of one multivector,
+    evaluated in a single call if the model is a
+    TriKota::MultiPointModelEvaluator, on the evaluation threads if
+    setEvaluationThreads() is on, one by one otherwise. FD_FORWARD
+    reuses the responses at the point itself. FD_NONE (the default)
+    turns it off. */
+  void setFiniteDifferenceGradients(const EFiniteDifference method,
+                                    const double relativeStep = 1.0e-6,
+                                    const Teuchos::ArrayView<const double>& steps = Teuchos::null);
+
+  //! Finite-difference method used for the gradients, FD_NONE if the DgDp is
+  EFiniteDifference getFiniteDifferenceGradients() const { return fdMethod; }
+
+  /*! \brief Warm start the model's nonlinear solves from the state of
+    the nearest earlier evaluation within maxDistance (Euclidean, over
+    Dakota's variables), keeping at most maxStates states. The model
+    must be a TriKota::WarmStartModelEvaluator<Thyra::VectorBase<double>>; maxStates = 0 turns
+    warm starting off (the default). */
+  void setWarmStart(const double maxDistance, const int maxStates = 8);
+
+  //! Pool of warm start states, null if warm starting is off
+  Teuchos::RCP<StatePool<Thyra::VectorBase<double>> > getStatePool() const { return statePool; }
+
+  //! Timers and counters of the evaluations performed so far
+  Teuchos::RCP<EvaluationStatistics> getEvaluationStatistics() const { return evalStats; }
+
+  /*! \brief Gradient evaluations that reused the forward solve of the
+    previous evaluation at the same point (see
+    TriKota::ForwardReuseModelEvaluator) */
+  int numForwardReuses() const { return core.numForwardReuses(); }
+
 protected:
 
-  //! Virtual function redefinition from Dakota::DirectApplicInterface
+  //! Communicator of the parameter space, null if it is not an Spmd space
+  Teuchos::RCP<const Teuchos::Comm<Thyra::Ordinal> > getComm() const { return comm; }
+
+  /*! \brief Virtual function redefinition from Dakota::DirectApplicInterface.
+    An exception thrown by the model's evalModel is returned as a
+    non-zero fail code, so Dakota's failure_capture handles it. */
   int derived_map_ac(const Dakota::String& ac_name);
 
   //! Virtual function redefinition from Dakota::DirectApplicInterface
@@ -76,8 +216,114 @@ protected:
 
   //int derived_map_if(const Dakota::String& if_name);
 
+  /*! \brief Virtual function redefinition from Dakota::ApplicationInterface.
+    Nothing is launched here: the evaluations are collected in Dakota's
+    queue and performed together in wait_local_evaluations(). */
+  void derived_map_asynch(const Dakota::ParamResponsePair& pair);
+
+  /*! \brief Virtual function redefinition from Dakota::ApplicationInterface.
+    Evaluates the whole queue of pending evaluations, in a single call
+    if the model is a TriKota::MultiPointModelEvaluator. */
+  void wait_local_evaluations(Dakota::PRPQueue& prp_queue);
+
+  //! Virtual function redefinition from Dakota::ApplicationInterface
+  void test_local_evaluations(Dakota::PRPQueue& prp_queue);
+
 private:
 
+  //! Storage owned by one evaluation thread
+  struct EvalWorkspace {
+    Teuchos::RCP<Thyra::VectorBase<double> > p;
+    Teuchos::RCP<Thyra::VectorBase<double> > g;
+    Teuchos::RCP<Thyra::MultiVectorBase<double> > dgdp;
+    Thyra::ModelEvaluatorBase::InArgs<double> inArgs;
+    Thyra::ModelEvaluatorBase::OutArgs<double> outArgs;
+    Thyra::ModelEvaluatorBase::Derivative<double> dgdpDeriv;
+  };
+
+  //! One queued evaluation, detached from the Dakota data members
+  struct EvalTask {
+    std::vector<double> x;
+    unsigned int numVars;
+    unsigned int numFns;
+    bool computeValues;
+    bool computeGradients;
+    bool failed;
+    std::vector<double> vals;
+    std::vector<double> grads;
+    Teuchos::Array<int> activeGrads;
+    bool allGradients;
+    EvaluationStatistics::Record record;
+  };
+
+  //! Evaluate the queue concurrently on the thread pool
+  void evalThreaded(Dakota::PRPQueue& prp_queue);
+
+  //! Evaluate one task with the given workspace (called from the threads)
+  void evalTask(EvalWorkspace& workspace, EvalTask& task);
+
+  /*! \brief Evaluate one queued evaluation with derived_map_ac, handing
+    a failure to Dakota's failure capture */
+  void evalQueued(const Dakota::ParamResponsePair& pair);
+
+  //! Evaluate the queue with one TriKota::MultiPointModelEvaluator call
+  void evalMultiPoint(const MultiPointModelEvaluator& multiPointApp,
+                      Dakota::PRPQueue& prp_queue);
+
+  /*! \brief Select the outputs of the persistent outArgs for one
+    evaluation; dgdpDeriv is used when computeGradients is true. */
+  void setOutArgs(Thyra::ModelEvaluatorBase::OutArgs<double>& outArgs,
+                  const Teuchos::RCP<Thyra::VectorBase<double> >& g,
+                  const Thyra::ModelEvaluatorBase::Derivative<double>& dgdpDeriv,
+                  const bool computeValues, const bool computeGradients) const;
+
+  //! Copy the Dakota variables x (e.g. xC) into the parameter vector p
+  void loadParameters(const double* x, const unsigned int nVars,
+                      Thyra::VectorBase<double>& p) const;
+
+  //! Copy the responses g into vals (e.g. fnVals)
+  void unloadResponses(const Thyra::VectorBase<double>& g,
+                       const unsigned int nFns, double* vals) const;
+
+  /*! \brief Copy the sensitivities dgdp into the Dakota layout grads
+    (e.g. fnGrads), only for the responses in active if it is not empty. */
+  void unloadGradients(const Thyra::MultiVectorBase<double>& dgdp,
+                       const unsigned int nVars, const unsigned int nFns,
+                       double* grads, const int ldGrads,
+                       const Teuchos::ArrayView<const int>& active = Teuchos::null);
+
+  /*! \brief Pick the DgDp orientation from the costs; storage of the
+    previous orientation is released */
+  void selectOrientation();
+
+  //! New DgDp storage in the selected orientation
+  Teuchos::RCP<Thyra::MultiVectorBase<double> > createSensitivities() const;
+
+  //! Allocate model_dgdp, on the first gradient request
+  void allocateSensitivities();
+
+  /*! \brief Fill fnGrads by finite differences around the parameters
+    in model_p; g0 holds the responses there (e.g. fnVals). */
+  void computeFiniteDifferenceGradients(const double* g0);
+
+  //! Evaluate the responses G at the columns of P, see setFiniteDifferenceGradients()
+  void evalStencil(const Thyra::MultiVectorBase<double>& P,
+                   Thyra::MultiVectorBase<double>& G);
+
+  //! Fill fnHessians for the responses whose ASV requests it
+  void computeHessians();
+
+  //! True if fnGrads can be used directly as the DgDp storage
+  bool gradientsViewable() const;
+
+  /*! \brief Fill fnVals/fnGrads from the evaluation cache (then the
+    journal) and tell what
+    is left to compute. Returns true if nothing is. */
+  bool lookupCache(bool& computeValues, bool& computeGradients);
+
+  //! Store what was just computed into the evaluation cache and journal
+  void storeCache(const bool computedValues, const bool computedGradients);
+
   // Data
   Teuchos::RCP<Thyra::ModelEvaluatorDefaultBase<double> > App;
   int p_index;
@@ -86,9 +332,73 @@ private:
   Teuchos::RCP<Thyra::VectorBase<double> > model_g;
   Teuchos::RCP<Thyra::MultiVectorBase<double> > model_dgdp;
   Thyra::ModelEvaluatorBase::EDerivativeMultiVectorOrientation orientation;
+
+  // Argument objects built once; only their entries change per evaluation
+  Thyra::ModelEvaluatorBase::InArgs<double> inArgs;
+  Thyra::ModelEvaluatorBase::OutArgs<double> outArgs;
+  Thyra::ModelEvaluatorBase::Derivative<double> model_dgdp_deriv;
+
   unsigned int numParameters;
   unsigned int numResponses;
   bool supportsSensitivities;
+  Thyra::ModelEvaluatorBase::DerivativeSupport supportDgDp;
+
+  // Hessians of the responses: explicit operator or Hessian-vector products
+  bool supportsHessian;
+  bool supportsHessVecProd;
+  int hessBlockSize;
+  Thyra::ModelEvaluatorBase::InArgs<double> hessInArgs;
+  Thyra::ModelEvaluatorBase::OutArgs<double> hessOutArgs;
+  Teuchos::RCP<Thyra::VectorBase<double> > hessMultiplier;
+  Teuchos::RCP<Thyra::LinearOpBase<double> > hessOp;
+  Teuchos::RCP<Thyra::MultiVectorBase<double> > hessDirections;
+  Teuchos::RCP<Thyra::MultiVectorBase<double> > hessProducts;
+
+  // Finite-difference gradients
+  EFiniteDifference fdMethod;
+  double fdRelativeStep;
+  Teuchos::Array<double> fdSteps;
+
+  // Gradient requests restricted to Dakota's active set
+  const ActiveSetModelEvaluator* activeSetApp;
+  Teuchos::Array<int> activeGrads;
+
+  // Warm starts from earlier states
+  const WarmStartModelEvaluator<Thyra::VectorBase<double>>* warmStartApp;
+  Teuchos::RCP<StatePool<Thyra::VectorBase<double>> > statePool;
+
+  // Forward solves reused by gradient requests at the same point
+  const ForwardReuseModelEvaluator* forwardReuseApp;
+
+  // Record of a point of a failed multi-point batch, continued by its retry
+  EvaluationStatistics::Record retryRecord;
+  bool retrying;
+
+  // Locally owned part of the parameter space, when it is an Spmd space
+  Teuchos::RCP<const Thyra::SpmdVectorSpaceBase<double> > spmd_p_space;
+  Teuchos::RCP<const Thyra::DefaultSpmdVectorSpace<double> > default_spmd_p_space;
+  Teuchos::RCP<const Teuchos::Comm<Thyra::Ordinal> > comm;
+  Thyra::Ordinal localOffset;
+  Thyra::Ordinal localDim;
+  bool responsesReplicated;
+
+  // Workspace for assembling distributed gradients
+  Teuchos::Array<double> gradBuffer;
+  Teuchos::Array<double> gradResult;
+
+  // Thyra view of Dakota's fnGrads storage, rebuilt if it moves
+  Teuchos::RCP<Thyra::MultiVectorBase<double> > fnGradsView;
+  Thyra::ModelEvaluatorBase::Derivative<double> fnGradsDeriv;
+  double* fnGradsViewPtr;
+  bool orientationSelected;
+
+  // Cache, journal, results writer, active set and orientation costs
+  AdapterCore core;
+  Teuchos::RCP<EvaluationStatistics> evalStats;
+
+  // Threaded asynchronous evaluations
+  Teuchos::RCP<ThreadPool> threadPool;
+  Teuchos::Array<EvalWorkspace> workspaces;
 };
 
 } // namespace TriKota
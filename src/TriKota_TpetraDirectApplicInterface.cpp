@@ -0,0 +1,584 @@
+// @HEADER
+// ************************************************************************
+// 
+//        TriKota: A Trilinos Wrapper for the Dakota Framework
+//                  Copyright (2009) Sandia Corporation
+// 
+// Under the terms of Contract DE-AC04-94AL85000 with Sandia Corporation,
+// the U.S. Government retains certain rights in this software.
+// 
+// This library is free software; you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation; either version 2.1 of the
+// License, or (at your option) any later version.
+//  
+// This library is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301
+// USA
+// 
+// Questions? Contact Andy Salinger (agsalin@sandia.gov), Sandia
+// National Laboratories.
+// 
+// ************************************************************************
+// @HEADER
+
+#include <iostream>
+#include "TriKota_TpetraDirectApplicInterface.hpp"
+#include "TriKota_GradientCopy.hpp"
+#include "Teuchos_VerboseObject.hpp"
+#include "Teuchos_CommHelpers.hpp"
+#include "Thyra_TpetraThyraWrappers.hpp"
+#include "Thyra_TpetraVectorSpace.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+
+#include "DakotaModel.hpp"
+#include "DakotaResponse.hpp"
+#include "ParamResponsePair.hpp"
+using namespace Dakota;
+
+typedef Thyra::ModelEvaluatorBase MEB;
+typedef TriKota::EvaluationStatistics ES;
+
+namespace {
+  typedef TriKota::TpetraDirectApplicInterface TDAI;
+  typedef Thyra::TpetraOperatorVectorExtraction<double,
+    TDAI::tpetra_vector::local_ordinal_type,
+    TDAI::tpetra_vector::global_ordinal_type,
+    TDAI::tpetra_vector::node_type> ConverterT;
+  typedef Thyra::TpetraVectorSpace<double,
+    TDAI::tpetra_vector::local_ordinal_type,
+    TDAI::tpetra_vector::global_ordinal_type,
+    TDAI::tpetra_vector::node_type> TpetraSpace;
+}
+
+// Define interface class
+TriKota::TpetraDirectApplicInterface::TpetraDirectApplicInterface(
+  ProblemDescDB& problem_db_,
+  const Teuchos::RCP<Thyra::ModelEvaluatorDefaultBase<double> > App_,
+  int p_index_,
+  int g_index_)
+  : TpetraDirectApplicInterface(problem_db_, std::string(), App_, p_index_, g_index_)
+{
+}
+
+TriKota::TpetraDirectApplicInterface::TpetraDirectApplicInterface(
+  ProblemDescDB& problem_db_,
+  const std::string& interface_id,
+  const Teuchos::RCP<Thyra::ModelEvaluatorDefaultBase<double> > App_,
+  int p_index_,
+  int g_index_)
+  : Dakota::DirectApplicInterface(AdapterCore::selectInterface(problem_db_, interface_id)),
+    App(App_),
+    p_index(p_index_),
+    g_index(g_index_),
+    pOffset(0),
+    rootRank(true),
+    supportsSensitivities(false),
+    orientation(MEB::DERIV_MV_BY_COL),
+    activeSetApp(0),
+    warmStartApp(0),
+    forwardReuseApp(0),
+    stageGradients(false),
+    orientationSelected(false),
+    evalStats(Teuchos::rcp(new EvaluationStatistics))
+{
+  const std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+  Teuchos::RCP<Teuchos::FancyOStream>
+    out = Teuchos::VerboseObjectBase::getDefaultOStream();
+
+  deferred.launched = false;
+  deferred.attached = false;
+  deferred.copying = false;
+
+  if (App != Teuchos::null) {
+    const Teuchos::RCP<const tpetra_map> p_map = tpetraMap(App->get_p_space(p_index));
+    const Teuchos::RCP<const tpetra_map> g_map = tpetraMap(App->get_g_space(g_index));
+
+    // Start from the nominal parameters; the Thyra wrappers share the storage
+    tpetra_p = Teuchos::rcp(new tpetra_vector(
+      *ConverterT::getConstTpetraVector(App->getNominalValues().get_p(p_index)), Teuchos::Copy));
+    tpetra_g = Teuchos::rcp(new tpetra_vector(g_map));
+    model_p = Thyra::createVector(tpetra_p, App->get_p_space(p_index));
+    model_g = Thyra::createVector(tpetra_g, App->get_g_space(g_index));
+
+    numParameters = p_map->getGlobalNumElements();
+    numResponses  = g_map->getGlobalNumElements();
+    activeSetApp = dynamic_cast<const ActiveSetModelEvaluator*>(App.get());
+    forwardReuseApp = dynamic_cast<const ForwardReuseModelEvaluator*>(App.get());
+
+    // Contiguous maps: the local entries are Dakota variables pOffset..
+    pOffset = p_map->getMinGlobalIndex() - p_map->getIndexBase();
+    rootRank = (p_map->getComm()->getRank() == 0);
+    if (g_map->isDistributed()) {
+      root_g = Teuchos::rcp(new tpetra_vector(rootMap(g_map)));
+      gImporter = Teuchos::rcp(new tpetra_import(g_map, root_g->getMap()));
+    }
+
+    if (rootRank)
+      *out << "TriKota:: ModeEval has " << numParameters <<
+              " parameters and " << numResponses << " responses." << std::endl;
+
+    supportDgDp = App->createOutArgs().supports(MEB::OUT_ARG_DgDp, g_index, p_index);
+    supportsSensitivities = !(supportDgDp.none());
+
+    if (supportsSensitivities) {
+      if (rootRank) *out << "TriKota:: ModeEval supports gradients calculation." << std::endl;
+
+      TEUCHOS_TEST_FOR_EXCEPTION(!supportDgDp.supports(MEB::DERIV_TRANS_MV_BY_ROW) &&
+                                 !supportDgDp.supports(MEB::DERIV_MV_BY_COL), std::logic_error,
+              "TriKota Adapter Error: DgDp data type not implemented");
+      selectOrientation();
+    }
+
+    // The parameters always live in model_p; the outputs are toggled per
+    // evaluation in setOutArgs
+    inArgs = App->createInArgs();
+    inArgs.set_p(p_index, model_p);
+    outArgs = App->createOutArgs();
+
+    if (rootRank)
+      *out << "TriKota:: Setting initial guess from Model Evaluator to Dakota " << std::endl;
+
+    Model& first_model = AdapterCore::interfaceModel(problem_db_, interface_id);
+    unsigned int num_dakota_vars =  first_model.acv();
+    Dakota::RealVector drv(num_dakota_vars);
+
+    TEUCHOS_TEST_FOR_EXCEPTION(
+      num_dakota_vars > numParameters, std::logic_error,
+      "TriKota Adapter Error: number of parameters in ModelEvaluator  " <<  
+      numParameters << 
+      "\n is less then the number of continuous variables\n" << 
+      " specified in the dakota.in input file " << num_dakota_vars << "\n" );
+
+    // Each rank contributes the entries it owns; one reduction to rank 0
+    // assembles them
+    if (num_dakota_vars > 0) {
+      Teuchos::Array<double> local_drv(num_dakota_vars, 0.0);
+      const auto my_p = tpetra_p->getLocalViewHost(Tpetra::Access::ReadOnly);
+      for (int i=0; i<(int) my_p.extent(0); i++)
+        if (pOffset + i < (int) num_dakota_vars) local_drv[pOffset + i] = my_p(i,0);
+      Teuchos::reduce<int, double>(local_drv.getRawPtr(), drv.values(),
+        num_dakota_vars, Teuchos::REDUCE_SUM, 0, *p_map->getComm());
+    }
+    if (rootRank) first_model.continuous_variables(drv);
+  }
+  else {
+    *out << "Warning in TriKota::TpetraDirectApplicInterface constructor\n" 
+         << "\tModelEvaluator is null. This is OK iff Dakota has assigned"
+         << " MPI_COMM_NULL to this Proc " << std::endl;
+  }
+
+  evalStats->addStartupTime(std::chrono::duration<double>(
+    std::chrono::steady_clock::now() - begin).count());
+}
+
+int TriKota::TpetraDirectApplicInterface::derived_map_ac(const Dakota::String& ac_name)
+{
+  return evaluate(false);
+}
+
+int TriKota::TpetraDirectApplicInterface::evaluate(const bool deferGradients)
+{
+
+  if (App != Teuchos::null) {
+
+    // Test for consistency of problem definition between ModelEval and Dakota
+    TEUCHOS_TEST_FOR_EXCEPTION(numVars > numParameters, std::logic_error,
+                       "TriKota_Dakota Adapter Error: ");
+    TEUCHOS_TEST_FOR_EXCEPTION(numFns > numResponses, std::logic_error,
+                       "TriKota_Dakota Adapter Error: ");
+    TEUCHOS_TEST_FOR_EXCEPTION(hessFlag, std::logic_error,
+      "TriKota Adapter Error: TriKota::TpetraDirectApplicInterface provides no Hessians;"
+      " use TriKota::ThyraDirectApplicInterface or numerical/quasi Hessians");
+    TEUCHOS_TEST_FOR_EXCEPTION(gradFlag && !supportsSensitivities, std::logic_error,
+                       "TriKota_Dakota Adapter Error: ");
+
+    ES::Record record;
+    evalStats->startEvaluation(record);
+    record.gradient = gradFlag;
+
+    // Responses whose gradients Dakota asks for; an empty list means all
+    // of the model's
+    activeGrads.clear();
+    const bool allGradients = !gradFlag ||
+      AdapterCore::loadActiveSet(directFnASV, numFns, numResponses, activeGrads);
+
+    // Only compute what the evaluation cache cannot supply
+    bool computeValues, computeGradients;
+    if (lookupCache(computeValues, computeGradients)) {
+      record.cached = true;
+      evalStats->finishEvaluation(record);
+      return 0;
+    }
+
+    // Load parameters from Dakota to ModelEval data structure
+    {
+      ES::PhaseTimer timer(record, ES::PHASE_COPY_IN, evalStats->timer(ES::PHASE_COPY_IN));
+      loadParameters();
+    }
+
+    // The model may overwrite DgDp only once the last copy of it is done
+    if (computeGradients) finishDeferredGradients();
+
+    // Evaluate model
+    if (computeGradients) allocateSensitivities();
+    setOutArgs(computeValues, computeGradients);
+    if (computeGradients && activeSetApp != 0)
+      activeSetApp->setActiveGradients(g_index, activeGrads());
+    if (statePool != Teuchos::null)
+      warmStartApp->setInitialState(statePool->nearest(xC.values(), numVars));
+
+    // A gradient request at the point of the last forward solve (e.g. the
+    // values were asked for first) only pays the sensitivity solves
+    const bool reuseForward = forwardReuseApp != 0 && computeGradients &&
+      core.atForwardPoint(xC.values(), numVars);
+    if (reuseForward) core.countForwardReuse();
+    core.clearForwardPoint();
+    int failed = 0;
+    try {
+      ES::PhaseTimer timer(record, ES::PHASE_EVAL_MODEL, evalStats->timer(ES::PHASE_EVAL_MODEL));
+      const ForwardReuseScope reuse(forwardReuseApp, g_index, reuseForward);
+      App->evalModel(inArgs, outArgs);
+    }
+    catch (const std::exception& e) {
+      failed = 1;
+      *Teuchos::VerboseObjectBase::getDefaultOStream()
+        << "TriKota:: Model evaluation failed: " << e.what() << std::endl;
+    }
+    catch (...) {
+      failed = 1;
+    }
+
+    // A failure is reported to Dakota (failure_capture) by every rank
+    // of the analysis; the time spent is kept in the statistics
+    failed = AdapterCore::anyFailed(tpetra_p->getMap()->getComm(), failed);
+    if (failed) {
+      record.failed = true;
+      evalStats->finishEvaluation(record);
+      return failed;
+    }
+    // The model's last state belongs to xC only if it ended on the solve
+    // at xC; this adapter has no finite-difference or Hessian solves
+    // after it, so that is every evaluation that solved the model
+    if (statePool != Teuchos::null && (computeValues || computeGradients))
+      statePool->insert(xC.values(), numVars, warmStartApp->getLastState());
+    core.setForwardPoint(xC.values(), numVars);
+
+    {
+      ES::PhaseTimer timer(record, ES::PHASE_COPY_OUT, evalStats->timer(ES::PHASE_COPY_OUT));
+      if (computeValues) unloadResponses();
+
+      // Every rank defers, so all of them store the evaluation at the
+      // same time; only the rank holding DgDp has a copy in flight
+      const bool defer = computeGradients && stageGradients && deferGradients;
+      if (defer) {
+        // The caller attaches the response; cache and journal wait for the gradients
+        deferred.launched = true;
+        deferred.attached = false;
+        deferred.copying = launchGradientCopy();
+        deferred.x.assign(xC.values(), xC.values() + numVars);
+        deferred.vals.assign(fnVals.values(), fnVals.values() + numFns);
+        deferred.numVars = numVars;
+        deferred.numFns = numFns;
+        deferred.activeGrads = activeGrads;
+        deferred.computedValues = computeValues;
+        deferred.allGradients = allGradients;
+      }
+      else {
+        if (computeGradients) unloadGradients(activeGrads());
+
+        // Partial gradients must not be served to later requests
+        storeCache(computeValues, computeGradients && allGradients);
+      }
+    }
+    record.bytes = ES::evaluationBytes(numVars, numFns, computeValues, computeGradients);
+    evalStats->finishEvaluation(record);
+  }
+  else {
+    TEUCHOS_TEST_FOR_EXCEPTION(
+      parallelLib.parallel_configuration().ea_parallel_level().server_intra_communicator()
+      != MPI_COMM_NULL, std::logic_error,
+      "\nTriKota Parallelism Error: ModelEvaluator=null, but analysis_comm != MPI_COMMM_NULL");
+  }
+
+  return 0;
+}
+
+int TriKota::TpetraDirectApplicInterface::derived_map_of(const Dakota::String& ac_name)
+{
+  Teuchos::RCP<Teuchos::FancyOStream>
+    out = Teuchos::VerboseObjectBase::getDefaultOStream();
+
+  // WARNING:: For some reason, this method is not being called!
+  *out << "Finished Dakota NLS Fitting!: " << std::setprecision(5) << std::endl;
+  return 0;
+}
+
+void TriKota::TpetraDirectApplicInterface::derived_map_asynch(const ParamResponsePair& pair)
+{
+  // Nothing to launch: the queued evaluations are performed in
+  // wait_local_evaluations
+}
+
+void TriKota::TpetraDirectApplicInterface::wait_local_evaluations(PRPQueue& prp_queue)
+{
+  // With staging, the gradients of one evaluation arrive while the next
+  // one is set up; an evaluation is complete once the whole queue is
+  const bool overlap = stageGradients && prp_queue.size() > 1;
+  for (PRPQueueIter prp_iter = prp_queue.begin(); prp_iter != prp_queue.end(); ++prp_iter) {
+    Response response = prp_iter->response();
+    set_local_data(prp_iter->variables(), prp_iter->active_set(), response);
+    if (evaluate(overlap) == 0)
+      overlay_response(response);
+    else
+      manage_failure(prp_iter->variables(), prp_iter->active_set(), response,
+                     prp_iter->eval_id());
+    if (deferred.launched && !deferred.attached) {
+      deferred.response = response;
+      deferred.attached = true;
+    }
+    completionSet.insert(prp_iter->eval_id());
+  }
+  finishDeferredGradients();
+}
+
+void TriKota::TpetraDirectApplicInterface::test_local_evaluations(PRPQueue& prp_queue)
+{
+  // All evaluations are blocking, so testing completes the whole queue
+  wait_local_evaluations(prp_queue);
+}
+
+void TriKota::TpetraDirectApplicInterface::setOutArgs(const bool computeValues,
+                                                      const bool computeGradients)
+{
+  outArgs.set_g(g_index, computeValues ? model_g : Teuchos::null);
+  if (supportsSensitivities)
+    outArgs.set_DgDp(g_index, p_index,
+                     computeGradients ? model_dgdp_deriv : MEB::Derivative<double>());
+}
+
+void TriKota::TpetraDirectApplicInterface::loadParameters()
+{
+  // Only the locally owned entries are touched; for a device-resident p
+  // Tpetra syncs the host view back before the model reads it
+  const auto my_p = tpetra_p->getLocalViewHost(Tpetra::Access::ReadWrite);
+  const int myVars = std::min<int>((int) numVars - pOffset, my_p.extent(0));
+  for (int i=0; i<myVars; i++) my_p(i,0) = xC[pOffset + i];
+}
+
+void TriKota::TpetraDirectApplicInterface::unloadResponses()
+{
+  if (gImporter != Teuchos::null) {
+    root_g->doImport(*tpetra_g, *gImporter, Tpetra::INSERT);
+    if (!rootRank) return;
+  }
+  const tpetra_vector& g = (gImporter != Teuchos::null) ? *root_g : *tpetra_g;
+  const auto my_g = g.getLocalViewHost(Tpetra::Access::ReadOnly);
+  for (unsigned int j=0; j<numFns; j++) fnVals[j] = my_g(j,0);
+}
+
+void TriKota::TpetraDirectApplicInterface::unloadGradients(
+  const Teuchos::ArrayView<const int>& active)
+{
+  if (stageGradients) {
+    if (launchGradientCopy()) {
+      execution_space().fence();
+      copyGradients(gradStaging.data(), std::max<int>(gradStaging.stride(1), 1),
+                    numVars, numFns, fnGrads.values(), fnGrads.stride(), active);
+    }
+    return;
+  }
+
+  const tpetra_multivector* dgdp = rootSensitivities();
+  if (dgdp == 0) return;
+
+  // One host synchronization of the whole block, then plain copies
+  const auto my_dgdp = dgdp->getLocalViewHost(Tpetra::Access::ReadOnly);
+  copyGradients(my_dgdp.data(), std::max<int>(my_dgdp.stride(1), 1),
+                numVars, numFns, fnGrads.values(), fnGrads.stride(), active);
+}
+
+void TriKota::TpetraDirectApplicInterface::copyGradients(
+  const double* dgdp_values, const int dgdp_lda,
+  const unsigned int nVars, const unsigned int nFns,
+  double* grads, const int ldGrads, const Teuchos::ArrayView<const int>& active) const
+{
+  if (active.size() == 0) {
+    if (orientation == MEB::DERIV_MV_BY_COL)
+      TriKota::transposeGradientBlock(nFns, nVars, dgdp_values, dgdp_lda, grads, ldGrads);
+    else
+      TriKota::copyGradientBlock(nVars, nFns, dgdp_values, dgdp_lda, grads, ldGrads);
+    return;
+  }
+
+  // Only the gradients of the active responses
+  for (int c=0; c<active.size(); c++) {
+    const std::ptrdiff_t k = active[c];
+    if (orientation == MEB::DERIV_MV_BY_COL)
+      TriKota::transposeGradientBlock(1, nVars, dgdp_values + k, dgdp_lda,
+                                      grads + k*ldGrads, ldGrads);
+    else
+      TriKota::copyGradientBlock(nVars, 1, dgdp_values + k*dgdp_lda, dgdp_lda,
+                                 grads + k*ldGrads, ldGrads);
+  }
+}
+
+const TriKota::TpetraDirectApplicInterface::tpetra_multivector*
+TriKota::TpetraDirectApplicInterface::rootSensitivities()
+{
+  if (dgdpImporter == Teuchos::null) return tpetra_dgdp.get();
+  root_dgdp->doImport(*tpetra_dgdp, *dgdpImporter, Tpetra::INSERT);
+  return rootRank ? root_dgdp.get() : 0;
+}
+
+bool TriKota::TpetraDirectApplicInterface::launchGradientCopy()
+{
+  const tpetra_multivector* dgdp = rootSensitivities();
+  if (dgdp == 0) return false;
+
+  const auto device_dgdp = dgdp->getLocalViewDevice(Tpetra::Access::ReadOnly);
+  if (gradStaging.extent(0) != device_dgdp.extent(0) ||
+      gradStaging.extent(1) != device_dgdp.extent(1))
+    gradStaging = staging_view(Kokkos::view_alloc("TriKota::gradStaging",
+                                                  Kokkos::WithoutInitializing),
+                               device_dgdp.extent(0), device_dgdp.extent(1));
+
+  // Ordered after the model's kernels on the default instance; returns
+  // before the transfer is done
+  Kokkos::deep_copy(execution_space(), gradStaging, device_dgdp);
+  return true;
+}
+
+void TriKota::TpetraDirectApplicInterface::finishDeferredGradients()
+{
+  if (!deferred.launched) return;
+  deferred.launched = false;
+
+  // Dakota::Response::function_gradients_view shares the response's storage
+  Dakota::RealMatrix grads = deferred.response.function_gradients_view();
+  if (deferred.copying) {
+    execution_space().fence();
+    copyGradients(gradStaging.data(), std::max<int>(gradStaging.stride(1), 1),
+                  deferred.numVars, deferred.numFns, grads.values(), grads.stride(),
+                  deferred.activeGrads());
+  }
+  storeEntry(&deferred.x[0], deferred.numVars, deferred.numFns, &deferred.vals[0],
+             grads.values(), grads.stride(),
+             deferred.computedValues, deferred.allGradients);
+  deferred.response = Dakota::Response();
+}
+
+Teuchos::RCP<const TriKota::TpetraDirectApplicInterface::tpetra_map>
+TriKota::TpetraDirectApplicInterface::tpetraMap(
+  const Teuchos::RCP<const Thyra::VectorSpaceBase<double> >& space) const
+{
+  const Teuchos::RCP<const TpetraSpace> tpetraSpace =
+    Teuchos::rcp_dynamic_cast<const TpetraSpace>(space);
+  TEUCHOS_TEST_FOR_EXCEPTION(tpetraSpace == Teuchos::null, std::logic_error,
+    "TriKota Adapter Error: TriKota::TpetraDirectApplicInterface needs Tpetra"
+    " (Thyra::TpetraVectorSpace) parameter and response spaces");
+  const Teuchos::RCP<const tpetra_map> map = tpetraSpace->getTpetraMap();
+  TEUCHOS_TEST_FOR_EXCEPTION(map->isDistributed() && !map->isContiguous(), std::logic_error,
+    "TriKota Adapter Error: distributed parameter and response maps must be contiguous");
+  return map;
+}
+
+Teuchos::RCP<const TriKota::TpetraDirectApplicInterface::tpetra_map>
+TriKota::TpetraDirectApplicInterface::rootMap(const Teuchos::RCP<const tpetra_map>& map) const
+{
+  if (!map->isDistributed()) return Teuchos::null;
+  const Tpetra::global_size_t numGlobal = map->getGlobalNumElements();
+  return Teuchos::rcp(new tpetra_map(numGlobal, rootRank ? numGlobal : 0,
+                                     map->getIndexBase(), map->getComm()));
+}
+
+void TriKota::TpetraDirectApplicInterface::setSensitivityCosts(const double adjointCost_,
+                                                               const double forwardCost_)
+{
+  core.setSensitivityCosts(adjointCost_, forwardCost_);
+  if (App != Teuchos::null && supportsSensitivities) selectOrientation();
+}
+
+void TriKota::TpetraDirectApplicInterface::selectOrientation()
+{
+  const bool trans = supportDgDp.supports(MEB::DERIV_TRANS_MV_BY_ROW);
+  const bool byCol = supportDgDp.supports(MEB::DERIV_MV_BY_COL);
+  const MEB::EDerivativeMultiVectorOrientation selected =
+    core.preferAdjoint(trans, byCol, numParameters, numResponses) ?
+    MEB::DERIV_TRANS_MV_BY_ROW : MEB::DERIV_MV_BY_COL;
+  if (orientationSelected && selected == orientation) return;
+  orientationSelected = true;
+  orientation = selected;
+
+  // Storage shaped by the orientation is (re)allocated by the next
+  // gradient request, so studies without gradients never allocate it
+  tpetra_dgdp = Teuchos::null;
+  model_dgdp = Teuchos::null;
+  model_dgdp_deriv = MEB::Derivative<double>();
+  dgdpImporter = Teuchos::null;
+  root_dgdp = Teuchos::null;
+
+  if (rootRank)
+    core.reportOrientation(orientation == MEB::DERIV_TRANS_MV_BY_ROW, trans, byCol,
+                           numParameters, numResponses);
+}
+
+void TriKota::TpetraDirectApplicInterface::allocateSensitivities()
+{
+  if (model_dgdp != Teuchos::null) return;
+  const bool byRow = (orientation == MEB::DERIV_TRANS_MV_BY_ROW);
+  const Teuchos::RCP<const Thyra::VectorSpaceBase<double> > rowSpace =
+    byRow ? App->get_p_space(p_index) : App->get_g_space(g_index);
+  const Teuchos::RCP<const tpetra_map> rowMap = tpetraMap(rowSpace);
+  tpetra_dgdp = Teuchos::rcp(new tpetra_multivector(rowMap,
+                                                    byRow ? numResponses : numParameters));
+  model_dgdp = Thyra::createMultiVector(tpetra_dgdp, rowSpace);
+  model_dgdp_deriv = MEB::DerivativeMultiVector<double>(model_dgdp, orientation);
+
+  // Rows of DgDp follow p or g, whichever the orientation puts them on
+  if (rowMap->isDistributed()) {
+    root_dgdp = Teuchos::rcp(new tpetra_multivector(rootMap(rowMap),
+                                                    tpetra_dgdp->getNumVectors()));
+    dgdpImporter = Teuchos::rcp(new tpetra_import(rowMap, root_dgdp->getMap()));
+  }
+}
+
+void TriKota::TpetraDirectApplicInterface::setWarmStart(const double maxDistance, const int maxStates)
+{
+  statePool = AdapterCore::createStatePool(App.get(), maxDistance, maxStates, warmStartApp,
+                                          "Thyra::VectorBase<double>");
+}
+
+bool TriKota::TpetraDirectApplicInterface::lookupCache(bool& computeValues,
+                                                       bool& computeGradients)
+{
+  return core.lookup(xC.values(), numVars, numFns, gradFlag,
+                     fnVals.values(), fnGrads.values(), fnGrads.stride(),
+                     computeValues, computeGradients);
+}
+
+void TriKota::TpetraDirectApplicInterface::storeCache(const bool computedValues,
+                                                      const bool computedGradients)
+{
+  storeEntry(xC.values(), numVars, numFns, fnVals.values(), fnGrads.values(),
+             fnGrads.stride(), computedValues, computedGradients);
+}
+
+void TriKota::TpetraDirectApplicInterface::storeEntry(
+  const double* x, const unsigned int nVars, const unsigned int nFns,
+  const double* vals, const double* grads, const int ldGrads,
+  const bool computedValues, const bool computedGradients)
+{
+  // The journal and the results writer are written by the rank holding the response
+  core.store(x, nVars, nFns, vals, grads, ldGrads, computedValues, computedGradients, rootRank);
+}
+
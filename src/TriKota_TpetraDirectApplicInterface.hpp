@@ -0,0 +1,333 @@
+// @HEADER
+// ************************************************************************
+// 
+//        TriKota: A Trilinos Wrapper for the Dakota Framework
+//                  Copyright (2009) Sandia Corporation
+// 
+// Under the terms of Contract DE-AC04-94AL85000 with Sandia Corporation,
+// the U.S. Government retains certain rights in this software.
+// 
+// This library is free software; you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation; either version 2.1 of the
+// License, or (at your option) any later version.
+//  
+// This library is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301
+// USA
+// 
+// Questions? Contact Andy Salinger (agsalin@sandia.gov), Sandia
+// National Laboratories.
+// 
+// ************************************************************************
+// @HEADER
+
+#ifndef TRIKOTA_TPETRADIRECTAPPLICINTERFACE
+#define TRIKOTA_TPETRADIRECTAPPLICINTERFACE
+
+// Have to do this first to pull in all of Dakota's #define's
+#include "TriKota_ConfigDefs.hpp"
+
+#include "DirectApplicInterface.hpp"
+#include "ProblemDescDB.hpp"
+
+#include "Thyra_ModelEvaluatorDefaultBase.hpp"
+#include "Tpetra_Vector.hpp"
+#include "Tpetra_MultiVector.hpp"
+#include "Tpetra_Import.hpp"
+#include "Kokkos_Core.hpp"
+#include "TriKota_ModelEvaluatorExtensions.hpp"
+#include "TriKota_AdapterCore.hpp"
+#include "TriKota_EvaluationStatistics.hpp"
+
+#include "Teuchos_RCP.hpp"
+#include "Teuchos_Array.hpp"
+#include "Teuchos_Assert.hpp"
+
+#include <vector>
+
+//!  TriKota namespace
+namespace TriKota {
+
+/*! \brief Adapter for a Thyra::ModelEvaluator whose parameter and
+  response spaces are Tpetra spaces (Thyra::TpetraVectorSpace, e.g. a
+  Tpetra model wrapped by Thyra's Tpetra adapters).
+  Unlike TriKota::ThyraDirectApplicInterface it keeps the Tpetra
+  objects behind the Thyra wrappers and reads and writes their host
+  views directly: Dakota's variables go into the locally owned entries
+  of p, and the responses and the whole DgDp block come back with one
+  host synchronization each, instead of a detached view per vector.
+  Distributed g and DgDp rows are imported to analysis rank 0, which
+  returns the response to Dakota; distributed maps must be contiguous.
+  Evaluations are synchronous and Hessians are not supported; see
+  setGradientStaging() for overlapping the sensitivity transfer.
+*/
+class TpetraDirectApplicInterface : public Dakota::DirectApplicInterface,
+                                    public InstrumentedInterface
+{
+public:
+
+  typedef Tpetra::Vector<double> tpetra_vector;
+  typedef Tpetra::MultiVector<double> tpetra_multivector;
+  typedef tpetra_vector::map_type tpetra_map;
+  typedef Tpetra::Import<tpetra_vector::local_ordinal_type,
+                         tpetra_vector::global_ordinal_type,
+                         tpetra_vector::node_type> tpetra_import;
+  typedef tpetra_multivector::execution_space execution_space;
+#ifdef KOKKOS_HAS_SHARED_HOST_PINNED_SPACE
+  typedef Kokkos::SharedHostPinnedSpace staging_space;
+#else
+  typedef Kokkos::HostSpace staging_space;
+#endif
+  typedef Kokkos::View<double**, Kokkos::LayoutLeft, staging_space> staging_view;
+
+  //! Constructor that takes the Model Evaluator to wrap
+  TpetraDirectApplicInterface(
+    Dakota::ProblemDescDB& problem_db_,
+    const Teuchos::RCP<Thyra::ModelEvaluatorDefaultBase<double> > App_,
+    int p_index = 0,
+    int g_index = 0);
+
+  /*! \brief Constructor for the Dakota interface interface_id (the
+    id_interface of its block in the input), for studies over several
+    models run through TriKota::Driver::run(appInterfaces). The adapter
+    reads that interface block and seeds the first model using it; an
+    empty id is the first model of the input. */
+  TpetraDirectApplicInterface(
+    Dakota::ProblemDescDB& problem_db_,
+    const std::string& interface_id,
+    const Teuchos::RCP<Thyra::ModelEvaluatorDefaultBase<double> > App_,
+    int p_index = 0,
+    int g_index = 0);
+
+  ~TpetraDirectApplicInterface() {};
+
+  /*! \brief Use an evaluation cache (may be shared with other adapters).
+    A null cache (the default) turns caching off. */
+  void setEvaluationCache(const Teuchos::RCP<EvaluationCache>& cache)
+    { core.setEvaluationCache(cache); }
+
+  //! Accessor for the evaluation cache, null if none is used
+  Teuchos::RCP<EvaluationCache> getEvaluationCache() const { return core.getEvaluationCache(); }
+
+  /*! \brief Replay the evaluations of earlier runs from a journal and
+    append the new ones to it. A null journal (the default) turns it off.
+    Give every rank of the analysis communicator a journal over the same
+    file; only rank 0 appends. */
+  void setEvaluationJournal(const Teuchos::RCP<EvaluationJournal>& journal)
+    { core.setEvaluationJournal(journal); }
+
+  //! Accessor for the evaluation journal, null if none is used
+  Teuchos::RCP<EvaluationJournal> getEvaluationJournal() const { return core.getEvaluationJournal(); }
+
+  /*! \brief Stream every evaluation computed by the model (variables,
+    values and, if the writer records them, gradients) to a columnar
+    results file. A null writer (the default) turns it off. Only the
+    analysis rank 0 appends, so the other ranks may pass null. */
+  void setResultsWriter(const Teuchos::RCP<ResultsWriter>& writer)
+    { core.setResultsWriter(writer); }
+
+  //! Accessor for the results writer, null if none is used
+  Teuchos::RCP<ResultsWriter> getResultsWriter() const { return core.getResultsWriter(); }
+
+  /*! \brief Relative cost of one adjoint and one forward sensitivity
+    solve, as in TriKota::ThyraDirectApplicInterface::setSensitivityCosts. */
+  void setSensitivityCosts(const double adjointCost, const double forwardCost);
+
+  /*! \brief Bring DgDp to the host through a pinned staging buffer
+    with one asynchronous deep_copy of the whole device block, instead
+    of a synchronizing host view (off by default). In asynchronous mode
+    (\c asynchronous in the dakota input) the values of an evaluation
+    are returned at once and its gradients are only waited for when the
+    next evaluation needs DgDp, or at the end of the queue, so the
+    transfer overlaps with the bookkeeping and parameter load of the
+    next evaluation. Without a device this is a plain host copy. */
+  void setGradientStaging(const bool stage) { stageGradients = stage; }
+
+  //! Orientation of the DgDp requested from the model
+  Thyra::ModelEvaluatorBase::EDerivativeMultiVectorOrientation
+  getSensitivityOrientation() const { return orientation; }
+
+  /*! \brief Warm start the model's nonlinear solves from the state of
+    the nearest earlier evaluation within maxDistance (Euclidean, over
+    Dakota's variables), keeping at most maxStates states. The model
+    must be a TriKota::WarmStartModelEvaluator<Thyra::VectorBase<double>>; maxStates = 0 turns
+    warm starting off (the default). */
+  void setWarmStart(const double maxDistance, const int maxStates = 8);
+
+  //! Pool of warm start states, null if warm starting is off
+  Teuchos::RCP<StatePool<Thyra::VectorBase<double>> > getStatePool() const { return statePool; }
+
+  //! Timers and counters of the evaluations performed so far
+  Teuchos::RCP<EvaluationStatistics> getEvaluationStatistics() const { return evalStats; }
+
+  /*! \brief Gradient evaluations that reused the forward solve of the
+    previous evaluation at the same point (see
+    TriKota::ForwardReuseModelEvaluator) */
+  int numForwardReuses() const { return core.numForwardReuses(); }
+
+protected:
+
+  /*! \brief Virtual function redefinition from Dakota::DirectApplicInterface.
+    An exception thrown by the model's evalModel is returned as a
+    non-zero fail code, so Dakota's failure_capture handles it. */
+  int derived_map_ac(const Dakota::String& ac_name);
+
+  //! Virtual function redefinition from Dakota::DirectApplicInterface
+  int derived_map_of(const Dakota::String& of_name);
+
+  /*! \brief Virtual function redefinition from Dakota::ApplicationInterface.
+    Nothing is launched here: the queued evaluations are performed one
+    after the other in wait_local_evaluations(). */
+  void derived_map_asynch(const Dakota::ParamResponsePair& pair);
+
+  //! Virtual function redefinition from Dakota::ApplicationInterface
+  void wait_local_evaluations(Dakota::PRPQueue& prp_queue);
+
+  //! Virtual function redefinition from Dakota::ApplicationInterface
+  void test_local_evaluations(Dakota::PRPQueue& prp_queue);
+
+private:
+
+  /*! \brief Gradients of an evaluation still being copied to the
+    staging buffer. Every rank records it; only the rank holding DgDp
+    (copying) has a copy in flight. */
+  struct DeferredGradients {
+    bool launched;
+    bool attached;
+    bool copying;
+    Dakota::Response response;
+    std::vector<double> x;
+    std::vector<double> vals;
+    unsigned int numVars;
+    unsigned int numFns;
+    Teuchos::Array<int> activeGrads;
+    bool computedValues;
+    bool allGradients;
+  };
+
+  /*! \brief derived_map_ac, optionally leaving the gradients in flight
+    in the staging buffer (completed by finishDeferredGradients()).
+    Returns the fail code. */
+  int evaluate(const bool deferGradients);
+
+  //! Start the copy of the (root) DgDp into the staging buffer
+  bool launchGradientCopy();
+
+  //! Wait for the deferred gradient copy and unload it into its response
+  void finishDeferredGradients();
+
+  //! Select the outputs of the persistent outArgs for one evaluation
+  void setOutArgs(const bool computeValues, const bool computeGradients);
+
+  //! Copy xC into the locally owned entries of p, through its host view
+  void loadParameters();
+
+  //! Copy the responses into fnVals (on the ranks holding them)
+  void unloadResponses();
+
+  //! Copy the active gradients into fnGrads (on the ranks holding them)
+  void unloadGradients(const Teuchos::ArrayView<const int>& active);
+
+  /*! \brief Copy the column-major sensitivities dgdp_values into the
+    Dakota layout grads, only for the responses in active if it is not empty */
+  void copyGradients(const double* dgdp_values, const int dgdp_lda,
+                     const unsigned int nVars, const unsigned int nFns,
+                     double* grads, const int ldGrads,
+                     const Teuchos::ArrayView<const int>& active) const;
+
+  //! Gather a distributed DgDp to rank 0; returns the rows this rank holds
+  const tpetra_multivector* rootSensitivities();
+
+  //! Map of a Tpetra-backed Thyra space
+  Teuchos::RCP<const tpetra_map>
+  tpetraMap(const Teuchos::RCP<const Thyra::VectorSpaceBase<double> >& space) const;
+
+  //! Map holding all entries of map on rank 0, null if map is not distributed
+  Teuchos::RCP<const tpetra_map> rootMap(const Teuchos::RCP<const tpetra_map>& map) const;
+
+  /*! \brief Pick the DgDp orientation from the costs; storage of the
+    previous orientation is released */
+  void selectOrientation();
+
+  //! Allocate the DgDp storage and its root importer, on the first gradient request
+  void allocateSensitivities();
+
+  /*! \brief Fill fnVals/fnGrads from the evaluation cache (then the
+    journal) and tell what is left to compute. Returns true if nothing is. */
+  bool lookupCache(bool& computeValues, bool& computeGradients);
+
+  //! Store what was just computed into the evaluation cache and journal
+  void storeCache(const bool computedValues, const bool computedGradients);
+
+  //! storeCache() for an evaluation that is no longer in xC/fnVals/fnGrads
+  void storeEntry(const double* x, const unsigned int nVars, const unsigned int nFns,
+                  const double* vals, const double* grads, const int ldGrads,
+                  const bool computedValues, const bool computedGradients);
+
+  // Data
+  Teuchos::RCP<Thyra::ModelEvaluatorDefaultBase<double> > App;
+  int p_index;
+  int g_index;
+
+  // Tpetra storage and the Thyra wrappers handed to the model
+  Teuchos::RCP<tpetra_vector> tpetra_p;
+  Teuchos::RCP<tpetra_vector> tpetra_g;
+  Teuchos::RCP<tpetra_multivector> tpetra_dgdp;
+  Teuchos::RCP<Thyra::VectorBase<double> > model_p;
+  Teuchos::RCP<Thyra::VectorBase<double> > model_g;
+  Teuchos::RCP<Thyra::MultiVectorBase<double> > model_dgdp;
+
+  // This rank owns Dakota variables pOffset..; distributed g and DgDp
+  // rows are imported to analysis rank 0
+  int pOffset;
+  bool rootRank;
+  Teuchos::RCP<tpetra_import> gImporter;
+  Teuchos::RCP<tpetra_vector> root_g;
+  Teuchos::RCP<tpetra_import> dgdpImporter;
+  Teuchos::RCP<tpetra_multivector> root_dgdp;
+
+  // Argument objects built once; only their entries change per evaluation
+  Thyra::ModelEvaluatorBase::InArgs<double> inArgs;
+  Thyra::ModelEvaluatorBase::OutArgs<double> outArgs;
+  Thyra::ModelEvaluatorBase::Derivative<double> model_dgdp_deriv;
+
+  unsigned int numParameters;
+  unsigned int numResponses;
+  bool supportsSensitivities;
+  Thyra::ModelEvaluatorBase::EDerivativeMultiVectorOrientation orientation;
+  Thyra::ModelEvaluatorBase::DerivativeSupport supportDgDp;
+
+  // Gradient requests restricted to Dakota's active set
+  const ActiveSetModelEvaluator* activeSetApp;
+  Teuchos::Array<int> activeGrads;
+
+  // Warm starts from earlier states
+  const WarmStartModelEvaluator<Thyra::VectorBase<double>>* warmStartApp;
+  Teuchos::RCP<StatePool<Thyra::VectorBase<double>> > statePool;
+
+  // Forward solves reused by gradient requests at the same point
+  const ForwardReuseModelEvaluator* forwardReuseApp;
+
+  // Pinned staging of the sensitivities
+  bool stageGradients;
+  staging_view gradStaging;
+  DeferredGradients deferred;
+
+  // DgDp storage follows the orientation, allocated on the first gradient request
+  bool orientationSelected;
+
+  // Cache, journal, results writer, active set and orientation costs
+  AdapterCore core;
+  Teuchos::RCP<EvaluationStatistics> evalStats;
+};
+
+} // namespace TriKota
+
+#endif //TRIKOTA_TPETRADIRECTAPPLICINTERFACE
@@ -29,7 +29,9 @@
 // @HEADER
 
 #include "Thyra_ResponseOnlyModelEvaluatorBase.hpp"
+#include "TriKota_ModelEvaluatorExtensions.hpp"
 #include "Teuchos_Comm.hpp"
+#include "Teuchos_Array.hpp"
 
 // THIS FILE IS A COPY OF OPTIPACK EXAMPLE
 
@@ -170,8 +172,36 @@ public:
 
   //@}
 
+protected:
+
+  /** \brief Local part of the sum in g(p) (before the reduction and the
+   * 0.5 factor) and, if grad is not null, the locally owned entries of
+   * DgDp^T, in one pass over the locally owned entries p of the
+   * parameters.
+   */
+  Scalar evalLocal(const Scalar* p, Scalar* grad) const;
+
+  /** \brief Locally owned entries of lambda * D2gDp2 * v, for the
+   * locally owned entries v of a direction. */
+  void evalLocalHessVec(const Scalar* p, const Scalar& lambda,
+                        const Scalar* v, Scalar* hv) const;
+
+  /** \brief Locally owned dimension of the parameters. */
+  int localDim() const { return localDim_; }
+
+  /** \brief Communicator of the parameter space. */
+  const Teuchos::RCP<const Teuchos::Comm<Thyra::Ordinal> >& comm() const { return comm_; }
+
+  /** \brief g from the reduced sum of evalLocal(). */
+  Scalar responseFromSum(const Scalar& sum) const;
+
 private:
 
+  /** \brief evalLocal() with the branches on the cubic term and on
+   * the gradient resolved at compile time. */
+  template<bool Cubic, bool Gradient>
+  Scalar evalLocalKernel(const Scalar* p, Scalar* grad) const;
+
   /** \name Private functions overridden from ModelEvaulatorDefaultBase. */
   //@{
 
@@ -208,13 +238,68 @@ private:
   Teuchos::RCP<const Thyra::VectorBase<Scalar> > diag_bar_;
   Teuchos::RCP<const Thyra::VectorBase<Scalar> > s_bar_;
 
+  // Contiguous copies of the locally owned entries of ps, diag and
+  // 1/s_bar, read by the evaluation kernel
+  Teuchos::Array<Scalar> ps_local_;
+  Teuchos::Array<Scalar> diag_local_;
+  Teuchos::Array<Scalar> s_bar_inv_local_;
+
+};
+
+
+/** \brief DiagonalROME that also evaluates whole blocks of parameter
+ * columns, as a TriKota::MultiPointModelEvaluator.
+ *
+ * All columns share one pass of the kernel each and a single reduction
+ * of the responses, which is what the batched adapter paths exercise.
+ */
+class DiagonalMultiPointROME
+   : public DiagonalROME<double>,
+     public MultiPointModelEvaluator
+{
+public:
+
+  /** \brief . */
+  DiagonalMultiPointROME(
+    const int localDim,
+    const Teuchos::RCP<const Teuchos::Comm<Thyra::Ordinal> > &comm = Teuchos::null
+    );
+
+  /** \brief Calls to evalMultiPoint() so far. */
+  int numMultiPointCalls() const { return numMultiPointCalls_; }
+
+  /** \brief Columns evaluated by evalMultiPoint() so far. */
+  int numMultiPointColumns() const { return numMultiPointColumns_; }
+
+  /** \brief . */
+  void evalMultiPoint(
+    const int p_index,
+    const int g_index,
+    const Thyra::MultiVectorBase<double>& P,
+    const Teuchos::Ptr<Thyra::MultiVectorBase<double> >& G,
+    const Teuchos::ArrayView<const Teuchos::RCP<Thyra::MultiVectorBase<double> > >& DgDp,
+    const Thyra::ModelEvaluatorBase::EDerivativeMultiVectorOrientation orientation
+    ) const;
+
+private:
+
+  mutable int numMultiPointCalls_;
+  mutable int numMultiPointColumns_;
+
 };
 
 template<class Scalar>
 const Teuchos::RCP<TriKota::DiagonalROME<Scalar> >
 createModel(
   const int globalDim,
-  const typename Teuchos::ScalarTraits<Scalar>::magnitudeType &g_offset
+  const typename Teuchos::ScalarTraits<Scalar>::magnitudeType &g_offset,
+  const Teuchos::RCP<const Teuchos::Comm<Thyra::Ordinal> > &comm = Teuchos::null
+  );
+
+const Teuchos::RCP<TriKota::DiagonalMultiPointROME>
+createMultiPointModel(
+  const int globalDim,
+  const double g_offset
   );
 
 } // namespace TriKota
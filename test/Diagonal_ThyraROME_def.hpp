@@ -32,6 +32,7 @@
 #include "Thyra_VectorStdOps.hpp"
 #include "Thyra_DefaultSpmdVectorSpace.hpp"
 #include "Thyra_DetachedSpmdVectorView.hpp"
+#include "Thyra_DetachedMultiVectorView.hpp"
 #include "Teuchos_DefaultComm.hpp"
 #include "Teuchos_CommHelpers.hpp"
 #include "Teuchos_Assert.hpp"
@@ -40,6 +41,37 @@
 namespace TriKota {
 
 
+namespace {
+
+// Contiguous copy of the locally owned entries of v
+template<class Scalar>
+void copyLocalEntries(const Teuchos::RCP<const Thyra::VectorBase<Scalar> >& v,
+                      Teuchos::Array<Scalar>& local)
+{
+  const Thyra::ConstDetachedSpmdVectorView<Scalar> v_local(v);
+  local.resize(v_local.subDim());
+  for (Thyra::Ordinal i = 0; i < v_local.subDim(); ++i) local[i] = v_local[i];
+}
+
+// Local dimension of a model of globalDim parameters over the ranks of comm
+int diagonalLocalDim(const int globalDim,
+                     const Teuchos::RCP<const Teuchos::Comm<Thyra::Ordinal> > &comm)
+{
+  const int numProcs = comm->getSize();
+  TEUCHOS_TEST_FOR_EXCEPT_MSG( numProcs > globalDim,
+    "Error, the number of processors can not be greater than the global"
+    " dimension of the vectors!." );
+  const int localDim = globalDim / numProcs;
+  const int localDimRemainder = globalDim % numProcs;
+  TEUCHOS_TEST_FOR_EXCEPT_MSG( localDimRemainder != 0,
+    "Error, the number of processors must divide into the global number"
+    " of elements exactly for now!." );
+  return localDim;
+}
+
+} // namespace
+
+
 //
 // DiagonalROME
 //
@@ -93,6 +125,10 @@ DiagonalROME<Scalar>::DiagonalROME(
   // Default response offset
   g_offset_ = ST::zero();
 
+  ps_local_.assign(localDim_, ST::zero());
+  diag_local_.assign(localDim_, ST::one());
+  s_bar_inv_local_.assign(localDim_, ST::one());
+
 }
 
 
@@ -101,6 +137,7 @@ void DiagonalROME<Scalar>::setSolutionVector(
   const RCP<const Thyra::VectorBase<Scalar> > &ps)
 {
   ps_ = ps.assert_not_null();
+  copyLocalEntries<Scalar>(ps_, ps_local_);
 }
 
 
@@ -118,6 +155,7 @@ void DiagonalROME<Scalar>::setDiagonalVector(
 {
   diag_ = diag;
   diag_bar_ = diag;
+  copyLocalEntries<Scalar>(diag_, diag_local_);
 }
 
 
@@ -142,6 +180,11 @@ void DiagonalROME<Scalar>::setDiagonalBarVector(
   V_S( s_bar.ptr(), ST::zero() );
   ele_wise_divide( ST::one(), *diag_, *diag_bar_, s_bar.ptr() );
   s_bar_ = s_bar;
+
+  // The kernel multiplies by the inverse instead of dividing
+  copyLocalEntries<Scalar>(s_bar_, s_bar_inv_local_);
+  for (int i = 0; i < s_bar_inv_local_.size(); ++i)
+    s_bar_inv_local_[i] = ST::one() / s_bar_inv_local_[i];
   
   const RCP<Thyra::ScalarProdVectorSpaceBase<Scalar> > sp_p_space =
     rcp_dynamic_cast<Thyra::ScalarProdVectorSpaceBase<Scalar> >(p_space_, true);
@@ -243,6 +286,7 @@ DiagonalROME<Scalar>::createOutArgsImpl() const
   outArgs.setModelEvalDescription(this->description());
   outArgs.set_Np_Ng(Np_,Ng_);
   outArgs.setSupports(MEB::OUT_ARG_DgDp, 0 ,0, MEB::DERIV_TRANS_MV_BY_ROW);
+  outArgs.setSupports(MEB::OUT_ARG_hess_vec_prod_g_pp, 0, 0, 0, true);
   return outArgs;
 }
 
@@ -254,81 +298,199 @@ void DiagonalROME<Scalar>::evalModelImpl(
   ) const
 {
 
-  using Teuchos::as;
   using Teuchos::outArg;
-  typedef Teuchos::ScalarTraits<Scalar> ST;
   using Thyra::get_mv;
   using Thyra::ConstDetachedSpmdVectorView;
   using Thyra::DetachedSpmdVectorView;
   typedef Thyra::Ordinal Ordinal;
   typedef Thyra::ModelEvaluatorBase MEB;
-  typedef MEB::DerivativeMultiVector<Scalar> DMV;
+
+  const RCP<Thyra::MultiVectorBase<Scalar> > hess_vec = outArgs.get_hess_vec_prod_g_pp(0,0,0);
+  if (is_null(outArgs.get_g(0)) && outArgs.get_DgDp(0,0).isEmpty() && is_null(hess_vec))
+    return;
 
   const ConstDetachedSpmdVectorView<Scalar> p(inArgs.get_p(0));
-  const ConstDetachedSpmdVectorView<Scalar> ps(ps_);
-  const ConstDetachedSpmdVectorView<Scalar> diag(diag_);
-  const ConstDetachedSpmdVectorView<Scalar> s_bar(s_bar_);
+
+  // Products of the (diagonal) Hessian with the columns of p_direction,
+  // scaled by the multiplier of g
+  if (!is_null(hess_vec)) {
+    const RCP<const Thyra::MultiVectorBase<Scalar> > dir = inArgs.get_p_direction(0);
+    TEUCHOS_TEST_FOR_EXCEPT_MSG( is_null(dir),
+      "Error, DiagonalROME needs p_direction for the Hessian-vector products!" );
+    const RCP<const Thyra::VectorBase<Scalar> > mult = inArgs.get_g_multiplier(0);
+    const Scalar lambda = is_null(mult) ? Teuchos::ScalarTraits<Scalar>::one() :
+      ConstDetachedSpmdVectorView<Scalar>(mult)[0];
+    for (Ordinal j = 0; j < dir->domain()->dim(); ++j) {
+      const ConstDetachedSpmdVectorView<Scalar> v(dir->col(j));
+      const DetachedSpmdVectorView<Scalar> hv(hess_vec->col(j));
+      evalLocalHessVec(p.values().get(), lambda, v.values().get(), hv.values().get());
+    }
+  }
+  if (is_null(outArgs.get_g(0)) && outArgs.get_DgDp(0,0).isEmpty()) return;
+
+  // g and DgDp^T come out of the same pass over p
+  Teuchos::RCP<DetachedSpmdVectorView<Scalar> > DgDp_grad;
+  if (!outArgs.get_DgDp(0,0).isEmpty()) {
+    const RCP<Thyra::MultiVectorBase<Scalar> > DgDp_trans_mv =
+      get_mv<Scalar>(outArgs.get_DgDp(0,0), "DgDp^T", MEB::DERIV_TRANS_MV_BY_ROW);
+    DgDp_grad = rcp(new DetachedSpmdVectorView<Scalar>(DgDp_trans_mv->col(0)));
+  }
+
+  const Scalar g_val = evalLocal(p.values().get(),
+    is_null(DgDp_grad) ? 0 : DgDp_grad->values().get());
 
   // g(p)
   if (!is_null(outArgs.get_g(0))) {
-    Scalar g_val = ST::zero();
-    for (Ordinal i = 0; i < p.subDim(); ++i) {
-      const Scalar p_ps = p[i] - ps[i];
-      g_val += diag[i] * p_ps*p_ps;
-      if (nonlinearTermFactor_ != ST::zero()) {
-        g_val += nonlinearTermFactor_ * p_ps * p_ps * p_ps;
-      }
-    }
     Scalar global_g_val;
     Teuchos::reduceAll<Ordinal, Scalar>(*comm_, Teuchos::REDUCE_SUM, 
       g_val, outArg(global_g_val) );
-    DetachedSpmdVectorView<Scalar>(outArgs.get_g(0))[0] =
-      as<Scalar>(0.5) * global_g_val + g_offset_;
+    DetachedSpmdVectorView<Scalar>(outArgs.get_g(0))[0] = responseFromSum(global_g_val);
   }
+  
+}
 
-  // DgDp[i]
-  if (!outArgs.get_DgDp(0,0).isEmpty()) {
-    const RCP<Thyra::MultiVectorBase<Scalar> > DgDp_trans_mv =
-      get_mv<Scalar>(outArgs.get_DgDp(0,0), "DgDp^T", MEB::DERIV_TRANS_MV_BY_ROW);
-    const DetachedSpmdVectorView<Scalar> DgDp_grad(DgDp_trans_mv->col(0));
-    for (Thyra::Ordinal i = 0; i < p.subDim(); ++i) {
-      const Scalar p_ps = p[i] - ps[i];
-      Scalar DgDp_grad_i = diag[i] * p_ps;
-      if (nonlinearTermFactor_ != ST::zero()) {
-        DgDp_grad_i += as<Scalar>(1.5) * nonlinearTermFactor_ * p_ps * p_ps;
-      }
-      DgDp_grad[i] = DgDp_grad_i / s_bar[i];
 
+template<class Scalar>
+Scalar DiagonalROME<Scalar>::evalLocal(const Scalar* p, Scalar* grad) const
+{
+  typedef Teuchos::ScalarTraits<Scalar> ST;
+  if (nonlinearTermFactor_ == ST::zero())
+    return (grad != 0) ? evalLocalKernel<false,true>(p, grad) : evalLocalKernel<false,false>(p, grad);
+  else
+    return (grad != 0) ? evalLocalKernel<true,true>(p, grad) : evalLocalKernel<true,false>(p, grad);
+}
+
+
+template<class Scalar>
+template<bool Cubic, bool Gradient>
+Scalar DiagonalROME<Scalar>::evalLocalKernel(const Scalar* p, Scalar* grad) const
+{
+  typedef Teuchos::ScalarTraits<Scalar> ST;
+  const int n = localDim_;
+  const Scalar* ps = ps_local_.getRawPtr();
+  const Scalar* diag = diag_local_.getRawPtr();
+  const Scalar* s_bar_inv = s_bar_inv_local_.getRawPtr();
+  const Scalar c = nonlinearTermFactor_;
+  const Scalar c_grad = Teuchos::as<Scalar>(1.5) * nonlinearTermFactor_;
+
+  // g_i = (diag[i] + c*p_ps) * p_ps^2 and
+  // DgDp_i = (diag[i] + 1.5*c*p_ps) * p_ps / s_bar[i];
+  // four independent partial sums let the reduction vectorize
+  Scalar sum[4] = { ST::zero(), ST::zero(), ST::zero(), ST::zero() };
+  int i = 0;
+  for ( ; i + 4 <= n; i += 4) {
+    for (int k = 0; k < 4; ++k) {
+      const Scalar p_ps = p[i+k] - ps[i+k];
+      sum[k] += (Cubic ? diag[i+k] + c * p_ps : diag[i+k]) * p_ps * p_ps;
+      if (Gradient)
+        grad[i+k] = (Cubic ? diag[i+k] + c_grad * p_ps : diag[i+k]) * p_ps * s_bar_inv[i+k];
     }
   }
-  
+  for ( ; i < n; ++i) {
+    const Scalar p_ps = p[i] - ps[i];
+    sum[0] += (Cubic ? diag[i] + c * p_ps : diag[i]) * p_ps * p_ps;
+    if (Gradient)
+      grad[i] = (Cubic ? diag[i] + c_grad * p_ps : diag[i]) * p_ps * s_bar_inv[i];
+  }
+  return (sum[0] + sum[1]) + (sum[2] + sum[3]);
+}
+
+
+template<class Scalar>
+void DiagonalROME<Scalar>::evalLocalHessVec(const Scalar* p, const Scalar& lambda,
+                                            const Scalar* v, Scalar* hv) const
+{
+  // D2gDp2_ii = (diag[i] + 3*c*p_ps) / s_bar[i]
+  const Scalar c_hess = Teuchos::as<Scalar>(3.0) * nonlinearTermFactor_;
+  for (int i = 0; i < localDim_; ++i) {
+    const Scalar p_ps = p[i] - ps_local_[i];
+    hv[i] = lambda * (diag_local_[i] + c_hess * p_ps) * s_bar_inv_local_[i] * v[i];
+  }
 }
 
+
+template<class Scalar>
+Scalar DiagonalROME<Scalar>::responseFromSum(const Scalar& sum) const
+{
+  return Teuchos::as<Scalar>(0.5) * sum + g_offset_;
+}
+
+
+//
+// DiagonalMultiPointROME
+//
+
+
+inline
+DiagonalMultiPointROME::DiagonalMultiPointROME(
+  const int localDim,
+  const RCP<const Teuchos::Comm<Thyra::Ordinal> > &comm
+  )
+  :DiagonalROME<double>(localDim, comm),
+   numMultiPointCalls_(0), numMultiPointColumns_(0)
+{}
+
+
+inline
+void DiagonalMultiPointROME::evalMultiPoint(
+  const int p_index,
+  const int g_index,
+  const Thyra::MultiVectorBase<double>& P,
+  const Teuchos::Ptr<Thyra::MultiVectorBase<double> >& G,
+  const Teuchos::ArrayView<const Teuchos::RCP<Thyra::MultiVectorBase<double> > >& DgDp,
+  const Thyra::ModelEvaluatorBase::EDerivativeMultiVectorOrientation orientation
+  ) const
+{
+  using Thyra::ConstDetachedSpmdVectorView;
+  using Thyra::DetachedSpmdVectorView;
+  typedef Thyra::Ordinal Ordinal;
+
+  TEUCHOS_ASSERT( p_index == 0 && g_index == 0 );
+  const int numPoints = P.domain()->dim();
+  numMultiPointCalls_++;
+  numMultiPointColumns_ += numPoints;
+
+  Teuchos::Array<double> local_g(numPoints), global_g(numPoints);
+  for (int j = 0; j < numPoints; ++j) {
+    const ConstDetachedSpmdVectorView<double> p(P.col(j));
+    Teuchos::RCP<DetachedSpmdVectorView<double> > DgDp_grad;
+    if (j < DgDp.size() && !is_null(DgDp[j])) {
+      TEUCHOS_TEST_FOR_EXCEPT_MSG(
+        orientation != Thyra::ModelEvaluatorBase::DERIV_TRANS_MV_BY_ROW,
+        "Error, DiagonalMultiPointROME only computes DgDp as DERIV_TRANS_MV_BY_ROW!" );
+      DgDp_grad = rcp(new DetachedSpmdVectorView<double>(DgDp[j]->col(0)));
+    }
+    local_g[j] = evalLocal(p.values().get(),
+      is_null(DgDp_grad) ? 0 : DgDp_grad->values().get());
+  }
+
+  // One reduction for the whole block
+  if (!is_null(G) && numPoints > 0) {
+    Teuchos::reduceAll<Ordinal, double>(*comm(), Teuchos::REDUCE_SUM, numPoints,
+      local_g.getRawPtr(), global_g.getRawPtr() );
+    Thyra::DetachedMultiVectorView<double> G_view(*G);
+    for (int j = 0; j < numPoints; ++j) G_view(0,j) = responseFromSum(global_g[j]);
+  }
+}
+
+
 // External constructor
 template<class Scalar>
 const Teuchos::RCP<TriKota::DiagonalROME<Scalar> >
 createModel(
   const int globalDim,
-  const typename Teuchos::ScalarTraits<Scalar>::magnitudeType &g_offset
+  const typename Teuchos::ScalarTraits<Scalar>::magnitudeType &g_offset,
+  const Teuchos::RCP<const Teuchos::Comm<Thyra::Ordinal> > &comm_
   )
 {
   using Teuchos::RCP;
 
-  const RCP<const Teuchos::Comm<Thyra::Ordinal> > comm =
-    Teuchos::DefaultComm<Thyra::Ordinal>::getComm();
-
-  const int numProcs = comm->getSize();
-  TEUCHOS_TEST_FOR_EXCEPT_MSG( numProcs > globalDim,
-    "Error, the number of processors can not be greater than the global"
-    " dimension of the vectors!." );
-  const int localDim = globalDim / numProcs;
-  const int localDimRemainder = globalDim % numProcs;
-  TEUCHOS_TEST_FOR_EXCEPT_MSG( localDimRemainder != 0,
-    "Error, the number of processors must divide into the global number"
-    " of elements exactly for now!." );
+  const RCP<const Teuchos::Comm<Thyra::Ordinal> > comm = is_null(comm_) ?
+    Teuchos::DefaultComm<Thyra::Ordinal>::getComm() : comm_;
+  const int localDim = diagonalLocalDim(globalDim, comm);
 
   const RCP<TriKota::DiagonalROME<Scalar> > model =
-    Teuchos::rcp(new TriKota::DiagonalROME<Scalar>(localDim));
+    Teuchos::rcp(new TriKota::DiagonalROME<Scalar>(localDim, comm));
   const RCP<const Thyra::VectorSpaceBase<Scalar> > p_space = model->get_p_space(0);
   const RCP<Thyra::VectorBase<Scalar> > ps = createMember(p_space);
   const Scalar ps_val = 2.0;
@@ -340,5 +502,30 @@ createModel(
 }
 
 
+inline
+const Teuchos::RCP<TriKota::DiagonalMultiPointROME>
+createMultiPointModel(
+  const int globalDim,
+  const double g_offset
+  )
+{
+  using Teuchos::RCP;
+
+  const RCP<const Teuchos::Comm<Thyra::Ordinal> > comm =
+    Teuchos::DefaultComm<Thyra::Ordinal>::getComm();
+  const int localDim = diagonalLocalDim(globalDim, comm);
+
+  const RCP<TriKota::DiagonalMultiPointROME> model =
+    Teuchos::rcp(new TriKota::DiagonalMultiPointROME(localDim));
+  const RCP<const Thyra::VectorSpaceBase<double> > p_space = model->get_p_space(0);
+  const RCP<Thyra::VectorBase<double> > ps = createMember(p_space);
+  Thyra::V_S(ps.ptr(), 2.0);
+  model->setSolutionVector(ps);
+  model->setScalarOffset(g_offset);
+
+  return model;
+}
+
+
 }
 
@@ -0,0 +1,311 @@
+// @HEADER
+// ************************************************************************
+// 
+//        TriKota: A Trilinos Wrapper for the Dakota Framework
+//                  Copyright (2009) Sandia Corporation
+// 
+// Under the terms of Contract DE-AC04-94AL85000 with Sandia Corporation,
+// the U.S. Government retains certain rights in this software.
+// 
+// This library is free software; you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation; either version 2.1 of the
+// License, or (at your option) any later version.
+//  
+// This library is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301
+// USA
+// 
+// Questions? Contact Andy Salinger (agsalin@sandia.gov), Sandia
+// National Laboratories.
+// 
+// ************************************************************************
+// @HEADER
+
+#include "TriKota_Driver.hpp"
+#include "TriKota_ThyraDirectApplicInterface.hpp"
+#include "TriKota_ModelEvaluatorExtensions.hpp"
+#include "TriKota_EvaluationCache.hpp"
+
+#include "Thyra_ResponseOnlyModelEvaluatorBase.hpp"
+#include "Thyra_DefaultSpmdVectorSpace.hpp"
+#include "Thyra_DetachedSpmdVectorView.hpp"
+#include "Thyra_VectorStdOps.hpp"
+
+#include "Teuchos_GlobalMPISession.hpp"
+#include "Teuchos_StandardCatchMacros.hpp"
+#include "Teuchos_VerboseObject.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <sstream>
+#include <vector>
+
+// Per-response gradient requests: a parameter study of a model with two
+// responses asks for the gradient of the first one only (mixed
+// gradients, the second one by Dakota's finite differences) and then for
+// both. Along the one-at-a-time and the threaded path, the model must
+// compute the DgDp columns asked for, and a partial gradient must never
+// be served from the cache to a later request for all of them. A study
+// that only reads the first response gets all of its gradients, which
+// are cached, while the model is told to skip the second one.
+
+namespace {
+
+
+typedef Thyra::ModelEvaluatorBase MEB;
+
+
+/* g_j(p) = 0.5 * sum( (p[i] - j - 2)^2 ), j = 0,1, counting the DgDp
+   columns it computes; only the active ones if it is given an active set */
+class TwoResponseROME : public Thyra::ResponseOnlyModelEvaluatorBase<double>,
+                        public TriKota::ActiveSetModelEvaluator
+{
+public:
+
+  TwoResponseROME(const int num_p)
+    : p_space(Thyra::defaultSpmdVectorSpace<double>(num_p)),
+      g_space(Thyra::defaultSpmdVectorSpace<double>(2))
+    { for (int j=0; j<2; j++) columns[j] = 0; }
+
+  int Np() const { return 1; }
+  int Ng() const { return 1; }
+  Teuchos::RCP<const Thyra::VectorSpaceBase<double> > get_p_space(int l) const { return p_space; }
+  Teuchos::RCP<const Thyra::VectorSpaceBase<double> > get_g_space(int j) const { return g_space; }
+
+  MEB::InArgs<double> getNominalValues() const
+    {
+      MEB::InArgs<double> nominal = createInArgs();
+      const Teuchos::RCP<Thyra::VectorBase<double> > p = Thyra::createMember(p_space);
+      Thyra::V_S(p.ptr(), 0.0);
+      nominal.set_p(0, p);
+      return nominal;
+    }
+
+  MEB::InArgs<double> createInArgs() const
+    {
+      MEB::InArgsSetup<double> inArgs;
+      inArgs.setModelEvalDescription(this->description());
+      inArgs.set_Np(1);
+      return inArgs;
+    }
+
+  void setActiveGradients(const int g_index, const Teuchos::ArrayView<const int>& responses) const
+    { active.assign(responses.begin(), responses.end()); }
+
+  //! Active set of the last setActiveGradients call
+  const Teuchos::Array<int>& activeGradients() const { return active; }
+
+  //! DgDp columns of response j computed so far
+  int numColumns(const int j) const { return columns[j]; }
+
+private:
+
+  MEB::OutArgs<double> createOutArgsImpl() const
+    {
+      MEB::OutArgsSetup<double> outArgs;
+      outArgs.setModelEvalDescription(this->description());
+      outArgs.set_Np_Ng(1, 1);
+      outArgs.setSupports(MEB::OUT_ARG_DgDp, 0, 0, MEB::DERIV_TRANS_MV_BY_ROW);
+      return outArgs;
+    }
+
+  void evalModelImpl(const MEB::InArgs<double>& inArgs,
+                     const MEB::OutArgs<double>& outArgs) const
+    {
+      const Thyra::ConstDetachedSpmdVectorView<double> p(inArgs.get_p(0));
+      const Thyra::Ordinal n = p.subDim();
+
+      if (!is_null(outArgs.get_g(0))) {
+        const Thyra::DetachedSpmdVectorView<double> g(outArgs.get_g(0));
+        for (int j=0; j<2; j++) {
+          g[j] = 0.0;
+          for (Thyra::Ordinal i=0; i<n; i++) g[j] += 0.5*(p[i] - j - 2.0)*(p[i] - j - 2.0);
+        }
+      }
+
+      if (!outArgs.get_DgDp(0,0).isEmpty()) {
+        const Teuchos::RCP<Thyra::MultiVectorBase<double> > DgDp_trans =
+          Thyra::get_mv<double>(outArgs.get_DgDp(0,0), "DgDp^T", MEB::DERIV_TRANS_MV_BY_ROW);
+        for (int j=0; j<2; j++) {
+          if (active.size() > 0 && std::find(active.begin(), active.end(), j) == active.end())
+            continue;
+          const Thyra::DetachedSpmdVectorView<double> grad(DgDp_trans->col(j));
+          for (Thyra::Ordinal i=0; i<n; i++) grad[i] = p[i] - j - 2.0;
+          columns[j]++;
+        }
+      }
+    }
+
+  const Teuchos::RCP<const Thyra::VectorSpaceBase<double> > p_space;
+  const Teuchos::RCP<const Thyra::VectorSpaceBase<double> > g_space;
+  mutable Teuchos::Array<int> active;
+  mutable std::atomic<int> columns[2];
+
+};
+
+
+const int num_p = 3;
+const int num_points = 4;
+
+
+// List parameter study of num_points points over the first num_fns
+// responses, gradients of all of them analytic or only of the first one
+// (mixed)
+std::string dakotaInput(const bool mixed, const bool threaded, const int num_fns)
+{
+  std::ostringstream in;
+  in << "method,\n"
+     << "  list_parameter_study\n"
+     << "    list_of_points =";
+  for (int k=0; k<num_points; k++)
+    for (int i=0; i<num_p; i++) in << " " << 0.5*k + 0.25*i;
+  in << "\n"
+     << "variables,\n"
+     << "  continuous_design = " << num_p << "\n"
+     << "interface,\n"
+     << "  direct\n"
+     << "    analysis_driver = 'XOM_Dakota'\n";
+  if (threaded)
+    in << "  asynchronous\n"
+       << "    evaluation_concurrency = " << num_points << "\n";
+  in << "responses,\n"
+     << "  response_functions = " << num_fns << "\n";
+  if (mixed)
+    in << "  mixed_gradients\n"
+       << "    id_numerical_gradients = 2\n"
+       << "    id_analytic_gradients = 1\n"
+       << "    method_source dakota\n"
+       << "    interval_type forward\n"
+       << "    fd_step_size = 1.0e-6\n";
+  else
+    in << "  analytic_gradients\n";
+  in << "  no_hessians\n";
+  return in.str();
+}
+
+
+// Run one study; the DgDp columns computed per response are added to columns
+void runStudy(const bool mixed, const bool threaded,
+              const Teuchos::RCP<TwoResponseROME>& model,
+              const Teuchos::RCP<TriKota::EvaluationCache>& cache,
+              int columns[2], const int num_fns = 2)
+{
+  Teuchos::ParameterList options;
+  options.set("Input String", dakotaInput(mixed, threaded, num_fns));
+  TriKota::Driver dakota(options);
+  dakota.setSummarizeStatistics(false);
+
+  Teuchos::RCP<TriKota::ThyraDirectApplicInterface> trikota_interface =
+    Teuchos::rcp(new TriKota::ThyraDirectApplicInterface(dakota.getProblemDescDB(), model), false);
+  trikota_interface->setEvaluationCache(cache);
+  if (threaded) trikota_interface->setEvaluationThreads(-1);
+
+  const int before[2] = { model->numColumns(0), model->numColumns(1) };
+  dakota.run(trikota_interface.get());
+  for (int j=0; j<2; j++) columns[j] = model->numColumns(j) - before[j];
+}
+
+
+bool checkColumns(const std::string& label, const int columns[2],
+                  const int expected0, const int expected1, std::ostream& out)
+{
+  out << label << ": DgDp columns computed " << columns[0] << ", " << columns[1]
+      << " (expected " << expected0 << ", " << expected1 << ")\n";
+  return columns[0] == expected0 && columns[1] == expected1;
+}
+
+
+} // namespace
+
+
+
+int main(int argc, char* argv[])
+{
+
+  using Teuchos::RCP;
+  using Teuchos::rcp;
+  using Teuchos::FancyOStream;
+  using Teuchos::VerboseObjectBase;
+
+  bool success = true;
+
+  Teuchos::GlobalMPISession mpiSession(&argc,&argv);
+
+  const RCP<FancyOStream>
+    out = VerboseObjectBase::getDefaultOStream();
+
+  try {
+
+    for (int t=0; t<2; t++) {
+      const bool threaded = (t == 1);
+      const std::string path = threaded ? "threaded" : "one at a time";
+      const RCP<TwoResponseROME> model = rcp(new TwoResponseROME(num_p));
+      const RCP<TriKota::EvaluationCache> cache = rcp(new TriKota::EvaluationCache);
+      int columns[2];
+
+      // Only the first gradient: the one-at-a-time path tells the model,
+      // the threads share it and compute both
+      runStudy(true, threaded, model, cache, columns);
+      if (!checkColumns(path + ", first gradient only", columns,
+                        num_points, threaded ? num_points : 0, *out))
+        success = false;
+      if (model->activeGradients().size() != (threaded ? 0 : 1)) {
+        *out << "Error: the model was given " << model->activeGradients().size()
+             << " active responses\n";
+        success = false;
+      }
+
+      // All gradients at the same points: the partial ones are not cached
+      runStudy(false, threaded, model, cache, columns);
+      if (!checkColumns(path + ", all gradients", columns, num_points, num_points, *out))
+        success = false;
+      if (model->activeGradients().size() != 0) {
+        *out << "Error: the model was given " << model->activeGradients().size()
+             << " active responses for all gradients\n";
+        success = false;
+      }
+
+      // Again: now everything comes from the cache
+      runStudy(false, threaded, model, cache, columns);
+      if (!checkColumns(path + ", all gradients again", columns, 0, 0, *out))
+        success = false;
+
+      // Only the first response is read: its gradients are all Dakota
+      // asks for, so they are cached, and the model still only needs to
+      // compute the first column
+      const RCP<TriKota::EvaluationCache> firstCache = rcp(new TriKota::EvaluationCache);
+      runStudy(false, threaded, model, firstCache, columns, 1);
+      if (!checkColumns(path + ", first response", columns,
+                        num_points, threaded ? num_points : 0, *out))
+        success = false;
+      if (model->activeGradients().size() != (threaded ? 0 : 1)) {
+        *out << "Error: the model was given " << model->activeGradients().size()
+             << " active responses for the first response\n";
+        success = false;
+      }
+      runStudy(false, threaded, model, firstCache, columns, 1);
+      if (!checkColumns(path + ", first response again", columns, 0, 0, *out))
+        success = false;
+    }
+
+    *out << std::flush;
+
+  }
+  TEUCHOS_STANDARD_CATCH_STATEMENTS(true, std::cerr, success);
+
+  if(success)
+    *out << "\nEnd Result: TEST PASSED\n";
+  else
+    *out << "\nEnd Result: TEST FAILED\n";
+    
+  return ( success ? 0 : 1 );
+
+
+}
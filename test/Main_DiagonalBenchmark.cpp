@@ -0,0 +1,267 @@
+// @HEADER
+// ************************************************************************
+// 
+//        TriKota: A Trilinos Wrapper for the Dakota Framework
+//                  Copyright (2009) Sandia Corporation
+// 
+// Under the terms of Contract DE-AC04-94AL85000 with Sandia Corporation,
+// the U.S. Government retains certain rights in this software.
+// 
+// This library is free software; you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation; either version 2.1 of the
+// License, or (at your option) any later version.
+//  
+// This library is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301
+// USA
+// 
+// Questions? Contact Andy Salinger (agsalin@sandia.gov), Sandia
+// National Laboratories.
+// 
+// ************************************************************************
+// @HEADER
+
+#include "Diagonal_ThyraROME_def.hpp"
+
+#include "TriKota_Driver.hpp"
+#include "TriKota_ThyraDirectApplicInterface.hpp"
+#include "TriKota_ResultsWriter.hpp"
+
+#include "Teuchos_GlobalMPISession.hpp"
+#include "Teuchos_CommandLineProcessor.hpp"
+#include "Teuchos_DefaultComm.hpp"
+#include "Teuchos_CommHelpers.hpp"
+#include "Teuchos_StandardCatchMacros.hpp"
+#include "Teuchos_VerboseObject.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+
+// Benchmark of the adapter overhead: for each number of parameters and
+// each method, the time spent copying data between Dakota and the
+// DiagonalROME model is compared with the time spent in evalModel.
+// The MPI sizes are swept by running the executable on several ranks.
+
+namespace {
+
+
+typedef TriKota::EvaluationStatistics ES;
+
+
+Teuchos::Array<std::string> splitList(const std::string& list)
+{
+  Teuchos::Array<std::string> items;
+  std::istringstream in(list);
+  std::string item;
+  while (std::getline(in, item, ',')) if (!item.empty()) items.push_back(item);
+  return items;
+}
+
+
+// Dakota input for a gradient based optimization or a sampling study
+std::string dakotaInput(const std::string& method, const int num_p,
+                        const int num_iterations, const int concurrency)
+{
+  std::ostringstream in;
+  in << "method,\n";
+  if (method == "sampling") {
+    in << "  sampling\n"
+       << "    samples = " << num_iterations << "\n"
+       << "    seed = 1234\n"
+       << "variables,\n"
+       << "  uniform_uncertain = " << num_p << "\n"
+       << "    lower_bounds = " << num_p << "*-5.0\n"
+       << "    upper_bounds = " << num_p << "*5.0\n";
+  }
+  else {
+    in << "  conmin_frcg\n"
+       << "    max_iterations = " << num_iterations << "\n"
+       << "    convergence_tolerance = 1.0e-12\n"
+       << "variables,\n"
+       << "  continuous_design = " << num_p << "\n";
+  }
+  in << "interface,\n"
+     << "  direct\n"
+     << "    analysis_driver = 'XOM_Dakota'\n";
+  if (concurrency > 1)
+    in << "  asynchronous\n"
+       << "    evaluation_concurrency = " << concurrency << "\n";
+  in << "responses,\n"
+     << "  num_objective_functions = 1\n";
+  if (method == "sampling") in << "  no_gradients\n";
+  else                      in << "  analytic_gradients\n";
+  in << "  no_hessians\n";
+  return in.str();
+}
+
+
+} // namespace
+
+
+
+int main(int argc, char* argv[])
+{
+
+  using Teuchos::RCP;
+  using Teuchos::rcp;
+  using Teuchos::FancyOStream;
+  using Teuchos::VerboseObjectBase;
+
+  bool success = true;
+
+  Teuchos::GlobalMPISession mpiSession(&argc,&argv);
+
+  const RCP<FancyOStream>
+    out = VerboseObjectBase::getDefaultOStream();
+
+  try {
+
+    std::string num_p_list = "10,1000,100000,1000000";
+    std::string method_list = "gradient,sampling";
+    int num_iterations = 20;
+    double max_overhead_ratio = 0.0;
+    int concurrency = 1;
+    bool multi_point = false;
+    bool write_results = false;
+
+    Teuchos::CommandLineProcessor clp;
+    clp.throwExceptions(false);
+    clp.addOutputSetupOptions(true);
+    clp.setOption("num-p", &num_p_list,
+      "Comma separated numbers of parameters to sweep");
+    clp.setOption("methods", &method_list,
+      "Comma separated methods to run: gradient (conmin_frcg) and/or sampling");
+    clp.setOption("iterations", &num_iterations,
+      "Optimizer iterations or number of samples");
+    clp.setOption("concurrency", &concurrency,
+      "Dakota evaluation concurrency; above 1 the queued evaluations reach the adapter as batches");
+    clp.setOption("multi-point", "single-point", &multi_point,
+      "Evaluate batches with one DiagonalMultiPointROME::evalMultiPoint call");
+    clp.setOption("results", "no-results", &write_results,
+      "Stream the evaluations to a TriKota::ResultsWriter file and check it on every rank");
+    clp.setOption("max-overhead-ratio", &max_overhead_ratio,
+      "Fail if the adapter copy time exceeds this multiple of the evalModel time (0: no check)");
+    const Teuchos::CommandLineProcessor::EParseCommandLineReturn
+      parse_return = clp.parse(argc,argv);
+    if (parse_return != Teuchos::CommandLineProcessor::PARSE_SUCCESSFUL)
+      return parse_return;
+
+    const RCP<const Teuchos::Comm<int> > comm = Teuchos::DefaultComm<int>::getComm();
+    const int numProcs = comm->getSize();
+
+    const Teuchos::Array<std::string> methods = splitList(method_list);
+    const Teuchos::Array<std::string> sizes = splitList(num_p_list);
+
+    std::ostringstream table;
+    table << std::setw(10) << "method" << std::setw(10) << "num_p" << std::setw(7) << "procs"
+          << std::setw(8) << "evals" << std::setw(14) << "evalModel" << std::setw(14) << "copy"
+          << std::setw(14) << "bookkeeping" << std::setw(10) << "ratio" << "\n";
+
+    for (int m=0; m<methods.size(); m++) {
+      for (int s=0; s<sizes.size(); s++) {
+        const int num_p = std::atoi(sizes[s].c_str());
+        if (num_p < numProcs || num_p % numProcs != 0) {
+          *out << "\nSkipping num_p = " << num_p << ", not a multiple of "
+               << numProcs << " ranks" << std::endl;
+          continue;
+        }
+
+        std::ostringstream name;
+        name << "dakota_benchmark_" << methods[m] << "_" << num_p;
+        if (comm->getRank() == 0) {
+          std::ofstream in((name.str() + ".in").c_str());
+          in << dakotaInput(methods[m], num_p, num_iterations, concurrency);
+        }
+        comm->barrier();
+
+        TriKota::Driver dakota(name.str() + ".in", name.str() + ".out",
+                               name.str() + ".err", "");
+
+        RCP<TriKota::DiagonalMultiPointROME> multiPointApp;
+        RCP<TriKota::DiagonalROME<double> > thyraApp;
+        if (multi_point) thyraApp = multiPointApp = TriKota::createMultiPointModel(num_p,5.0);
+        else             thyraApp = TriKota::createModel<double>(num_p,5.0);
+
+        Teuchos::RCP<TriKota::ThyraDirectApplicInterface> trikota_interface =
+          Teuchos::rcp(new TriKota::ThyraDirectApplicInterface(dakota.getProblemDescDB(), thyraApp), false);
+
+        // Rank 0 of the analysis holds the responses and writes them
+        const std::string results_file = name.str() + ".trk";
+        if (write_results && comm->getRank() == 0)
+          trikota_interface->setResultsWriter(Teuchos::rcp(new TriKota::ResultsWriter(
+            results_file, methods[m] != "sampling")));
+
+        dakota.run(trikota_interface.get());
+        if (multi_point)
+          *out << "\n" << name.str() << ": " << multiPointApp->numMultiPointColumns()
+               << " points in " << multiPointApp->numMultiPointCalls()
+               << " evalMultiPoint calls" << std::endl;
+
+        // The slowest rank determines the cost of an evaluation
+        const RCP<ES> stats = trikota_interface->getEvaluationStatistics();
+
+        if (write_results) {
+          trikota_interface->setResultsWriter(Teuchos::null);
+          comm->barrier();
+
+          // Every rank reads the history; only the final point is broadcast
+          const TriKota::ResultsTable results = TriKota::readResults(results_file);
+          std::vector<double> final_x, final_g;
+          dakota.getFinalResults(final_x, final_g);
+          if ((int) results.numRows != stats->numEvaluations() || results.numVars != num_p ||
+              (int) final_x.size() != num_p || final_g.size() != 1) {
+            *out << "\nError: " << results_file << " holds " << results.numRows << " rows of "
+                 << results.numVars << " variables for " << stats->numEvaluations()
+                 << " evaluations, the final point has " << final_x.size() << " variables"
+                 << std::endl;
+            success = false;
+          }
+        }
+        const double local[3] = {
+          stats->totalTime(ES::PHASE_EVAL_MODEL),
+          stats->totalTime(ES::PHASE_COPY_IN) + stats->totalTime(ES::PHASE_COPY_OUT),
+          stats->totalTime(ES::PHASE_BOOKKEEPING) };
+        double global[3];
+        Teuchos::reduceAll<int,double>(*comm, Teuchos::REDUCE_MAX, 3, local, global);
+
+        const int evals = std::max(stats->numEvaluations(), 1);
+        const double ratio = (global[0] > 0.0) ? global[1]/global[0] : 0.0;
+        table << std::setw(10) << methods[m] << std::setw(10) << num_p
+              << std::setw(7) << numProcs << std::setw(8) << stats->numEvaluations()
+              << std::setw(14) << global[0]/evals << std::setw(14) << global[1]/evals
+              << std::setw(14) << global[2]/evals << std::setw(10) << ratio << "\n";
+
+        if (max_overhead_ratio > 0.0 && ratio > max_overhead_ratio) {
+          *out << "\nError: adapter overhead ratio " << ratio << " > "
+               << max_overhead_ratio << " for " << name.str() << std::endl;
+          success = false;
+        }
+      }
+    }
+
+    *out << "\nSeconds per evaluation (copy = parameter copy-in + response copy-out,"
+         << " ratio = copy/evalModel):\n" << table.str() << std::flush;
+
+  }
+  TEUCHOS_STANDARD_CATCH_STATEMENTS(true, std::cerr, success);
+
+  if(success)
+    *out << "\nEnd Result: TEST PASSED\n";
+  else
+    *out << "\nEnd Result: TEST FAILED\n";
+    
+  return ( success ? 0 : 1 );
+
+
+}
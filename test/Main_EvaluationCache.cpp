@@ -0,0 +1,143 @@
+// @HEADER
+// ************************************************************************
+// 
+//        TriKota: A Trilinos Wrapper for the Dakota Framework
+//                  Copyright (2009) Sandia Corporation
+// 
+// Under the terms of Contract DE-AC04-94AL85000 with Sandia Corporation,
+// the U.S. Government retains certain rights in this software.
+// 
+// This library is free software; you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation; either version 2.1 of the
+// License, or (at your option) any later version.
+//  
+// This library is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301
+// USA
+// 
+// Questions? Contact Andy Salinger (agsalin@sandia.gov), Sandia
+// National Laboratories.
+// 
+// ************************************************************************
+// @HEADER
+
+#include "Diagonal_ThyraROME_def.hpp"
+
+#include "TriKota_Driver.hpp"
+#include "TriKota_ThyraDirectApplicInterface.hpp"
+#include "TriKota_EvaluationCache.hpp"
+
+#include "Teuchos_GlobalMPISession.hpp"
+#include "Teuchos_StandardCatchMacros.hpp"
+#include "Teuchos_VerboseObject.hpp"
+
+#include <cmath>
+#include <vector>
+
+// Evaluation cache: the same optimization of a DiagonalROME is run
+// twice, by two adapters sharing one cache. The second run repeats every
+// point of the first, so it must be served entirely from the cache and
+// still converge to the exact optimum p = 2, g = 5.
+
+namespace {
+
+
+bool checkSolution(TriKota::Driver& dakota, const int num_p, std::ostream& out)
+{
+  std::vector<double> x, g;
+  dakota.getFinalResults(x, g);
+
+  const double errorTol = 1e-6;
+  double finalError = 0.0;
+  for (unsigned int i=0; i<x.size(); i++) finalError += (x[i] - 2.0)*(x[i] - 2.0);
+  finalError = std::sqrt(finalError);
+  out << "\nfinalError = " << finalError << ", g = " << (g.empty() ? 0.0 : g[0]) << "\n";
+
+  if ((int) x.size() != num_p || g.size() != 1 ||
+      finalError > errorTol || std::fabs(g[0] - 5.0) > errorTol) {
+    out << "\nError: the optimum is p = 2, g = 5 (tolerance " << errorTol << ")\n";
+    return false;
+  }
+  return true;
+}
+
+
+} // namespace
+
+
+
+int main(int argc, char* argv[])
+{
+
+  using Teuchos::RCP;
+  using Teuchos::rcp;
+  using Teuchos::FancyOStream;
+  using Teuchos::VerboseObjectBase;
+
+  bool success = true;
+
+  Teuchos::GlobalMPISession mpiSession(&argc,&argv);
+
+  const RCP<FancyOStream>
+    out = VerboseObjectBase::getDefaultOStream();
+
+  try {
+
+    const int num_p = 16;
+    const RCP<TriKota::EvaluationCache> cache = rcp(new TriKota::EvaluationCache);
+
+    // Two Drivers, so that Dakota's own duplicate detection of the
+    // first study cannot serve the second one
+    int evaluations[2], cached[2];
+    for (int r=0; r<2; r++) {
+      TriKota::Driver dakota("dakota_conmin.in", "evaluation_cache.out",
+                             "evaluation_cache.err", "");
+      const RCP<TriKota::DiagonalROME<double> > thyraApp =
+        TriKota::createModel<double>(num_p,5.0);
+
+      Teuchos::RCP<TriKota::ThyraDirectApplicInterface> trikota_interface =
+        Teuchos::rcp(new TriKota::ThyraDirectApplicInterface(dakota.getProblemDescDB(), thyraApp), false);
+      trikota_interface->setEvaluationCache(cache);
+
+      dakota.run(trikota_interface.get());
+      if (!checkSolution(dakota, num_p, *out)) success = false;
+
+      const RCP<TriKota::EvaluationStatistics> stats =
+        trikota_interface->getEvaluationStatistics();
+      evaluations[r] = stats->numEvaluations();
+      cached[r] = stats->numCachedEvaluations();
+    }
+
+    *out << "\nfirst run: " << evaluations[0] << " evaluations, " << cached[0]
+         << " from the cache\nsecond run: " << evaluations[1] << " evaluations, "
+         << cached[1] << " from the cache\n";
+    cache->print(*out);
+
+    if (evaluations[0] == 0 || evaluations[1] != evaluations[0] ||
+        cached[1] != evaluations[1]) {
+      *out << "\nError: the second run must repeat the " << evaluations[0]
+           << " evaluations of the first, all from the cache\n";
+      success = false;
+    }
+
+    *out << std::flush;
+
+  }
+  TEUCHOS_STANDARD_CATCH_STATEMENTS(true, std::cerr, success);
+
+  if(success)
+    *out << "\nEnd Result: TEST PASSED\n";
+  else
+    *out << "\nEnd Result: TEST FAILED\n";
+    
+  return ( success ? 0 : 1 );
+
+
+}
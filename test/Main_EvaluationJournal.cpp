@@ -0,0 +1,210 @@
+// @HEADER
+// ************************************************************************
+// 
+//        TriKota: A Trilinos Wrapper for the Dakota Framework
+//                  Copyright (2009) Sandia Corporation
+// 
+// Under the terms of Contract DE-AC04-94AL85000 with Sandia Corporation,
+// the U.S. Government retains certain rights in this software.
+// 
+// This library is free software; you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation; either version 2.1 of the
+// License, or (at your option) any later version.
+//  
+// This library is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301
+// USA
+// 
+// Questions? Contact Andy Salinger (agsalin@sandia.gov), Sandia
+// National Laboratories.
+// 
+// ************************************************************************
+// @HEADER
+
+#include "Diagonal_ThyraROME_def.hpp"
+
+#include "TriKota_Driver.hpp"
+#include "TriKota_ThyraDirectApplicInterface.hpp"
+#include "TriKota_EvaluationJournal.hpp"
+
+#include "Teuchos_GlobalMPISession.hpp"
+#include "Teuchos_DefaultComm.hpp"
+#include "Teuchos_StandardCatchMacros.hpp"
+#include "Teuchos_VerboseObject.hpp"
+
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Evaluation journal: an optimization of a DiagonalROME is journaled,
+// then run again from the journal by a new Driver and adapter, which
+// must replay every evaluation and still converge to the exact optimum
+// p = 2, g = 5. Files that are not journals must be refused untouched.
+
+namespace {
+
+
+const char journalFile[] = "evaluation_journal.trkj";
+
+
+bool checkSolution(TriKota::Driver& dakota, const int num_p, std::ostream& out)
+{
+  std::vector<double> x, g;
+  dakota.getFinalResults(x, g);
+
+  const double errorTol = 1e-6;
+  double finalError = 0.0;
+  for (unsigned int i=0; i<x.size(); i++) finalError += (x[i] - 2.0)*(x[i] - 2.0);
+  finalError = std::sqrt(finalError);
+  out << "\nfinalError = " << finalError << ", g = " << (g.empty() ? 0.0 : g[0]) << "\n";
+
+  if ((int) x.size() != num_p || g.size() != 1 ||
+      finalError > errorTol || std::fabs(g[0] - 5.0) > errorTol) {
+    out << "\nError: the optimum is p = 2, g = 5 (tolerance " << errorTol << ")\n";
+    return false;
+  }
+  return true;
+}
+
+
+// Write contents to fileName on rank 0 and check that opening it as a
+// journal throws and leaves it as it was
+bool checkRefused(const Teuchos::Comm<int>& comm, const char* fileName,
+                  const std::string& contents, std::ostream& out)
+{
+  if (comm.getRank() == 0) {
+    std::ofstream os(fileName, std::ios::binary);
+    os << contents;
+  }
+  comm.barrier();
+
+  bool refused = false;
+  try {
+    TriKota::EvaluationJournal journal(fileName);
+  }
+  catch (const std::logic_error&) {
+    refused = true;
+  }
+
+  std::ifstream is(fileName, std::ios::binary);
+  const std::string after((std::istreambuf_iterator<char>(is)),
+                          std::istreambuf_iterator<char>());
+  comm.barrier();
+  if (comm.getRank() == 0) std::remove(fileName);
+
+  if (!refused || after != contents) {
+    out << "\nError: " << fileName << " (" << contents.size()
+        << " bytes) must be refused and left untouched\n";
+    return false;
+  }
+  return true;
+}
+
+
+} // namespace
+
+
+
+int main(int argc, char* argv[])
+{
+
+  using Teuchos::RCP;
+  using Teuchos::rcp;
+  using Teuchos::FancyOStream;
+  using Teuchos::VerboseObjectBase;
+
+  bool success = true;
+
+  Teuchos::GlobalMPISession mpiSession(&argc,&argv);
+
+  const RCP<FancyOStream>
+    out = VerboseObjectBase::getDefaultOStream();
+
+  try {
+
+    const RCP<const Teuchos::Comm<int> > comm = Teuchos::DefaultComm<int>::getComm();
+    const int num_p = 16;
+
+    if (comm->getRank() == 0) std::remove(journalFile);
+    comm->barrier();
+
+    // The first run writes the journal, the second replays it
+    int evaluations[2], replayed[2];
+    std::size_t restored[2], appended[2];
+    for (int r=0; r<2; r++) {
+      TriKota::Driver dakota("dakota_conmin.in", "evaluation_journal.out",
+                             "evaluation_journal.err", "");
+      const RCP<TriKota::DiagonalROME<double> > thyraApp =
+        TriKota::createModel<double>(num_p,5.0);
+
+      Teuchos::RCP<TriKota::ThyraDirectApplicInterface> trikota_interface =
+        Teuchos::rcp(new TriKota::ThyraDirectApplicInterface(dakota.getProblemDescDB(), thyraApp), false);
+      RCP<TriKota::EvaluationJournal> journal = rcp(new TriKota::EvaluationJournal(journalFile));
+      trikota_interface->setEvaluationJournal(journal);
+
+      dakota.run(trikota_interface.get());
+      if (!checkSolution(dakota, num_p, *out)) success = false;
+
+      journal->flush();
+      journal->print(*out);
+      evaluations[r] = trikota_interface->getEvaluationStatistics()->numEvaluations();
+      replayed[r] = journal->numHits();
+      restored[r] = journal->numRestored();
+      appended[r] = journal->numAppended();
+
+      // Close the file before the next run opens it
+      trikota_interface->setEvaluationJournal(Teuchos::null);
+      journal = Teuchos::null;
+      comm->barrier();
+    }
+
+    *out << "\nfirst run: " << evaluations[0] << " evaluations, " << appended[0]
+         << " records appended\nsecond run: " << evaluations[1] << " evaluations, "
+         << replayed[1] << " replayed from " << restored[1] << " records\n";
+
+    if (evaluations[0] == 0 || replayed[0] != 0 || restored[0] != 0 ||
+        evaluations[1] != evaluations[0] || replayed[1] != evaluations[1] ||
+        appended[1] != 0) {
+      *out << "\nError: the second run must replay the " << evaluations[0]
+           << " evaluations of the first from the journal\n";
+      success = false;
+    }
+    if (comm->getRank() == 0) {
+      if (appended[0] == 0 || restored[1] != appended[0]) {
+        *out << "\nError: the journal must hold the " << appended[0]
+             << " records written by the first run\n";
+        success = false;
+      }
+      std::remove(journalFile);
+    }
+
+    // Shorter than a header, and long enough but with the wrong magic
+    if (!checkRefused(*comm, "not_a_journal.txt", "TriKota", *out)) success = false;
+    if (!checkRefused(*comm, "not_a_journal.txt",
+                      "TriKota journal test: plain text, not records\n", *out)) success = false;
+
+    *out << std::flush;
+
+  }
+  TEUCHOS_STANDARD_CATCH_STATEMENTS(true, std::cerr, success);
+
+  if(success)
+    *out << "\nEnd Result: TEST PASSED\n";
+  else
+    *out << "\nEnd Result: TEST FAILED\n";
+    
+  return ( success ? 0 : 1 );
+
+
+}
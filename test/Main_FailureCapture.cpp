@@ -0,0 +1,315 @@
+// @HEADER
+// ************************************************************************
+// 
+//        TriKota: A Trilinos Wrapper for the Dakota Framework
+//                  Copyright (2009) Sandia Corporation
+// 
+// Under the terms of Contract DE-AC04-94AL85000 with Sandia Corporation,
+// the U.S. Government retains certain rights in this software.
+// 
+// This library is free software; you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation; either version 2.1 of the
+// License, or (at your option) any later version.
+//  
+// This library is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301
+// USA
+// 
+// Questions? Contact Andy Salinger (agsalin@sandia.gov), Sandia
+// National Laboratories.
+// 
+// ************************************************************************
+// @HEADER
+
+#include "Diagonal_ThyraROME_def.hpp"
+
+#include "TriKota_Driver.hpp"
+#include "TriKota_ThyraDirectApplicInterface.hpp"
+
+#include "Teuchos_GlobalMPISession.hpp"
+#include "Teuchos_DefaultComm.hpp"
+#include "Teuchos_CommHelpers.hpp"
+#include "Teuchos_StandardCatchMacros.hpp"
+#include "Teuchos_VerboseObject.hpp"
+
+#include <cmath>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+// Failure capture: a DiagonalROME throws from every fourth evaluation
+// on the last rank only. The adapter must make all ranks agree on the
+// failure and hand it to Dakota, whose failure_capture retry repeats the
+// evaluation, so the optimization still reaches the exact optimum
+// p = 2, g = 5. Then a parameter study is queued to a
+// DiagonalMultiPointROME whose batch fails: the adapter redoes it point
+// by point, and each point must be recorded once, not once for the batch
+// and again for its retry.
+
+namespace {
+
+
+//! DiagonalROME failing every period-th evaluation on one rank
+class FailingROME : public TriKota::DiagonalROME<double>
+{
+public:
+
+  FailingROME(const int localDim, const bool failHere, const int period)
+    : TriKota::DiagonalROME<double>(localDim), failHere(failHere), period(period),
+      evaluations(0), failures(0)
+    {}
+
+  void evalModel(const Thyra::ModelEvaluatorBase::InArgs<double>& inArgs,
+                 const Thyra::ModelEvaluatorBase::OutArgs<double>& outArgs) const
+    {
+      // Throw after the collective work, so the other ranks are not
+      // left waiting in a reduction
+      TriKota::DiagonalROME<double>::evalModel(inArgs, outArgs);
+      if (failHere && ++evaluations % period == 0) {
+        failures++;
+        TEUCHOS_TEST_FOR_EXCEPTION(true, std::runtime_error,
+           "FailingROME: evaluation " << evaluations << " fails");
+      }
+    }
+
+  //! Evaluations that threw
+  int numFailures() const { return failures; }
+
+private:
+
+  const bool failHere;
+  const int period;
+  mutable int evaluations;
+  mutable int failures;
+
+};
+
+
+//! DiagonalMultiPointROME failing its first batch, and every period-th evaluation, on one rank
+class FailingMultiPointROME : public TriKota::DiagonalMultiPointROME
+{
+public:
+
+  FailingMultiPointROME(const int localDim, const bool failHere, const int period)
+    : TriKota::DiagonalMultiPointROME(localDim), failHere(failHere), period(period),
+      evaluations(0), failures(0), batches(0), batchFailures(0)
+    {}
+
+  void evalModel(const Thyra::ModelEvaluatorBase::InArgs<double>& inArgs,
+                 const Thyra::ModelEvaluatorBase::OutArgs<double>& outArgs) const
+    {
+      TriKota::DiagonalMultiPointROME::evalModel(inArgs, outArgs);
+      if (failHere && ++evaluations % period == 0) {
+        failures++;
+        TEUCHOS_TEST_FOR_EXCEPTION(true, std::runtime_error,
+           "FailingMultiPointROME: evaluation " << evaluations << " fails");
+      }
+    }
+
+  void evalMultiPoint(
+    const int p_index, const int g_index, const Thyra::MultiVectorBase<double>& P,
+    const Teuchos::Ptr<Thyra::MultiVectorBase<double> >& G,
+    const Teuchos::ArrayView<const Teuchos::RCP<Thyra::MultiVectorBase<double> > >& DgDp,
+    const Thyra::ModelEvaluatorBase::EDerivativeMultiVectorOrientation orientation) const
+    {
+      TriKota::DiagonalMultiPointROME::evalMultiPoint(p_index, g_index, P, G, DgDp, orientation);
+      if (failHere && batches++ == 0) {
+        batchFailures++;
+        TEUCHOS_TEST_FOR_EXCEPTION(true, std::runtime_error,
+           "FailingMultiPointROME: batch of " << P.domain()->dim() << " points fails");
+      }
+    }
+
+  //! Single evaluations that threw
+  int numFailures() const { return failures; }
+
+  //! Batches that threw
+  int numBatchFailures() const { return batchFailures; }
+
+private:
+
+  const bool failHere;
+  const int period;
+  mutable int evaluations;
+  mutable int failures;
+  mutable int batches;
+  mutable int batchFailures;
+
+};
+
+
+const int num_points = 4;
+
+
+// List parameter study of num_points points, queued asynchronously
+std::string batchInput(const int num_p)
+{
+  std::ostringstream in;
+  in << "method,\n"
+     << "  list_parameter_study\n"
+     << "    list_of_points =";
+  for (int k=0; k<num_points; k++)
+    for (int i=0; i<num_p; i++) in << " " << 0.5*k + 0.01*i;
+  in << "\n"
+     << "variables,\n"
+     << "  continuous_design = " << num_p << "\n"
+     << "interface,\n"
+     << "  direct\n"
+     << "    analysis_driver = 'XOM_Dakota'\n"
+     << "  asynchronous\n"
+     << "    evaluation_concurrency = " << num_points << "\n"
+     << "  evaluation_servers = 1\n"
+     << "  failure_capture\n"
+     << "    retry = 2\n"
+     << "responses,\n"
+     << "  num_objective_functions = 1\n"
+     << "  no_gradients\n"
+     << "  no_hessians\n";
+  return in.str();
+}
+
+
+std::string dakotaInput(const int num_p)
+{
+  std::ostringstream in;
+  in << "method,\n"
+     << "  conmin_frcg\n"
+     << "    max_iterations = 100\n"
+     << "    convergence_tolerance = 1.0e-8\n"
+     << "variables,\n"
+     << "  continuous_design = " << num_p << "\n"
+     << "interface,\n"
+     << "  direct\n"
+     << "    analysis_driver = 'XOM_Dakota'\n"
+     << "  evaluation_servers = 1\n"
+     << "  failure_capture\n"
+     << "    retry = 2\n"
+     << "responses,\n"
+     << "  num_objective_functions = 1\n"
+     << "  analytic_gradients\n"
+     << "  no_hessians\n";
+  return in.str();
+}
+
+
+} // namespace
+
+
+
+int main(int argc, char* argv[])
+{
+
+  using Teuchos::RCP;
+  using Teuchos::rcp;
+  using Teuchos::FancyOStream;
+  using Teuchos::VerboseObjectBase;
+
+  bool success = true;
+
+  Teuchos::GlobalMPISession mpiSession(&argc,&argv);
+
+  const RCP<FancyOStream>
+    out = VerboseObjectBase::getDefaultOStream();
+
+  try {
+
+    const RCP<const Teuchos::Comm<int> > comm = Teuchos::DefaultComm<int>::getComm();
+    const int num_p = 16;
+    const bool failHere = (comm->getRank() == comm->getSize() - 1);
+
+    Teuchos::ParameterList options;
+    options.set("Input String", dakotaInput(num_p));
+    TriKota::Driver dakota(options);
+
+    const RCP<FailingROME> thyraApp = rcp(new FailingROME(num_p/comm->getSize(), failHere, 4));
+    const RCP<Thyra::VectorBase<double> > ps = Thyra::createMember(thyraApp->get_p_space(0));
+    Thyra::V_S(ps.ptr(), 2.0);
+    thyraApp->setSolutionVector(ps);
+    thyraApp->setScalarOffset(5.0);
+
+    Teuchos::RCP<TriKota::ThyraDirectApplicInterface> trikota_interface =
+      Teuchos::rcp(new TriKota::ThyraDirectApplicInterface(dakota.getProblemDescDB(), thyraApp), false);
+
+    dakota.run(trikota_interface.get());
+
+    std::vector<double> x, g;
+    dakota.getFinalResults(x, g);
+
+    const double errorTol = 1e-6;
+    double finalError = 0.0;
+    for (unsigned int i=0; i<x.size(); i++) finalError += (x[i] - 2.0)*(x[i] - 2.0);
+    finalError = std::sqrt(finalError);
+
+    // Every rank records the failures the last rank threw
+    int failures = thyraApp->numFailures();
+    Teuchos::broadcast(*comm, comm->getSize() - 1, Teuchos::outArg(failures));
+    const int failed = trikota_interface->getEvaluationStatistics()->numFailedEvaluations();
+    *out << "\nfinalError = " << finalError << ", g = " << (g.empty() ? 0.0 : g[0])
+         << "\nmodel failures = " << failures << ", failed evaluations = " << failed << "\n";
+
+    if ((int) x.size() != num_p || g.size() != 1 ||
+        finalError > errorTol || std::fabs(g[0] - 5.0) > errorTol) {
+      *out << "\nError: the optimum is p = 2, g = 5 (tolerance " << errorTol << ")\n";
+      success = false;
+    }
+    if (failures == 0 || failed != failures) {
+      *out << "\nError: each of the " << failures
+           << " model failures must be recorded as a failed evaluation\n";
+      success = false;
+    }
+
+    // The failed batch is redone point by point; the third single
+    // evaluation fails and is retried by Dakota
+    {
+      Teuchos::ParameterList batchOptions;
+      batchOptions.set("Input String", batchInput(num_p));
+      TriKota::Driver batchDakota(batchOptions);
+
+      const RCP<FailingMultiPointROME> batchApp =
+        rcp(new FailingMultiPointROME(num_p/comm->getSize(), failHere, 3));
+      const RCP<Thyra::VectorBase<double> > batch_ps = Thyra::createMember(batchApp->get_p_space(0));
+      Thyra::V_S(batch_ps.ptr(), 2.0);
+      batchApp->setSolutionVector(batch_ps);
+      batchApp->setScalarOffset(5.0);
+
+      Teuchos::RCP<TriKota::ThyraDirectApplicInterface> batch_interface =
+        Teuchos::rcp(new TriKota::ThyraDirectApplicInterface(batchDakota.getProblemDescDB(), batchApp), false);
+      batchDakota.run(batch_interface.get());
+
+      int counts[2] = { batchApp->numFailures(), batchApp->numBatchFailures() };
+      Teuchos::broadcast(*comm, comm->getSize() - 1, 2, counts);
+      const Teuchos::RCP<TriKota::EvaluationStatistics> stats =
+        batch_interface->getEvaluationStatistics();
+      *out << "\nbatch failures = " << counts[1] << ", model failures = " << counts[0]
+           << ", failed evaluations = " << stats->numFailedEvaluations()
+           << ", evaluations = " << stats->numEvaluations() << "\n";
+
+      if (counts[1] != 1 || counts[0] == 0 || stats->numFailedEvaluations() != counts[0] ||
+          stats->numEvaluations() != num_points + counts[0]) {
+        *out << "\nError: each of the " << num_points << " points and each of its "
+             << counts[0] << " retries must be recorded once, the failed batch not at all\n";
+        success = false;
+      }
+    }
+
+    *out << std::flush;
+
+  }
+  TEUCHOS_STANDARD_CATCH_STATEMENTS(true, std::cerr, success);
+
+  if(success)
+    *out << "\nEnd Result: TEST PASSED\n";
+  else
+    *out << "\nEnd Result: TEST FAILED\n";
+    
+  return ( success ? 0 : 1 );
+
+
+}
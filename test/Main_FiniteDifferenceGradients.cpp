@@ -0,0 +1,163 @@
+// @HEADER
+// ************************************************************************
+// 
+//        TriKota: A Trilinos Wrapper for the Dakota Framework
+//                  Copyright (2009) Sandia Corporation
+// 
+// Under the terms of Contract DE-AC04-94AL85000 with Sandia Corporation,
+// the U.S. Government retains certain rights in this software.
+// 
+// This library is free software; you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation; either version 2.1 of the
+// License, or (at your option) any later version.
+//  
+// This library is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301
+// USA
+// 
+// Questions? Contact Andy Salinger (agsalin@sandia.gov), Sandia
+// National Laboratories.
+// 
+// ************************************************************************
+// @HEADER
+
+#include "Diagonal_ThyraROME_def.hpp"
+
+#include "TriKota_Driver.hpp"
+#include "TriKota_ThyraDirectApplicInterface.hpp"
+
+#include "Teuchos_GlobalMPISession.hpp"
+#include "Teuchos_StandardCatchMacros.hpp"
+#include "Teuchos_VerboseObject.hpp"
+
+#include <cmath>
+#include <vector>
+
+// Finite-difference gradients: a DiagonalROME is optimized with the
+// gradients computed by the adapter, by forward and then by central
+// differences. The model must never be asked for DgDp, and both runs
+// must reach the optimum p = 2, g = 5 up to the differencing error.
+
+namespace {
+
+
+//! DiagonalROME counting its evaluations and the DgDp requests
+class CountingROME : public TriKota::DiagonalROME<double>
+{
+public:
+
+  CountingROME(const int localDim)
+    : TriKota::DiagonalROME<double>(localDim), evaluations(0), gradientRequests(0)
+    {}
+
+  void evalModel(const Thyra::ModelEvaluatorBase::InArgs<double>& inArgs,
+                 const Thyra::ModelEvaluatorBase::OutArgs<double>& outArgs) const
+    {
+      evaluations++;
+      if (!outArgs.get_DgDp(0,0).isEmpty()) gradientRequests++;
+      TriKota::DiagonalROME<double>::evalModel(inArgs, outArgs);
+    }
+
+  //! evalModel calls
+  int numEvaluations() const { return evaluations; }
+  //! evalModel calls asking for DgDp
+  int numGradientRequests() const { return gradientRequests; }
+
+private:
+
+  mutable int evaluations;
+  mutable int gradientRequests;
+
+};
+
+
+} // namespace
+
+
+
+int main(int argc, char* argv[])
+{
+
+  using Teuchos::RCP;
+  using Teuchos::rcp;
+  using Teuchos::FancyOStream;
+  using Teuchos::VerboseObjectBase;
+
+  bool success = true;
+
+  Teuchos::GlobalMPISession mpiSession(&argc,&argv);
+
+  const RCP<FancyOStream>
+    out = VerboseObjectBase::getDefaultOStream();
+
+  try {
+
+    const RCP<const Teuchos::Comm<Thyra::Ordinal> > comm =
+      Teuchos::DefaultComm<Thyra::Ordinal>::getComm();
+    const int num_p = 16;
+
+    const TriKota::EFiniteDifference methods[] = { TriKota::FD_FORWARD, TriKota::FD_CENTRAL };
+    const char* names[] = { "forward", "central" };
+    for (int m=0; m<2; m++) {
+      TriKota::Driver dakota("dakota_conmin.in", "finite_difference.out",
+                             "finite_difference.err", "");
+
+      const RCP<CountingROME> thyraApp =
+        rcp(new CountingROME(TriKota::diagonalLocalDim(num_p, comm)));
+      const RCP<Thyra::VectorBase<double> > ps = Thyra::createMember(thyraApp->get_p_space(0));
+      Thyra::V_S(ps.ptr(), 2.0);
+      thyraApp->setSolutionVector(ps);
+      thyraApp->setScalarOffset(5.0);
+
+      Teuchos::RCP<TriKota::ThyraDirectApplicInterface> trikota_interface =
+        Teuchos::rcp(new TriKota::ThyraDirectApplicInterface(dakota.getProblemDescDB(), thyraApp), false);
+      trikota_interface->setFiniteDifferenceGradients(methods[m]);
+
+      dakota.run(trikota_interface.get());
+
+      std::vector<double> x, g;
+      dakota.getFinalResults(x, g);
+
+      // The differencing error of the quadratic shifts the optimum by
+      // about the step at most
+      const double errorTol = 1e-4;
+      double finalError = 0.0;
+      for (unsigned int i=0; i<x.size(); i++) finalError += (x[i] - 2.0)*(x[i] - 2.0);
+      finalError = std::sqrt(finalError);
+      *out << "\n" << names[m] << " differences: finalError = " << finalError
+           << ", g = " << (g.empty() ? 0.0 : g[0]) << ", " << thyraApp->numEvaluations()
+           << " model evaluations, " << thyraApp->numGradientRequests() << " asking for DgDp\n";
+
+      if ((int) x.size() != num_p || g.size() != 1 ||
+          finalError > errorTol || std::fabs(g[0] - 5.0) > errorTol) {
+        *out << "\nError: the optimum is p = 2, g = 5 (tolerance " << errorTol << ")\n";
+        success = false;
+      }
+      // Every gradient costs at least one evaluation per variable
+      if (thyraApp->numGradientRequests() != 0 || thyraApp->numEvaluations() <= num_p) {
+        *out << "\nError: the gradients must come from the adapter's differences\n";
+        success = false;
+      }
+    }
+
+    *out << std::flush;
+
+  }
+  TEUCHOS_STANDARD_CATCH_STATEMENTS(true, std::cerr, success);
+
+  if(success)
+    *out << "\nEnd Result: TEST PASSED\n";
+  else
+    *out << "\nEnd Result: TEST FAILED\n";
+    
+  return ( success ? 0 : 1 );
+
+
+}
@@ -0,0 +1,150 @@
+// @HEADER
+// ************************************************************************
+// 
+//        TriKota: A Trilinos Wrapper for the Dakota Framework
+//                  Copyright (2009) Sandia Corporation
+// 
+// Under the terms of Contract DE-AC04-94AL85000 with Sandia Corporation,
+// the U.S. Government retains certain rights in this software.
+// 
+// This library is free software; you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation; either version 2.1 of the
+// License, or (at your option) any later version.
+//  
+// This library is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301
+// USA
+// 
+// Questions? Contact Andy Salinger (agsalin@sandia.gov), Sandia
+// National Laboratories.
+// 
+// ************************************************************************
+// @HEADER
+
+#include "Diagonal_ThyraROME_def.hpp"
+
+#include "TriKota_Driver.hpp"
+#include "TriKota_ThyraDirectApplicInterface.hpp"
+
+#include "Teuchos_GlobalMPISession.hpp"
+#include "Teuchos_StandardCatchMacros.hpp"
+#include "Teuchos_VerboseObject.hpp"
+
+#include <cmath>
+#include <sstream>
+#include <vector>
+
+// Hessian assembly: Newton's method on a DiagonalROME with the
+// diagonal 1, 2, ..., num_p, whose Hessians the adapter assembles from
+// Hessian-vector products in blocks that do not divide num_p. With the
+// exact Hessian the first Newton step lands on the optimum p = 2, g = 5,
+// so a few iterations must reach it to round-off.
+
+namespace {
+
+
+std::string dakotaInput(const int num_p)
+{
+  std::ostringstream in;
+  in << "method,\n"
+     << "  optpp_newton\n"
+     << "    max_iterations = 3\n"
+     << "    convergence_tolerance = 1.0e-12\n"
+     << "variables,\n"
+     << "  continuous_design = " << num_p << "\n"
+     << "interface,\n"
+     << "  direct\n"
+     << "    analysis_driver = 'XOM_Dakota'\n"
+     << "responses,\n"
+     << "  num_objective_functions = 1\n"
+     << "  analytic_gradients\n"
+     << "  analytic_hessians\n";
+  return in.str();
+}
+
+
+} // namespace
+
+
+
+int main(int argc, char* argv[])
+{
+
+  using Teuchos::RCP;
+  using Teuchos::rcp;
+  using Teuchos::FancyOStream;
+  using Teuchos::VerboseObjectBase;
+
+  bool success = true;
+
+  Teuchos::GlobalMPISession mpiSession(&argc,&argv);
+
+  const RCP<FancyOStream>
+    out = VerboseObjectBase::getDefaultOStream();
+
+  try {
+
+    const int num_p = 16;
+
+    Teuchos::ParameterList options;
+    options.set("Input String", dakotaInput(num_p));
+    TriKota::Driver dakota(options);
+
+    const RCP<TriKota::DiagonalROME<double> > thyraApp =
+      TriKota::createModel<double>(num_p,5.0);
+
+    // diag[i] = i+1, so that every column of the Hessian is different
+    const RCP<const Thyra::SpmdVectorSpaceBase<double> > p_space =
+      Teuchos::rcp_dynamic_cast<const Thyra::SpmdVectorSpaceBase<double> >(
+        thyraApp->get_p_space(0), true);
+    const RCP<Thyra::VectorBase<double> > diag = Thyra::createMember<double>(p_space);
+    {
+      const Thyra::DetachedSpmdVectorView<double> diag_local(diag);
+      for (Thyra::Ordinal i = 0; i < diag_local.subDim(); ++i)
+        diag_local[i] = 1.0 + p_space->localOffset() + i;
+    }
+    thyraApp->setDiagonalVector(diag);
+
+    Teuchos::RCP<TriKota::ThyraDirectApplicInterface> trikota_interface =
+      Teuchos::rcp(new TriKota::ThyraDirectApplicInterface(dakota.getProblemDescDB(), thyraApp), false);
+    trikota_interface->setHessianBlockSize(5);
+
+    dakota.run(trikota_interface.get());
+
+    std::vector<double> x, g;
+    dakota.getFinalResults(x, g);
+
+    const double errorTol = 1e-8;
+    double finalError = 0.0;
+    for (unsigned int i=0; i<x.size(); i++) finalError += (x[i] - 2.0)*(x[i] - 2.0);
+    finalError = std::sqrt(finalError);
+    *out << "\nfinalError = " << finalError << ", g = " << (g.empty() ? 0.0 : g[0]) << "\n";
+
+    if ((int) x.size() != num_p || g.size() != 1 ||
+        finalError > errorTol || std::fabs(g[0] - 5.0) > errorTol) {
+      *out << "\nError: Newton's method did not reach p = 2, g = 5 (tolerance "
+           << errorTol << ")\n";
+      success = false;
+    }
+
+    *out << std::flush;
+
+  }
+  TEUCHOS_STANDARD_CATCH_STATEMENTS(true, std::cerr, success);
+
+  if(success)
+    *out << "\nEnd Result: TEST PASSED\n";
+  else
+    *out << "\nEnd Result: TEST FAILED\n";
+    
+  return ( success ? 0 : 1 );
+
+
+}
@@ -0,0 +1,237 @@
+// @HEADER
+// ************************************************************************
+// 
+//        TriKota: A Trilinos Wrapper for the Dakota Framework
+//                  Copyright (2009) Sandia Corporation
+// 
+// Under the terms of Contract DE-AC04-94AL85000 with Sandia Corporation,
+// the U.S. Government retains certain rights in this software.
+// 
+// This library is free software; you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation; either version 2.1 of the
+// License, or (at your option) any later version.
+//  
+// This library is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301
+// USA
+// 
+// Questions? Contact Andy Salinger (agsalin@sandia.gov), Sandia
+// National Laboratories.
+// 
+// ************************************************************************
+// @HEADER
+
+#include "Diagonal_ThyraROME_def.hpp"
+
+#include "TriKota_Driver.hpp"
+#include "TriKota_ThyraDirectApplicInterface.hpp"
+
+#include "Teuchos_GlobalMPISession.hpp"
+#include "Teuchos_StandardCatchMacros.hpp"
+#include "Teuchos_VerboseObject.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "DakotaModel.hpp"
+
+// Two interfaces: a sequential hybrid runs a coarse optimization on the
+// model of one interface and finishes on the model of the other. Each
+// DiagonalROME is wrapped by an adapter constructed for its interface
+// id, which must seed the model of that interface and no other; the
+// finer model has the optimum p = 2, g = 5.
+
+namespace {
+
+
+std::string dakotaInput(const int num_p)
+{
+  std::ostringstream in;
+  in << "environment,\n"
+     << "  top_method_pointer = 'HYBRID'\n"
+     << "method,\n"
+     << "  id_method = 'HYBRID'\n"
+     << "  hybrid sequential\n"
+     << "    method_pointer_list = 'COARSE' 'FINE'\n"
+     << "method,\n"
+     << "  id_method = 'COARSE'\n"
+     << "  model_pointer = 'LOFI'\n"
+     << "  conmin_frcg\n"
+     << "    max_iterations = 100\n"
+     << "    convergence_tolerance = 1.0e-4\n"
+     << "method,\n"
+     << "  id_method = 'FINE'\n"
+     << "  model_pointer = 'HIFI'\n"
+     << "  conmin_frcg\n"
+     << "    max_iterations = 100\n"
+     << "    convergence_tolerance = 1.0e-8\n"
+     << "model,\n"
+     << "  id_model = 'LOFI'\n"
+     << "  single\n"
+     << "    interface_pointer = 'LOFI_INT'\n"
+     << "model,\n"
+     << "  id_model = 'HIFI'\n"
+     << "  single\n"
+     << "    interface_pointer = 'HIFI_INT'\n"
+     << "variables,\n"
+     << "  continuous_design = " << num_p << "\n"
+     << "interface,\n"
+     << "  id_interface = 'LOFI_INT'\n"
+     << "  direct\n"
+     << "    analysis_driver = 'XOM_Dakota'\n"
+     << "interface,\n"
+     << "  id_interface = 'HIFI_INT'\n"
+     << "  direct\n"
+     << "    analysis_driver = 'XOM_Dakota'\n"
+     << "responses,\n"
+     << "  num_objective_functions = 1\n"
+     << "  analytic_gradients\n"
+     << "  no_hessians\n";
+  return in.str();
+}
+
+
+//! Largest distance of the continuous variables of model from value
+double distance(Dakota::Model& model, const double value)
+{
+  const Dakota::RealVector& x = model.continuous_variables();
+  double d = 0.0;
+  for (int i=0; i<x.length(); i++) d = std::max(d, std::fabs(x[i] - value));
+  return d;
+}
+
+
+} // namespace
+
+
+
+int main(int argc, char* argv[])
+{
+
+  using Teuchos::RCP;
+  using Teuchos::rcp;
+  using Teuchos::FancyOStream;
+  using Teuchos::VerboseObjectBase;
+
+  bool success = true;
+
+  Teuchos::GlobalMPISession mpiSession(&argc,&argv);
+
+  const RCP<FancyOStream>
+    out = VerboseObjectBase::getDefaultOStream();
+
+  try {
+
+    const int num_p = 16;
+
+    Teuchos::ParameterList options;
+    options.set("Input String", dakotaInput(num_p));
+    TriKota::Driver dakota(options);
+
+    const std::vector<std::string> ids = dakota.getInterfaceIds();
+    if (ids.size() != 2) {
+      *out << "\nError: the input has two interfaces, found " << ids.size() << "\n";
+      success = false;
+    }
+    else {
+      // The coarse model has its optimum elsewhere
+      const RCP<TriKota::DiagonalROME<double> > lofiApp = TriKota::createModel<double>(num_p, 4.0);
+      const RCP<Thyra::VectorBase<double> > lofi_ps = Thyra::createMember(lofiApp->get_p_space(0));
+      Thyra::V_S(lofi_ps.ptr(), 1.9);
+      lofiApp->setSolutionVector(lofi_ps);
+      const RCP<TriKota::DiagonalROME<double> > hifiApp = TriKota::createModel<double>(num_p, 5.0);
+
+      Dakota::Model& lofiModel = dakota.getModel("LOFI_INT");
+      Dakota::Model& hifiModel = dakota.getModel("HIFI_INT");
+      lofiModel.continuous_variables(Dakota::RealVector(num_p));
+      hifiModel.continuous_variables(Dakota::RealVector(num_p));
+
+      // The adapter of the second model in the input comes first, so
+      // seeding the first model of the list instead is caught
+      const bool hifiFirst = (ids[1] == "HIFI_INT");
+      std::map<std::string, RCP<TriKota::ThyraDirectApplicInterface> > adapters;
+      const std::string first = ids[1];
+      adapters[first] = rcp(new TriKota::ThyraDirectApplicInterface(
+          dakota.getProblemDescDB(), first, hifiFirst ? hifiApp : lofiApp), false);
+
+      // Nominal values of DiagonalROME are 1.5
+      const double seeded = distance(hifiFirst ? hifiModel : lofiModel, 1.5);
+      const double untouched = distance(hifiFirst ? lofiModel : hifiModel, 0.0);
+      *out << "\nafter the adapter of " << first << ": seeded model off by " << seeded
+           << ", other model off by " << untouched << "\n";
+      if (seeded != 0.0 || untouched != 0.0) {
+        *out << "\nError: only the model of " << first << " may be seeded\n";
+        success = false;
+      }
+
+      const std::string second = ids[0];
+      adapters[second] = rcp(new TriKota::ThyraDirectApplicInterface(
+          dakota.getProblemDescDB(), second, hifiFirst ? lofiApp : hifiApp), false);
+
+      bool rejected = false;
+      try {
+        TriKota::ThyraDirectApplicInterface unknown(dakota.getProblemDescDB(), "NO_INT", hifiApp);
+      }
+      catch (const std::logic_error&) {
+        rejected = true;
+      }
+      if (!rejected) {
+        *out << "\nError: an adapter for an interface no model uses must be rejected\n";
+        success = false;
+      }
+
+      std::map<std::string, Dakota::DirectApplicInterface*> appInterfaces;
+      appInterfaces["LOFI_INT"] = adapters["LOFI_INT"].get();
+      appInterfaces["HIFI_INT"] = adapters["HIFI_INT"].get();
+      dakota.run(appInterfaces);
+
+      std::vector<double> x, g;
+      dakota.getFinalResults(x, g);
+
+      const double errorTol = 1e-6;
+      double finalError = 0.0;
+      for (unsigned int i=0; i<x.size(); i++) finalError += (x[i] - 2.0)*(x[i] - 2.0);
+      finalError = std::sqrt(finalError);
+      const int lofiEvaluations = adapters["LOFI_INT"]->getEvaluationStatistics()->numEvaluations();
+      const int hifiEvaluations = adapters["HIFI_INT"]->getEvaluationStatistics()->numEvaluations();
+      *out << "\nfinalError = " << finalError << ", g = " << (g.empty() ? 0.0 : g[0])
+           << "\nLOFI_INT evaluations = " << lofiEvaluations
+           << ", HIFI_INT evaluations = " << hifiEvaluations << "\n";
+
+      if ((int) x.size() != num_p || g.size() != 1 ||
+          finalError > errorTol || std::fabs(g[0] - 5.0) > errorTol) {
+        *out << "\nError: the optimum is p = 2, g = 5 (tolerance " << errorTol << ")\n";
+        success = false;
+      }
+      if (lofiEvaluations == 0 || hifiEvaluations == 0) {
+        *out << "\nError: each interface must be evaluated through its own adapter\n";
+        success = false;
+      }
+    }
+
+    *out << std::flush;
+
+  }
+  TEUCHOS_STANDARD_CATCH_STATEMENTS(true, std::cerr, success);
+
+  if(success)
+    *out << "\nEnd Result: TEST PASSED\n";
+  else
+    *out << "\nEnd Result: TEST FAILED\n";
+    
+  return ( success ? 0 : 1 );
+
+
+}
@@ -0,0 +1,150 @@
+// @HEADER
+// ************************************************************************
+// 
+//        TriKota: A Trilinos Wrapper for the Dakota Framework
+//                  Copyright (2009) Sandia Corporation
+// 
+// Under the terms of Contract DE-AC04-94AL85000 with Sandia Corporation,
+// the U.S. Government retains certain rights in this software.
+// 
+// This library is free software; you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation; either version 2.1 of the
+// License, or (at your option) any later version.
+//  
+// This library is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301
+// USA
+// 
+// Questions? Contact Andy Salinger (agsalin@sandia.gov), Sandia
+// National Laboratories.
+// 
+// ************************************************************************
+// @HEADER
+
+#include "Diagonal_ThyraROME_def.hpp"
+
+#include "TriKota_Driver.hpp"
+#include "TriKota_StudyScheduler.hpp"
+#include "TriKota_ThyraDirectApplicInterface.hpp"
+
+#include "Teuchos_GlobalMPISession.hpp"
+#include "Teuchos_CommandLineProcessor.hpp"
+#include "Teuchos_StandardCatchMacros.hpp"
+#include "Teuchos_VerboseObject.hpp"
+#ifdef HAVE_MPI
+#include "Teuchos_DefaultMpiComm.hpp"
+#endif
+
+#include <cmath>
+#include <sstream>
+#include <vector>
+
+// Nested study: an outer loop over scenarios, each one an inner
+// optimization of a DiagonalROME with its own offset, run concurrently
+// on the colors of a TriKota::StudyScheduler.
+
+int main(int argc, char* argv[])
+{
+
+  using Teuchos::RCP;
+  using Teuchos::rcp;
+  using Teuchos::FancyOStream;
+  using Teuchos::VerboseObjectBase;
+
+  bool success = true;
+
+  Teuchos::GlobalMPISession mpiSession(&argc,&argv);
+
+  const RCP<FancyOStream>
+    out = VerboseObjectBase::getDefaultOStream();
+
+  try {
+
+    int num_colors = 2;
+    int num_scenarios = 6;
+
+    Teuchos::CommandLineProcessor clp;
+    clp.throwExceptions(false);
+    clp.addOutputSetupOptions(true);
+    clp.setOption("colors", &num_colors, "Number of concurrent inner studies");
+    clp.setOption("scenarios", &num_scenarios, "Number of scenarios of the outer loop");
+    const Teuchos::CommandLineProcessor::EParseCommandLineReturn
+      parse_return = clp.parse(argc,argv);
+    if (parse_return != Teuchos::CommandLineProcessor::PARSE_SUCCESSFUL)
+      return parse_return;
+
+    if (mpiSession.getNProc() < num_colors) num_colors = mpiSession.getNProc();
+    TriKota::StudyScheduler scheduler(num_colors);
+
+    const int num_p = 16;
+    const std::vector<TriKota::StudyScheduler::Result> results = scheduler.run(num_scenarios,
+      [num_p](int scenario, const TriKota::StudyScheduler& sched) {
+        std::ostringstream name;
+        name << "nested_" << scenario;
+#ifdef HAVE_MPI
+        TriKota::Driver dakota(sched.getColorComm(), "dakota_conmin.in",
+                               name.str() + ".out", name.str() + ".err", "");
+        const RCP<const Teuchos::Comm<Thyra::Ordinal> > comm =
+          rcp(new Teuchos::MpiComm<Thyra::Ordinal>(Teuchos::opaqueWrapper(dakota.getAnalysisComm())));
+#else
+        TriKota::Driver dakota("dakota_conmin.in",
+                               name.str() + ".out", name.str() + ".err", "");
+        const RCP<const Teuchos::Comm<Thyra::Ordinal> > comm = Teuchos::null;
+#endif
+        const RCP<TriKota::DiagonalROME<double> > thyraApp =
+          TriKota::createModel<double>(num_p, (double) scenario, comm);
+        Teuchos::RCP<TriKota::ThyraDirectApplicInterface> trikota_interface =
+          Teuchos::rcp(new TriKota::ThyraDirectApplicInterface(dakota.getProblemDescDB(), thyraApp), false);
+        dakota.setSummarizeStatistics(false);
+        dakota.run(trikota_interface.get());
+
+        // The optimum of every scenario is p = 2 with g = offset
+        std::vector<double> x, g;
+        dakota.getFinalResults(x, g);
+        double error = 0.0;
+        for (unsigned int i=0; i<x.size(); i++) error += (x[i] - 2.0)*(x[i] - 2.0);
+        std::vector<double> values(1, std::sqrt(error));
+        values.insert(values.end(), g.begin(), g.end());
+        return values;
+      });
+
+    scheduler.print(*out);
+    if (scheduler.worldRoot()) {
+      const double errorTol = 1e-6;
+      for (int s=0; s<(int) results.size(); s++) {
+        const TriKota::StudyScheduler::Result& result = results[s];
+        *out << "scenario " << s << " on color " << result.color << ": ";
+        if (result.failed || result.values.size() != 2) {
+          *out << "failed" << std::endl;
+          success = false;
+          continue;
+        }
+        *out << "finalError = " << result.values[0] << ", g = " << result.values[1] << std::endl;
+        if (result.values[0] > errorTol || std::fabs(result.values[1] - s) > errorTol) {
+          *out << "Error: scenario " << s << " did not converge to p = 2, g = " << s << std::endl;
+          success = false;
+        }
+      }
+    }
+
+    *out << std::flush;
+
+  }
+  TEUCHOS_STANDARD_CATCH_STATEMENTS(true, std::cerr, success);
+
+  if(success)
+    *out << "\nEnd Result: TEST PASSED\n";
+  else
+    *out << "\nEnd Result: TEST FAILED\n";
+    
+  return ( success ? 0 : 1 );
+
+
+}
@@ -0,0 +1,198 @@
+// @HEADER
+// ************************************************************************
+// 
+//        TriKota: A Trilinos Wrapper for the Dakota Framework
+//                  Copyright (2009) Sandia Corporation
+// 
+// Under the terms of Contract DE-AC04-94AL85000 with Sandia Corporation,
+// the U.S. Government retains certain rights in this software.
+// 
+// This library is free software; you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation; either version 2.1 of the
+// License, or (at your option) any later version.
+//  
+// This library is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301
+// USA
+// 
+// Questions? Contact Andy Salinger (agsalin@sandia.gov), Sandia
+// National Laboratories.
+// 
+// ************************************************************************
+// @HEADER
+
+#include "Diagonal_ThyraROME_def.hpp"
+
+#include "TriKota_Driver.hpp"
+#include "TriKota_SurrogateDirectApplicInterface.hpp"
+
+#include "Teuchos_GlobalMPISession.hpp"
+#include "Teuchos_StandardCatchMacros.hpp"
+#include "Teuchos_VerboseObject.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+#include <vector>
+
+// Taylor surrogate: a list study over a DiagonalROME repeats its first
+// point before moving away. The repeated point tells nothing about the
+// curvature, so the far point after it must still reach the model, and
+// the point next to it is answered by the surrogate. Every response,
+// from the surrogate or not, must match the exact g = 0.5*|p - 2|^2 + 5
+// and its gradient p - 2 within the error budget.
+
+namespace {
+
+
+const int num_p = 3;
+const int num_points = 5;
+const double points[num_points][num_p] = {
+  { 1.0, 1.0,   1.0 },
+  { 1.0, 1.0,   1.0 },
+  { 1.5, 1.0,   1.0 },
+  { 1.5, 1.003, 1.0 },
+  { 1.5, 1.5,   1.5 }
+};
+
+
+//! Surrogate adapter recording the largest error of its responses
+class CheckedSurrogate : public TriKota::SurrogateDirectApplicInterface
+{
+public:
+
+  CheckedSurrogate(Dakota::ProblemDescDB& problem_db,
+                   const Teuchos::RCP<Thyra::ModelEvaluatorDefaultBase<double> > App,
+                   const double tolerance)
+    : TriKota::SurrogateDirectApplicInterface(problem_db, App, tolerance),
+      valueError(0.0), gradientError(0.0), requests(0)
+    {}
+
+  //! Largest error of a value
+  double maxValueError() const { return valueError; }
+  //! Largest error of a gradient entry
+  double maxGradientError() const { return gradientError; }
+  //! Requests checked
+  int numRequests() const { return requests; }
+
+protected:
+
+  int derived_map_ac(const Dakota::String& ac_name)
+    {
+      const int failed = TriKota::SurrogateDirectApplicInterface::derived_map_ac(ac_name);
+      if (failed) return failed;
+
+      requests++;
+      double g = 5.0;
+      for (unsigned int i=0; i<numVars; i++) g += 0.5*(xC[i] - 2.0)*(xC[i] - 2.0);
+      valueError = std::max(valueError, std::fabs(fnVals[0] - g));
+      for (unsigned int i=0; i<numVars; i++)
+        gradientError = std::max(gradientError, std::fabs(fnGrads.values()[i] - (xC[i] - 2.0)));
+      return 0;
+    }
+
+private:
+
+  double valueError;
+  double gradientError;
+  int requests;
+
+};
+
+
+std::string dakotaInput()
+{
+  // Dakota's own cache would answer the repeated point itself
+  std::ostringstream in;
+  in << "method,\n"
+     << "  list_parameter_study\n"
+     << "    list_of_points =";
+  for (int k=0; k<num_points; k++)
+    for (int i=0; i<num_p; i++) in << " " << points[k][i];
+  in << "\n"
+     << "variables,\n"
+     << "  continuous_design = " << num_p << "\n"
+     << "interface,\n"
+     << "  direct\n"
+     << "    analysis_driver = 'XOM_Dakota'\n"
+     << "  deactivate evaluation_cache restart_file\n"
+     << "responses,\n"
+     << "  response_functions = 1\n"
+     << "  analytic_gradients\n"
+     << "  no_hessians\n";
+  return in.str();
+}
+
+
+} // namespace
+
+
+
+int main(int argc, char* argv[])
+{
+
+  using Teuchos::RCP;
+  using Teuchos::rcp;
+  using Teuchos::FancyOStream;
+  using Teuchos::VerboseObjectBase;
+
+  bool success = true;
+
+  Teuchos::GlobalMPISession mpiSession(&argc,&argv);
+
+  const RCP<FancyOStream>
+    out = VerboseObjectBase::getDefaultOStream();
+
+  try {
+
+    const double tolerance = 1e-2;
+
+    Teuchos::ParameterList options;
+    options.set("Input String", dakotaInput());
+    TriKota::Driver dakota(options);
+
+    const RCP<TriKota::DiagonalROME<double> > thyraApp =
+      TriKota::createModel<double>(num_p,5.0);
+
+    Teuchos::RCP<CheckedSurrogate> trikota_interface =
+      Teuchos::rcp(new CheckedSurrogate(dakota.getProblemDescDB(), thyraApp, tolerance), false);
+
+    dakota.run(trikota_interface.get());
+
+    trikota_interface->print(*out);
+    *out << "\nlargest value error = " << trikota_interface->maxValueError()
+         << ", largest gradient error = " << trikota_interface->maxGradientError() << "\n";
+
+    if (trikota_interface->numRequests() != num_points ||
+        trikota_interface->maxValueError() > tolerance ||
+        trikota_interface->maxGradientError() > tolerance) {
+      *out << "\nError: every response must be within " << tolerance << " of the exact one\n";
+      success = false;
+    }
+    // Only the point next to the third one is close enough
+    if (trikota_interface->numSaved() != 1 || trikota_interface->numForwarded() != num_points - 1) {
+      *out << "\nError: the surrogate must answer exactly the fourth point\n";
+      success = false;
+    }
+
+    *out << std::flush;
+
+  }
+  TEUCHOS_STANDARD_CATCH_STATEMENTS(true, std::cerr, success);
+
+  if(success)
+    *out << "\nEnd Result: TEST PASSED\n";
+  else
+    *out << "\nEnd Result: TEST FAILED\n";
+    
+  return ( success ? 0 : 1 );
+
+
+}
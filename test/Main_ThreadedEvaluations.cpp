@@ -0,0 +1,192 @@
+// @HEADER
+// ************************************************************************
+// 
+//        TriKota: A Trilinos Wrapper for the Dakota Framework
+//                  Copyright (2009) Sandia Corporation
+// 
+// Under the terms of Contract DE-AC04-94AL85000 with Sandia Corporation,
+// the U.S. Government retains certain rights in this software.
+// 
+// This library is free software; you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation; either version 2.1 of the
+// License, or (at your option) any later version.
+//  
+// This library is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301
+// USA
+// 
+// Questions? Contact Andy Salinger (agsalin@sandia.gov), Sandia
+// National Laboratories.
+// 
+// ************************************************************************
+// @HEADER
+
+#include "Diagonal_ThyraROME_def.hpp"
+
+#include "TriKota_Driver.hpp"
+#include "TriKota_ThyraDirectApplicInterface.hpp"
+
+#include "Teuchos_GlobalMPISession.hpp"
+#include "Teuchos_StandardCatchMacros.hpp"
+#include "Teuchos_VerboseObject.hpp"
+
+#include <cmath>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+// Threaded evaluations: Dakota's central finite-difference gradients of
+// a DiagonalROME are queued asynchronously and evaluated on the threads
+// of the adapter. The optimization must still reach the exact optimum
+// p = 2, g = 5, and the model must have been called from the workers.
+
+namespace {
+
+
+//! DiagonalROME recording the threads it is evaluated on
+class ThreadRecordingROME : public TriKota::DiagonalROME<double>
+{
+public:
+
+  ThreadRecordingROME(const int localDim)
+    : TriKota::DiagonalROME<double>(localDim), mainThread(std::this_thread::get_id()),
+      workerEvaluations(0)
+    {}
+
+  void evalModel(const Thyra::ModelEvaluatorBase::InArgs<double>& inArgs,
+                 const Thyra::ModelEvaluatorBase::OutArgs<double>& outArgs) const
+    {
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        threads.insert(std::this_thread::get_id());
+        if (std::this_thread::get_id() != mainThread) workerEvaluations++;
+      }
+      TriKota::DiagonalROME<double>::evalModel(inArgs, outArgs);
+    }
+
+  //! Distinct threads the model was evaluated on
+  int numThreads() const { return threads.size(); }
+
+  //! Evaluations performed off the main thread
+  int numWorkerEvaluations() const { return workerEvaluations; }
+
+private:
+
+  const std::thread::id mainThread;
+  mutable std::mutex mutex;
+  mutable std::set<std::thread::id> threads;
+  mutable int workerEvaluations;
+
+};
+
+
+std::string dakotaInput(const int num_p, const int concurrency)
+{
+  std::ostringstream in;
+  in << "method,\n"
+     << "  conmin_frcg\n"
+     << "    max_iterations = 100\n"
+     << "    convergence_tolerance = 1.0e-8\n"
+     << "variables,\n"
+     << "  continuous_design = " << num_p << "\n"
+     << "interface,\n"
+     << "  direct\n"
+     << "    analysis_driver = 'XOM_Dakota'\n"
+     << "  asynchronous\n"
+     << "    evaluation_concurrency = " << concurrency << "\n"
+     << "responses,\n"
+     << "  num_objective_functions = 1\n"
+     << "  numerical_gradients\n"
+     << "    method_source dakota\n"
+     << "    interval_type central\n"
+     << "    fd_step_size = 1.0e-5\n"
+     << "  no_hessians\n";
+  return in.str();
+}
+
+
+} // namespace
+
+
+
+int main(int argc, char* argv[])
+{
+
+  using Teuchos::RCP;
+  using Teuchos::rcp;
+  using Teuchos::FancyOStream;
+  using Teuchos::VerboseObjectBase;
+
+  bool success = true;
+
+  Teuchos::GlobalMPISession mpiSession(&argc,&argv);
+
+  const RCP<FancyOStream>
+    out = VerboseObjectBase::getDefaultOStream();
+
+  try {
+
+    const int num_p = 16;
+    const int num_threads = 4;
+
+    Teuchos::ParameterList options;
+    options.set("Input String", dakotaInput(num_p, num_threads));
+    TriKota::Driver dakota(options);
+
+    const RCP<ThreadRecordingROME> thyraApp = rcp(new ThreadRecordingROME(num_p));
+    const RCP<Thyra::VectorBase<double> > ps = Thyra::createMember(thyraApp->get_p_space(0));
+    Thyra::V_S(ps.ptr(), 2.0);
+    thyraApp->setSolutionVector(ps);
+    thyraApp->setScalarOffset(5.0);
+
+    Teuchos::RCP<TriKota::ThyraDirectApplicInterface> trikota_interface =
+      Teuchos::rcp(new TriKota::ThyraDirectApplicInterface(dakota.getProblemDescDB(), thyraApp), false);
+    trikota_interface->setEvaluationThreads(-1);
+
+    dakota.run(trikota_interface.get());
+
+    std::vector<double> x, g;
+    dakota.getFinalResults(x, g);
+
+    // Central differences are exact for the quadratic up to round-off
+    const double errorTol = 1e-4;
+    double finalError = 0.0;
+    for (unsigned int i=0; i<x.size(); i++) finalError += (x[i] - 2.0)*(x[i] - 2.0);
+    finalError = std::sqrt(finalError);
+    *out << "\nfinalError = " << finalError << ", g = " << (g.empty() ? 0.0 : g[0])
+         << "\nevaluations on worker threads = " << thyraApp->numWorkerEvaluations()
+         << " (" << thyraApp->numThreads() << " threads)\n";
+
+    if ((int) x.size() != num_p || g.size() != 1 ||
+        finalError > errorTol || std::fabs(g[0] - 5.0) > errorTol) {
+      *out << "\nError: the optimum is p = 2, g = 5 (tolerance " << errorTol << ")\n";
+      success = false;
+    }
+    if (thyraApp->numWorkerEvaluations() == 0) {
+      *out << "\nError: no evaluation ran on the threads of the adapter\n";
+      success = false;
+    }
+
+    *out << std::flush;
+
+  }
+  TEUCHOS_STANDARD_CATCH_STATEMENTS(true, std::cerr, success);
+
+  if(success)
+    *out << "\nEnd Result: TEST PASSED\n";
+  else
+    *out << "\nEnd Result: TEST FAILED\n";
+    
+  return ( success ? 0 : 1 );
+
+
+}
@@ -0,0 +1,188 @@
+// @HEADER
+// ************************************************************************
+// 
+//        TriKota: A Trilinos Wrapper for the Dakota Framework
+//                  Copyright (2009) Sandia Corporation
+// 
+// Under the terms of Contract DE-AC04-94AL85000 with Sandia Corporation,
+// the U.S. Government retains certain rights in this software.
+// 
+// This library is free software; you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation; either version 2.1 of the
+// License, or (at your option) any later version.
+//  
+// This library is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301
+// USA
+// 
+// Questions? Contact Andy Salinger (agsalin@sandia.gov), Sandia
+// National Laboratories.
+// 
+// ************************************************************************
+// @HEADER
+
+#include "Diagonal_ThyraROME_def.hpp"
+
+#include "TriKota_Driver.hpp"
+#include "TriKota_ThyraDirectApplicInterface.hpp"
+
+#include "Teuchos_GlobalMPISession.hpp"
+#include "Teuchos_StandardCatchMacros.hpp"
+#include "Teuchos_VerboseObject.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// Warm start: a DiagonalROME whose "state" is a copy of its parameters
+// is optimized with warm starting on. The adapter must hand it states of
+// earlier evaluations no farther than the warm start distance from the
+// new point, and the optimization must still reach the exact optimum
+// p = 2, g = 5.
+
+namespace {
+
+
+//! DiagonalROME recording the initial states it is given
+class WarmStartROME : public TriKota::DiagonalROME<double>,
+                      public TriKota::WarmStartModelEvaluator<Thyra::VectorBase<double> >
+{
+public:
+
+  WarmStartROME(const int localDim)
+    : TriKota::DiagonalROME<double>(localDim), warmStarts(0), coldStarts(0),
+      maxDistance(0.0)
+    {}
+
+  void setInitialState(const Teuchos::RCP<const Thyra::VectorBase<double> >& x) const
+    { initialState = x; }
+
+  Teuchos::RCP<const Thyra::VectorBase<double> > getLastState() const
+    { return lastState; }
+
+  void evalModel(const Thyra::ModelEvaluatorBase::InArgs<double>& inArgs,
+                 const Thyra::ModelEvaluatorBase::OutArgs<double>& outArgs) const
+    {
+      const Teuchos::RCP<const Thyra::VectorBase<double> > p = inArgs.get_p(0);
+      if (initialState != Teuchos::null) {
+        const Teuchos::RCP<Thyra::VectorBase<double> > diff = p->clone_v();
+        Thyra::Vp_StV(diff.ptr(), -1.0, *initialState);
+        maxDistance = std::max(maxDistance, Thyra::norm_2(*diff));
+        warmStarts++;
+      }
+      else
+        coldStarts++;
+      initialState = Teuchos::null;
+
+      TriKota::DiagonalROME<double>::evalModel(inArgs, outArgs);
+      lastState = p->clone_v();
+    }
+
+  //! Evaluations started from a state of the adapter's pool
+  int numWarmStarts() const { return warmStarts; }
+  //! Evaluations started without a state
+  int numColdStarts() const { return coldStarts; }
+  //! Largest distance between a warm start state and its point
+  double maxStateDistance() const { return maxDistance; }
+
+private:
+
+  mutable Teuchos::RCP<const Thyra::VectorBase<double> > initialState;
+  mutable Teuchos::RCP<const Thyra::VectorBase<double> > lastState;
+  mutable int warmStarts;
+  mutable int coldStarts;
+  mutable double maxDistance;
+
+};
+
+
+} // namespace
+
+
+
+int main(int argc, char* argv[])
+{
+
+  using Teuchos::RCP;
+  using Teuchos::rcp;
+  using Teuchos::FancyOStream;
+  using Teuchos::VerboseObjectBase;
+
+  bool success = true;
+
+  Teuchos::GlobalMPISession mpiSession(&argc,&argv);
+
+  const RCP<FancyOStream>
+    out = VerboseObjectBase::getDefaultOStream();
+
+  try {
+
+    const RCP<const Teuchos::Comm<Thyra::Ordinal> > comm =
+      Teuchos::DefaultComm<Thyra::Ordinal>::getComm();
+    const int num_p = 16;
+    const double warmStartDistance = 0.5;
+
+    TriKota::Driver dakota("dakota_conmin.in", "warm_start.out", "warm_start.err", "");
+
+    const RCP<WarmStartROME> thyraApp =
+      rcp(new WarmStartROME(TriKota::diagonalLocalDim(num_p, comm)));
+    const RCP<Thyra::VectorBase<double> > ps = Thyra::createMember(thyraApp->get_p_space(0));
+    Thyra::V_S(ps.ptr(), 2.0);
+    thyraApp->setSolutionVector(ps);
+    thyraApp->setScalarOffset(5.0);
+
+    Teuchos::RCP<TriKota::ThyraDirectApplicInterface> trikota_interface =
+      Teuchos::rcp(new TriKota::ThyraDirectApplicInterface(dakota.getProblemDescDB(), thyraApp), false);
+    trikota_interface->setWarmStart(warmStartDistance);
+
+    dakota.run(trikota_interface.get());
+
+    std::vector<double> x, g;
+    dakota.getFinalResults(x, g);
+
+    const double errorTol = 1e-6;
+    double finalError = 0.0;
+    for (unsigned int i=0; i<x.size(); i++) finalError += (x[i] - 2.0)*(x[i] - 2.0);
+    finalError = std::sqrt(finalError);
+    *out << "\nfinalError = " << finalError << ", g = " << (g.empty() ? 0.0 : g[0])
+         << "\nwarm starts = " << thyraApp->numWarmStarts() << ", cold starts = "
+         << thyraApp->numColdStarts() << ", largest state distance = "
+         << thyraApp->maxStateDistance() << "\n";
+
+    if ((int) x.size() != num_p || g.size() != 1 ||
+        finalError > errorTol || std::fabs(g[0] - 5.0) > errorTol) {
+      *out << "\nError: the optimum is p = 2, g = 5 (tolerance " << errorTol << ")\n";
+      success = false;
+    }
+    // The first evaluation has no earlier state
+    if (thyraApp->numColdStarts() == 0 || thyraApp->numWarmStarts() == 0) {
+      *out << "\nError: the first evaluation must start cold and later ones warm\n";
+      success = false;
+    }
+    if (thyraApp->maxStateDistance() > warmStartDistance) {
+      *out << "\nError: a warm start state was farther than " << warmStartDistance
+           << " from its point\n";
+      success = false;
+    }
+
+    *out << std::flush;
+
+  }
+  TEUCHOS_STANDARD_CATCH_STATEMENTS(true, std::cerr, success);
+
+  if(success)
+    *out << "\nEnd Result: TEST PASSED\n";
+  else
+    *out << "\nEnd Result: TEST FAILED\n";
+    
+  return ( success ? 0 : 1 );
+
+
+}